@@ -0,0 +1,472 @@
+/*
+ * Image codecs for streaming MulticopterSim camera frames
+ *
+ * Supports:
+ *
+ *   RAW   - uncompressed four-channel pixels
+ *
+ *   DELTA - lossless XOR against previous frame, with zero-run encoding;
+ *           very fast, and small when little of the scene changes
+ *
+ *   QOI   - lossless "Quite OK Image" format (https://qoiformat.org)
+ *
+ *   JPEG  - lossy, via libjpeg-turbo; available only when compiled with
+ *           CAMSTREAM_USE_TURBOJPEG defined
+ *
+ * Pixels are four bytes each, in whatever channel order the camera provides
+ * (UE4 render targets give BGRA).
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CAMSTREAM_USE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+class FrameCodec {
+
+    public:
+
+        typedef enum {
+
+            CODEC_RAW,
+            CODEC_DELTA,
+            CODEC_QOI,
+            CODEC_JPEG,
+            CODEC_COUNT
+
+        } codec_t;
+
+        static const uint8_t BYTES_PER_PIXEL = 4;
+
+        // Returns true if codec is supported by this build
+        static bool supported(codec_t codec)
+        {
+#ifdef CAMSTREAM_USE_TURBOJPEG
+            return codec < CODEC_COUNT;
+#else
+            return codec < CODEC_JPEG;
+#endif
+        }
+
+        // Returns true if codec needs the previous frame to decode
+        static bool needsReference(codec_t codec)
+        {
+            return codec == CODEC_DELTA;
+        }
+
+        // Upper bound on encoded size, for preallocating output buffers
+        static size_t maxEncodedSize(uint16_t cols, uint16_t rows)
+        {
+            size_t npix = (size_t)cols * rows;
+
+            // QOI worst case is one tag byte per pixel plus the pixel, plus header and padding
+            return npix * (BYTES_PER_PIXEL+1) + QOI_HEADER_SIZE + QOI_PADDING_SIZE;
+        }
+
+    private:
+
+        static const uint32_t QOI_HEADER_SIZE = 14;
+        static const uint32_t QOI_PADDING_SIZE = 8;
+
+        static const uint8_t QOI_OP_INDEX = 0x00;
+        static const uint8_t QOI_OP_DIFF  = 0x40;
+        static const uint8_t QOI_OP_LUMA  = 0x80;
+        static const uint8_t QOI_OP_RUN   = 0xc0;
+        static const uint8_t QOI_OP_RGB   = 0xfe;
+        static const uint8_t QOI_OP_RGBA  = 0xff;
+        static const uint8_t QOI_MASK_2   = 0xc0;
+
+        // Zero runs shorter than this are folded into literal runs by DELTA
+        static const uint32_t DELTA_MIN_ZERO_RUN = 4;
+
+        typedef union {
+            uint8_t c[4];
+            uint32_t v;
+        } pixel_t;
+
+#ifdef CAMSTREAM_USE_TURBOJPEG
+        tjhandle _jpegCompressor = NULL;
+        tjhandle _jpegDecompressor = NULL;
+#endif
+
+        static uint32_t qoiHash(pixel_t p)
+        {
+            return (p.c[0]*3 + p.c[1]*5 + p.c[2]*7 + p.c[3]*11) % 64;
+        }
+
+        static void put32be(uint8_t * bytes, uint32_t & pos, uint32_t v)
+        {
+            bytes[pos++] = (v >> 24) & 0xff;
+            bytes[pos++] = (v >> 16) & 0xff;
+            bytes[pos++] = (v >>  8) & 0xff;
+            bytes[pos++] =  v        & 0xff;
+        }
+
+        static uint32_t get32be(const uint8_t * bytes, uint32_t & pos)
+        {
+            uint32_t v = (bytes[pos] << 24) | (bytes[pos+1] << 16) | (bytes[pos+2] << 8) | bytes[pos+3];
+            pos += 4;
+            return v;
+        }
+
+        static void putVarint(uint8_t * bytes, uint32_t & pos, uint32_t v)
+        {
+            while (v >= 0x80) {
+                bytes[pos++] = (uint8_t)(v | 0x80);
+                v >>= 7;
+            }
+            bytes[pos++] = (uint8_t)v;
+        }
+
+        static bool getVarint(const uint8_t * bytes, uint32_t size, uint32_t & pos, uint32_t & v)
+        {
+            v = 0;
+            for (uint8_t shift=0; shift<35 && pos<size; shift+=7) {
+                uint8_t b = bytes[pos++];
+                v |= (uint32_t)(b & 0x7f) << shift;
+                if (!(b & 0x80)) return true;
+            }
+            return false;
+        }
+
+        static uint32_t encodeQoi(const uint8_t * pixels, uint16_t cols, uint16_t rows, uint8_t * out)
+        {
+            uint32_t pos = 0;
+
+            out[pos++] = 'q';
+            out[pos++] = 'o';
+            out[pos++] = 'i';
+            out[pos++] = 'f';
+            put32be(out, pos, cols);
+            put32be(out, pos, rows);
+            out[pos++] = BYTES_PER_PIXEL;
+            out[pos++] = 0; // sRGB with linear alpha
+
+            pixel_t index[64] = {};
+            pixel_t prev = {};
+            prev.c[3] = 255;
+
+            uint32_t run = 0;
+            uint32_t npix = (uint32_t)cols * rows;
+
+            for (uint32_t k=0; k<npix; ++k) {
+
+                pixel_t px;
+                memcpy(&px, &pixels[k*BYTES_PER_PIXEL], BYTES_PER_PIXEL);
+
+                if (px.v == prev.v) {
+                    run++;
+                    if (run == 62 || k == npix-1) {
+                        out[pos++] = QOI_OP_RUN | (run - 1);
+                        run = 0;
+                    }
+                    continue;
+                }
+
+                if (run > 0) {
+                    out[pos++] = QOI_OP_RUN | (run - 1);
+                    run = 0;
+                }
+
+                uint32_t h = qoiHash(px);
+
+                if (index[h].v == px.v) {
+                    out[pos++] = QOI_OP_INDEX | h;
+                }
+
+                else {
+
+                    index[h] = px;
+
+                    if (px.c[3] == prev.c[3]) {
+
+                        int8_t vr = (int8_t)(px.c[0] - prev.c[0]);
+                        int8_t vg = (int8_t)(px.c[1] - prev.c[1]);
+                        int8_t vb = (int8_t)(px.c[2] - prev.c[2]);
+
+                        int8_t vgr = vr - vg;
+                        int8_t vgb = vb - vg;
+
+                        if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                            out[pos++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                        }
+                        else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                            out[pos++] = QOI_OP_LUMA | (vg + 32);
+                            out[pos++] = (vgr + 8) << 4 | (vgb + 8);
+                        }
+                        else {
+                            out[pos++] = QOI_OP_RGB;
+                            out[pos++] = px.c[0];
+                            out[pos++] = px.c[1];
+                            out[pos++] = px.c[2];
+                        }
+                    }
+
+                    else {
+                        out[pos++] = QOI_OP_RGBA;
+                        memcpy(&out[pos], px.c, 4);
+                        pos += 4;
+                    }
+                }
+
+                prev = px;
+            }
+
+            // End marker is seven zeros followed by a one
+            memset(&out[pos], 0, QOI_PADDING_SIZE-1);
+            out[pos+QOI_PADDING_SIZE-1] = 1;
+
+            return pos + QOI_PADDING_SIZE;
+        }
+
+        static bool decodeQoi(const uint8_t * in, uint32_t size, uint16_t cols, uint16_t rows, uint8_t * pixels)
+        {
+            if (size < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(in, "qoif", 4)) {
+                return false;
+            }
+
+            uint32_t pos = 4;
+            if (get32be(in, pos) != cols || get32be(in, pos) != rows || in[pos] != BYTES_PER_PIXEL) {
+                return false;
+            }
+            pos += 2;
+
+            pixel_t index[64] = {};
+            pixel_t px = {};
+            px.c[3] = 255;
+
+            uint32_t run = 0;
+            uint32_t npix = (uint32_t)cols * rows;
+            uint32_t end = size - QOI_PADDING_SIZE;
+
+            for (uint32_t k=0; k<npix; ++k) {
+
+                if (run > 0) {
+                    run--;
+                }
+
+                else if (pos < end) {
+
+                    uint8_t b1 = in[pos++];
+
+                    if (b1 == QOI_OP_RGB) {
+                        px.c[0] = in[pos++];
+                        px.c[1] = in[pos++];
+                        px.c[2] = in[pos++];
+                    }
+                    else if (b1 == QOI_OP_RGBA) {
+                        memcpy(px.c, &in[pos], 4);
+                        pos += 4;
+                    }
+                    else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                        px = index[b1];
+                    }
+                    else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                        px.c[0] += ((b1 >> 4) & 0x03) - 2;
+                        px.c[1] += ((b1 >> 2) & 0x03) - 2;
+                        px.c[2] += ( b1       & 0x03) - 2;
+                    }
+                    else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                        uint8_t b2 = in[pos++];
+                        int vg = (b1 & 0x3f) - 32;
+                        px.c[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                        px.c[1] += vg;
+                        px.c[2] += vg - 8 +  (b2       & 0x0f);
+                    }
+                    else {
+                        run = (b1 & 0x3f);
+                    }
+
+                    index[qoiHash(px)] = px;
+                }
+
+                else {
+                    return false;
+                }
+
+                memcpy(&pixels[k*BYTES_PER_PIXEL], px.c, BYTES_PER_PIXEL);
+            }
+
+            return true;
+        }
+
+        // Alternating (zero-run, literal-run) segments of the XOR difference
+        static uint32_t encodeDelta(const uint8_t * pixels, const uint8_t * reference, uint32_t nbytes, uint8_t * out)
+        {
+            uint32_t pos = 0;
+            uint32_t k = 0;
+
+            while (k < nbytes) {
+
+                // Count zeros (unchanged bytes)
+                uint32_t zbeg = k;
+                while (k < nbytes && pixels[k] == reference[k]) {
+                    k++;
+                }
+                uint32_t zeros = k - zbeg;
+
+                // Count literals, absorbing short zero runs
+                uint32_t lbeg = k;
+                while (k < nbytes) {
+                    uint32_t j = k;
+                    while (j < nbytes && pixels[j] == reference[j] && j-k < DELTA_MIN_ZERO_RUN) {
+                        j++;
+                    }
+                    if (j == nbytes || j-k >= DELTA_MIN_ZERO_RUN) {
+                        break;
+                    }
+                    k = j + 1;
+                }
+                uint32_t literals = k - lbeg;
+
+                putVarint(out, pos, zeros);
+                putVarint(out, pos, literals);
+
+                for (uint32_t j=lbeg; j<k; ++j) {
+                    out[pos++] = pixels[j] ^ reference[j];
+                }
+            }
+
+            return pos;
+        }
+
+        static bool decodeDelta(const uint8_t * in, uint32_t size, uint32_t nbytes, const uint8_t * reference, uint8_t * pixels)
+        {
+            if (pixels != reference) {
+                memcpy(pixels, reference, nbytes);
+            }
+
+            uint32_t pos = 0;
+            uint32_t k = 0;
+
+            while (pos < size) {
+
+                uint32_t zeros = 0, literals = 0;
+
+                if (!getVarint(in, size, pos, zeros) || !getVarint(in, size, pos, literals)) {
+                    return false;
+                }
+
+                k += zeros;
+
+                if (k + literals > nbytes || pos + literals > size) {
+                    return false;
+                }
+
+                for (uint32_t j=0; j<literals; ++j) {
+                    pixels[k++] ^= in[pos++];
+                }
+            }
+
+            return k <= nbytes;
+        }
+
+    public:
+
+        FrameCodec(void)
+        {
+        }
+
+        ~FrameCodec(void)
+        {
+#ifdef CAMSTREAM_USE_TURBOJPEG
+            if (_jpegCompressor) tjDestroy(_jpegCompressor);
+            if (_jpegDecompressor) tjDestroy(_jpegDecompressor);
+#endif
+        }
+
+        /**
+         * Encodes a frame.
+         *
+         * @param codec which codec to use
+         * @param pixels four-byte pixels, row-major
+         * @param reference previous frame (DELTA only; NULL otherwise)
+         * @param cols image width
+         * @param rows image height
+         * @param out buffer of at least maxEncodedSize(cols, rows) bytes
+         * @param quality JPEG quality in [1,100]; ignored by other codecs
+         * @return number of bytes written to out, or zero on failure
+         */
+        uint32_t encode(codec_t codec, const uint8_t * pixels, const uint8_t * reference,
+                uint16_t cols, uint16_t rows, uint8_t * out, uint8_t quality=80)
+        {
+            uint32_t nbytes = (uint32_t)cols * rows * BYTES_PER_PIXEL;
+
+            switch (codec) {
+
+                case CODEC_RAW:
+                    memcpy(out, pixels, nbytes);
+                    return nbytes;
+
+                case CODEC_DELTA:
+                    return reference ? encodeDelta(pixels, reference, nbytes, out) : 0;
+
+                case CODEC_QOI:
+                    return encodeQoi(pixels, cols, rows, out);
+
+#ifdef CAMSTREAM_USE_TURBOJPEG
+                case CODEC_JPEG:
+                    {
+                        if (!_jpegCompressor) _jpegCompressor = tjInitCompress();
+                        unsigned char * jpeg = out;
+                        unsigned long jpegSize = tjBufSize(cols, rows, TJSAMP_420);
+                        return tjCompress2(_jpegCompressor, pixels, cols, 0, rows, TJPF_BGRA, &jpeg, &jpegSize,
+                                TJSAMP_420, quality, TJFLAG_NOREALLOC | TJFLAG_FASTDCT) ? 0 : (uint32_t)jpegSize;
+                    }
+#endif
+                default:
+                    (void)quality;
+                    return 0;
+            }
+        }
+
+        /**
+         * Decodes a frame.
+         *
+         * @param codec codec used to encode the frame
+         * @param in encoded bytes
+         * @param size number of encoded bytes
+         * @param reference previously decoded frame (DELTA only); may be the same buffer as pixels
+         * @param cols image width
+         * @param rows image height
+         * @param pixels output buffer of cols*rows*4 bytes
+         * @return true on success, false on corrupt input
+         */
+        bool decode(codec_t codec, const uint8_t * in, uint32_t size, const uint8_t * reference,
+                uint16_t cols, uint16_t rows, uint8_t * pixels)
+        {
+            uint32_t nbytes = (uint32_t)cols * rows * BYTES_PER_PIXEL;
+
+            switch (codec) {
+
+                case CODEC_RAW:
+                    if (size != nbytes) return false;
+                    memcpy(pixels, in, nbytes);
+                    return true;
+
+                case CODEC_DELTA:
+                    return reference ? decodeDelta(in, size, nbytes, reference, pixels) : false;
+
+                case CODEC_QOI:
+                    return decodeQoi(in, size, cols, rows, pixels);
+
+#ifdef CAMSTREAM_USE_TURBOJPEG
+                case CODEC_JPEG:
+                    if (!_jpegDecompressor) _jpegDecompressor = tjInitDecompress();
+                    return tjDecompress2(_jpegDecompressor, in, size, pixels, cols, 0, rows, TJPF_BGRA, TJFLAG_FASTDCT) == 0;
+#endif
+                default:
+                    return false;
+            }
+        }
+
+}; // class FrameCodec
@@ -0,0 +1,388 @@
+/*
+ * Chunked UDP / framed TCP transport for encoded camera frames
+ *
+ * Over UDP, each encoded frame is split into datagrams small enough to avoid
+ * IP fragmentation; each datagram carries a chunk header so the receiver can
+ * reassemble frames and drop incomplete ones.  Over TCP, each frame is sent as
+ * a single header followed by the encoded bytes.
+ *
+ * Header fields are in host byte order; all our platforms are little-endian.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "FrameCodec.hpp"
+
+#include "../sockets/UdpClientSocket.hpp"
+#include "../sockets/UdpServerSocket.hpp"
+#include "../sockets/TcpClientSocket.hpp"
+#include "../sockets/TcpServerSocket.hpp"
+
+class FrameStream {
+
+    public:
+
+        typedef enum {
+
+            TRANSPORT_UDP,
+            TRANSPORT_TCP
+
+        } transport_t;
+
+        static const uint32_t MAGIC = 0x5343534d; // "MSCS"
+
+        // Frame can be decoded without a reference frame
+        static const uint8_t FLAG_KEYFRAME = 0x01;
+
+#pragma pack(push, 1)
+        typedef struct {
+
+            uint32_t magic;
+            uint32_t frameId;
+            uint32_t refFrameId;    // frame that a DELTA frame was encoded against
+            uint32_t frameBytes;    // total encoded size of the frame
+            uint32_t chunkOffset;   // where this chunk's payload goes in the frame
+            uint16_t cols;
+            uint16_t rows;
+            uint16_t chunkIndex;
+            uint16_t chunkCount;
+            uint8_t  codec;
+            uint8_t  flags;
+            uint16_t payloadBytes;  // bytes following this header in the datagram (UDP only)
+
+        } chunk_header_t;
+#pragma pack(pop)
+
+        // Keeps datagrams under a typical Ethernet MTU
+        static const uint16_t MAX_DATAGRAM_SIZE = 1400;
+        static const uint16_t MAX_CHUNK_PAYLOAD = MAX_DATAGRAM_SIZE - sizeof(chunk_header_t);
+
+        // Generous socket buffers for bursts of chunks from large frames
+        static const int SOCKET_BUFFER_SIZE = 8 << 20;
+
+}; // class FrameStream
+
+class FrameSender {
+
+    private:
+
+        FrameStream::transport_t _transport;
+
+        UdpClientSocket * _udp = NULL;
+        TcpClientSocket * _tcp = NULL;
+
+        char  _host[200];
+        short _port;
+
+        uint8_t _datagram[FrameStream::MAX_DATAGRAM_SIZE] = {};
+
+        // Connect to receiver lazily, so that the simulator can start before the receiver
+        bool tcpConnected(void)
+        {
+            if (_tcp && _tcp->isConnected()) return true;
+
+            if (_tcp) {
+                delete _tcp;
+            }
+
+            _tcp = new TcpClientSocket(_host, _port);
+            _tcp->openConnection();
+
+            return _tcp->isConnected();
+        }
+
+    public:
+
+        FrameSender(const char * host, const short port, FrameStream::transport_t transport=FrameStream::TRANSPORT_UDP)
+        {
+            _transport = transport;
+            _port = port;
+            snprintf(_host, sizeof(_host), "%s", host);
+
+            if (transport == FrameStream::TRANSPORT_UDP) {
+                _udp = new UdpClientSocket(host, port);
+                _udp->setBufferSizes(FrameStream::SOCKET_BUFFER_SIZE, 0);
+            }
+        }
+
+        ~FrameSender(void)
+        {
+            if (_udp) {
+                _udp = UdpClientSocket::free(_udp);
+            }
+
+            if (_tcp) {
+                _tcp->closeConnection();
+                delete _tcp;
+            }
+        }
+
+        /**
+         * Sends an encoded frame.
+         *
+         * @param header frame fields (magic, chunk fields are filled in here)
+         * @param payload encoded bytes
+         * @return false if TCP receiver could not be reached
+         */
+        bool send(FrameStream::chunk_header_t header, const uint8_t * payload)
+        {
+            header.magic = FrameStream::MAGIC;
+
+            if (_transport == FrameStream::TRANSPORT_TCP) {
+
+                if (!tcpConnected()) return false;
+
+                header.chunkOffset = 0;
+                header.chunkIndex = 0;
+                header.chunkCount = 1;
+                header.payloadBytes = 0;
+
+                if (!_tcp->sendData(&header, sizeof(header)) || !_tcp->sendData((void *)payload, header.frameBytes)) {
+                    _tcp->closeConnection();
+                    delete _tcp;
+                    _tcp = NULL;
+                    return false;
+                }
+
+                return true;
+            }
+
+            uint32_t nchunks = (header.frameBytes + FrameStream::MAX_CHUNK_PAYLOAD - 1) / FrameStream::MAX_CHUNK_PAYLOAD;
+            header.chunkCount = nchunks ? nchunks : 1;
+
+            for (uint32_t k=0; k<header.chunkCount; ++k) {
+
+                header.chunkIndex = k;
+                header.chunkOffset = k * FrameStream::MAX_CHUNK_PAYLOAD;
+
+                uint32_t remaining = header.frameBytes - header.chunkOffset;
+                header.payloadBytes = remaining < FrameStream::MAX_CHUNK_PAYLOAD ? remaining : FrameStream::MAX_CHUNK_PAYLOAD;
+
+                memcpy(_datagram, &header, sizeof(header));
+                memcpy(&_datagram[sizeof(header)], &payload[header.chunkOffset], header.payloadBytes);
+
+                _udp->sendData(_datagram, sizeof(header) + header.payloadBytes);
+            }
+
+            return true;
+        }
+
+}; // class FrameSender
+
+class FrameReceiver {
+
+    private:
+
+        FrameStream::transport_t _transport;
+
+        UdpServerSocket * _udp = NULL;
+        TcpServerSocket * _tcp = NULL;
+
+        FrameCodec _codec;
+
+        uint16_t _cols = 0;
+        uint16_t _rows = 0;
+
+        // Encoded frame being reassembled, and its chunk bookkeeping
+        uint8_t * _encoded = NULL;
+        uint32_t  _encodedCapacity = 0;
+        uint8_t * _chunkReceived = NULL;
+        uint32_t  _chunkCapacity = 0;
+        uint32_t  _chunksReceived = 0;
+        uint32_t  _assemblingId = 0;
+        bool      _assembling = false;
+
+        // Most recently decoded frame, also the reference for DELTA frames
+        uint8_t * _pixels = NULL;
+        uint32_t  _lastDecodedId = 0;
+        bool      _haveDecoded = false;
+
+        uint8_t _datagram[FrameStream::MAX_DATAGRAM_SIZE] = {};
+
+        void reallocate(uint16_t cols, uint16_t rows)
+        {
+            delete[] _encoded;
+            delete[] _pixels;
+            delete[] _chunkReceived;
+
+            _cols = cols;
+            _rows = rows;
+
+            _encodedCapacity = (uint32_t)FrameCodec::maxEncodedSize(cols, rows);
+            _encoded = new uint8_t [_encodedCapacity];
+
+            _chunkCapacity = _encodedCapacity / FrameStream::MAX_CHUNK_PAYLOAD + 1;
+            _chunkReceived = new uint8_t [_chunkCapacity]();
+
+            _pixels = new uint8_t [(uint32_t)cols*rows*FrameCodec::BYTES_PER_PIXEL]();
+
+            _haveDecoded = false;
+            _assembling = false;
+        }
+
+        bool decode(const FrameStream::chunk_header_t & header)
+        {
+            FrameCodec::codec_t codec = (FrameCodec::codec_t)header.codec;
+
+            // DELTA frames are useless if we missed the frame they refer to
+            if (FrameCodec::needsReference(codec) && !(header.flags & FrameStream::FLAG_KEYFRAME) &&
+                    (!_haveDecoded || header.refFrameId != _lastDecodedId)) {
+                framesDropped++;
+                return false;
+            }
+
+            if (!_codec.decode(codec, _encoded, header.frameBytes, _pixels, _cols, _rows, _pixels)) {
+                framesDropped++;
+                _haveDecoded = false;
+                return false;
+            }
+
+            _lastDecodedId = header.frameId;
+            _haveDecoded = true;
+            framesReceived++;
+
+            return true;
+        }
+
+        bool validHeader(const FrameStream::chunk_header_t & header)
+        {
+            if (header.magic != FrameStream::MAGIC || !FrameCodec::supported((FrameCodec::codec_t)header.codec)) {
+                return false;
+            }
+
+            if (header.cols != _cols || header.rows != _rows) {
+                reallocate(header.cols, header.rows);
+            }
+
+            return header.frameBytes <= _encodedCapacity;
+        }
+
+        bool receiveTcp(void)
+        {
+            if (!_tcp->isConnected()) {
+                _tcp->acceptConnection();
+            }
+
+            FrameStream::chunk_header_t header = {};
+
+            if (!_tcp->receiveData(&header, sizeof(header)) || !validHeader(header)) {
+                return false;
+            }
+
+            if (!_tcp->receiveData(_encoded, header.frameBytes)) {
+                return false;
+            }
+
+            bytesReceived += sizeof(header) + header.frameBytes;
+
+            return decode(header);
+        }
+
+        bool receiveUdp(void)
+        {
+            while (true) {
+
+                int n = _udp->receiveDatagram(_datagram, sizeof(_datagram));
+
+                // Timeout
+                if (n < 0) return false;
+
+                if (n < (int)sizeof(FrameStream::chunk_header_t)) continue;
+
+                FrameStream::chunk_header_t header = {};
+                memcpy(&header, _datagram, sizeof(header));
+
+                if (!validHeader(header) || header.chunkCount > _chunkCapacity || header.chunkIndex >= header.chunkCount ||
+                        header.chunkOffset + header.payloadBytes > header.frameBytes ||
+                        n != (int)(sizeof(header) + header.payloadBytes)) {
+                    continue;
+                }
+
+                bytesReceived += n;
+
+                // Ignore stragglers from frames we've given up on
+                if (_assembling && (int32_t)(header.frameId - _assemblingId) < 0) {
+                    continue;
+                }
+
+                // A newer frame started before the current one completed
+                if (!_assembling || header.frameId != _assemblingId) {
+                    if (_assembling) {
+                        framesDropped++;
+                    }
+                    _assembling = true;
+                    _assemblingId = header.frameId;
+                    _chunksReceived = 0;
+                    memset(_chunkReceived, 0, header.chunkCount);
+                }
+
+                if (_chunkReceived[header.chunkIndex]) continue;
+
+                _chunkReceived[header.chunkIndex] = 1;
+                _chunksReceived++;
+
+                memcpy(&_encoded[header.chunkOffset], &_datagram[sizeof(header)], header.payloadBytes);
+
+                if (_chunksReceived == header.chunkCount) {
+                    _assembling = false;
+                    if (decode(header)) return true;
+                }
+            }
+        }
+
+    public:
+
+        uint32_t framesReceived = 0;
+        uint32_t framesDropped = 0;
+        uint64_t bytesReceived = 0;
+
+        FrameReceiver(const short port, FrameStream::transport_t transport=FrameStream::TRANSPORT_UDP, uint32_t timeoutMsec=0)
+        {
+            _transport = transport;
+
+            if (transport == FrameStream::TRANSPORT_UDP) {
+                _udp = new UdpServerSocket(port, timeoutMsec);
+                _udp->setBufferSizes(0, FrameStream::SOCKET_BUFFER_SIZE);
+            }
+            else {
+                _tcp = new TcpServerSocket("0.0.0.0", port);
+            }
+        }
+
+        ~FrameReceiver(void)
+        {
+            if (_udp) {
+                _udp = UdpServerSocket::free(_udp);
+            }
+
+            if (_tcp) {
+                _tcp->closeConnection();
+                delete _tcp;
+            }
+
+            delete[] _encoded;
+            delete[] _pixels;
+            delete[] _chunkReceived;
+        }
+
+        /**
+         * Blocks until a complete frame has been received and decoded.
+         *
+         * @return true on success, false on timeout or connection loss
+         */
+        bool receive(void)
+        {
+            return _transport == FrameStream::TRANSPORT_TCP ? receiveTcp() : receiveUdp();
+        }
+
+        // Most recently decoded frame
+        const uint8_t * getPixels(void) { return _pixels; }
+        uint16_t getCols(void) { return _cols; }
+        uint16_t getRows(void) { return _rows; }
+        uint32_t getFrameId(void) { return _lastDecodedId; }
+
+}; // class FrameReceiver
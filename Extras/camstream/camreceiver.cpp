@@ -0,0 +1,96 @@
+/*
+   Reference receiver for MulticopterSim camera streams
+
+   Usage: camreceiver [PORT] [udp|tcp] [OUTFILE.ppm]
+
+   Reports frame rate, bandwidth, and dropped frames once per second, and
+   optionally saves the most recent frame as a PPM image.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FrameStream.hpp"
+
+static const short DEFAULT_PORT = 5002;
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Render targets give us BGRA; PPM wants RGB
+static void savePpm(const char * filename, const uint8_t * bgra, uint16_t cols, uint16_t rows)
+{
+    FILE * fp = fopen(filename, "wb");
+    if (!fp) return;
+
+    fprintf(fp, "P6\n%d %d\n255\n", cols, rows);
+
+    for (uint32_t k=0; k<(uint32_t)cols*rows; ++k) {
+        uint8_t rgb[3] = {bgra[4*k+2], bgra[4*k+1], bgra[4*k]};
+        fwrite(rgb, 1, 3, fp);
+    }
+
+    fclose(fp);
+}
+
+int main(int argc, char ** argv)
+{
+    short port = argc > 1 ? (short)atoi(argv[1]) : DEFAULT_PORT;
+
+    FrameStream::transport_t transport = (argc > 2 && !strcmp(argv[2], "tcp")) ?
+        FrameStream::TRANSPORT_TCP : FrameStream::TRANSPORT_UDP;
+
+    const char * outfile = argc > 3 ? argv[3] : NULL;
+
+    FrameReceiver receiver(port, transport, 1000);
+
+    printf("Listening for %s frames on port %d\n", transport == FrameStream::TRANSPORT_TCP ? "TCP" : "UDP", port);
+
+    double prevTime = seconds();
+    uint32_t prevFrames = 0;
+    uint64_t prevBytes = 0;
+
+    while (true) {
+
+        bool gotFrame = receiver.receive();
+
+        if (!gotFrame && transport == FrameStream::TRANSPORT_TCP) {
+            fprintf(stderr, "Connection lost\n");
+            break;
+        }
+
+        double currTime = seconds();
+
+        if (currTime - prevTime >= 1) {
+
+            double dt = currTime - prevTime;
+
+            printf("%dx%d  frame=%u  fps=%5.1f  Mbit/s=%7.2f  dropped=%u\n",
+                    receiver.getCols(), receiver.getRows(), receiver.getFrameId(),
+                    (receiver.framesReceived - prevFrames) / dt,
+                    (receiver.bytesReceived - prevBytes) * 8 / dt / 1e6,
+                    receiver.framesDropped);
+            fflush(stdout);
+
+            if (outfile && receiver.framesReceived > 0) {
+                savePpm(outfile, receiver.getPixels(), receiver.getCols(), receiver.getRows());
+            }
+
+            prevTime = currTime;
+            prevFrames = receiver.framesReceived;
+            prevBytes = receiver.bytesReceived;
+        }
+    }
+
+    return 0;
+}
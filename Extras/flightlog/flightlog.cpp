@@ -0,0 +1,242 @@
+/*
+   Command-line tool for MulticopterSim flight logs (Source/MainModule/FlightLog.hpp)
+
+   Usage: flightlog info LOG
+          flightlog seek LOG TIME
+          flightlog find LOG COLUMN MIN MAX
+          flightlog csv LOG [START [END]]
+
+   info prints a log's size, time span and compression.  seek prints the
+   sample at (or just before) a simulation time.  find prints the time spans
+   in which a column (e.g. location.z) lies between MIN and MAX, decoding
+   only the chunks whose range overlaps.  csv dumps all columns, optionally
+   between two times.  Logs that were never closed are recovered on the fly.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <FlightLog.hpp>
+
+static const char * COLUMN_NAMES[FlightLog::COL_MOTORS] = {
+    "time",
+    "angularVel.x", "angularVel.y", "angularVel.z",
+    "bodyAccel.x", "bodyAccel.y", "bodyAccel.z",
+    "inertialVel.x", "inertialVel.y", "inertialVel.z",
+    "quaternion.w", "quaternion.x", "quaternion.y", "quaternion.z",
+    "location.x", "location.y", "location.z",
+    "rotation.x", "rotation.y", "rotation.z"
+};
+
+static void columnName(uint8_t column, char * name, size_t size)
+{
+    if (column < FlightLog::COL_MOTORS) {
+        snprintf(name, size, "%s", COLUMN_NAMES[column]);
+    }
+    else {
+        snprintf(name, size, "motor%d", column - FlightLog::COL_MOTORS + 1);
+    }
+}
+
+static int findColumn(FlightLogReader & log, const char * name)
+{
+    for (uint8_t c=0; c<log.getColumnCount(); ++c) {
+        char candidate[32] = {};
+        columnName(c, candidate, sizeof(candidate));
+        if (!strcmp(name, candidate)) return c;
+    }
+
+    return -1;
+}
+
+static void printRow(FlightLogReader & log, uint64_t sample)
+{
+    double time = 0;
+    Dynamics::state_t state = {};
+    double motors[FlightLog::MAX_MOTORS] = {};
+
+    if (!log.read(sample, time, state, motors)) return;
+
+    double row[FlightLog::MAX_COLUMNS] = {};
+    FlightLog::toRow(time, state, motors, log.getMotorCount(), row);
+
+    for (uint8_t c=0; c<log.getColumnCount(); ++c) {
+        printf("%s%.9g", c ? "," : "", row[c]);
+    }
+    printf("\n");
+}
+
+static void printHeading(FlightLogReader & log)
+{
+    for (uint8_t c=0; c<log.getColumnCount(); ++c) {
+        char name[32] = {};
+        columnName(c, name, sizeof(name));
+        printf("%s%s", c ? "," : "", name);
+    }
+    printf("\n");
+}
+
+static int info(FlightLogReader & log)
+{
+    uint64_t bytes = 0;
+    for (uint32_t k=0; k<log.getChunkCount(); ++k) {
+        bytes += log.getChunk(k).size;
+    }
+
+    uint64_t samples = log.getSampleCount();
+    uint64_t raw = samples * log.getColumnCount() * sizeof(double);
+
+    printf("samples:   %llu\n", (unsigned long long)samples);
+    printf("chunks:    %u%s\n", log.getChunkCount(), log.wasRecovered() ? " (recovered; log was not closed)" : "");
+    printf("motors:    %d\n", log.getMotorCount());
+    printf("time:      %.6f to %.6f sec\n", log.getStartTime(), log.getEndTime());
+    printf("encoding:  %s\n", log.getEncoding() == FlightLog::ENCODING_DELTA ? "delta" : "raw");
+    printf("data:      %llu bytes (%.1f%% of raw, %.1f bytes/sample)\n", (unsigned long long)bytes,
+            raw ? 100.0 * bytes / raw : 0, samples ? (double)bytes / samples : 0);
+
+    return 0;
+}
+
+static int seek(FlightLogReader & log, double time)
+{
+    printHeading(log);
+    printRow(log, log.seek(time));
+
+    return 0;
+}
+
+static int find(FlightLogReader & log, const char * name, double minimum, double maximum)
+{
+    int column = findColumn(log, name);
+
+    if (column < 0) {
+        fprintf(stderr, "No column %s\n", name);
+        return 1;
+    }
+
+    uint32_t decoded = 0;
+    bool inside = false;
+    double start = 0, previous = 0;
+
+    for (uint32_t k=0; k<log.getChunkCount(); ++k) {
+
+        const FlightLog::chunk_t & chunk = log.getChunk(k);
+
+        // Skip chunks entirely outside (or entirely inside) the range without decoding them
+        bool none = chunk.maximum[column] < minimum || chunk.minimum[column] > maximum;
+        bool all = chunk.minimum[column] >= minimum && chunk.maximum[column] <= maximum;
+
+        if (none || all) {
+            if (all && !inside) {
+                start = chunk.minimum[FlightLog::COL_TIME];
+                inside = true;
+            }
+            if (none && inside) {
+                printf("%.6f to %.6f\n", start, previous);
+                inside = false;
+            }
+            previous = chunk.maximum[FlightLog::COL_TIME];
+            continue;
+        }
+
+        const double * columns = log.decodeChunk(k);
+        if (!columns) {
+            fprintf(stderr, "Chunk %u is corrupt\n", k);
+            return 1;
+        }
+        decoded++;
+
+        const double * times = &columns[FlightLog::COL_TIME*FlightLog::CHUNK_SIZE];
+        const double * values = &columns[column*FlightLog::CHUNK_SIZE];
+
+        for (uint32_t j=0; j<chunk.count; ++j) {
+
+            bool in = values[j] >= minimum && values[j] <= maximum;
+
+            if (in && !inside) {
+                start = times[j];
+            }
+            if (!in && inside) {
+                printf("%.6f to %.6f\n", start, previous);
+            }
+
+            inside = in;
+            previous = times[j];
+        }
+    }
+
+    if (inside) {
+        printf("%.6f to %.6f\n", start, previous);
+    }
+
+    fprintf(stderr, "decoded %u of %u chunks\n", decoded, log.getChunkCount());
+
+    return 0;
+}
+
+static int csv(FlightLogReader & log, double start, double end)
+{
+    printHeading(log);
+
+    for (uint64_t sample=log.seek(start); sample<log.getSampleCount(); ++sample) {
+
+        double time = 0;
+        Dynamics::state_t state = {};
+
+        if (!log.read(sample, time, state, NULL) || time > end) break;
+
+        // seek() lands on the sample at or just before start
+        if (time < start) continue;
+
+        printRow(log, sample);
+    }
+
+    return 0;
+}
+
+static int usage(const char * name)
+{
+    fprintf(stderr, "Usage: %s info LOG\n", name);
+    fprintf(stderr, "       %s seek LOG TIME\n", name);
+    fprintf(stderr, "       %s find LOG COLUMN MIN MAX\n", name);
+    fprintf(stderr, "       %s csv LOG [START [END]]\n", name);
+    return 1;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 3) {
+        return usage(argv[0]);
+    }
+
+    const char * command = argv[1];
+
+    FlightLogReader log(argv[2]);
+
+    if (!log.isOpen()) {
+        fprintf(stderr, "%s: %s\n", argv[2], log.getMessage());
+        return 1;
+    }
+
+    if (!strcmp(command, "info")) {
+        return info(log);
+    }
+
+    if (!strcmp(command, "seek") && argc > 3) {
+        return seek(log, atof(argv[3]));
+    }
+
+    if (!strcmp(command, "find") && argc > 5) {
+        return find(log, argv[3], atof(argv[4]), atof(argv[5]));
+    }
+
+    if (!strcmp(command, "csv")) {
+        return csv(log, argc > 3 ? atof(argv[3]) : log.getStartTime(), argc > 4 ? atof(argv[4]) : log.getEndTime());
+    }
+
+    return usage(argv[0]);
+}
@@ -0,0 +1,169 @@
+/*
+   Checks Dynamics::computeJacobians() against finite differences, and compares their speed
+
+   Usage: jacobian [TRIALS]
+
+   For each frame, draws random states and motor values, then compares the
+   analytic Jacobians of the state derivative with central differences, and
+   times both.  The finite-difference linearization is the one a controller
+   would otherwise do: 2 * (12 + motorCount) evaluations of the dynamics.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+
+#include <dynamics/QuadXAP.hpp>
+#include <dynamics/OctoXAP.hpp>
+#include <dynamics/ThrustVector.hpp>
+
+static const double EPSILON = 1e-6;
+
+// Exposes a frame's state derivative as a function of state and motor values
+template <class Frame>
+class Probe : public Frame {
+
+    public:
+
+        Probe(Dynamics::Parameters * params) : Frame(params)
+        {
+        }
+
+        void setState(const double x[12])
+        {
+            memcpy(this->_x, x, sizeof(this->_x));
+        }
+
+        // Equation 12, as update() evaluates it once airborne
+        void derivative(const double x[12], double * motorvals, double dxdt[12])
+        {
+            setState(x);
+            this->setMotors(motorvals, 0);
+
+            double rotation[3] = {x[Dynamics::STATE_PHI], x[Dynamics::STATE_THETA], x[Dynamics::STATE_PSI]};
+            double body[3] = {0, 0, -this->_U1 / this->_p->m};
+            double accelNED[3] = {};
+            Dynamics::bodyToInertial(body, rotation, accelNED);
+
+            this->computeStateDerivative(accelNED, accelNED[2] + Dynamics::g);
+
+            memcpy(dxdt, this->_dxdt, sizeof(this->_dxdt));
+        }
+
+        // Central differences, one column at a time
+        void differences(const double x[12], const double * motorvals, double A[12][12], double * B)
+        {
+            uint8_t n = this->motorCount();
+
+            double xp[12] = {}, xm[12] = {};
+            double up[Dynamics::MAX_MOTORS] = {}, um[Dynamics::MAX_MOTORS] = {};
+            double fp[12] = {}, fm[12] = {};
+
+            for (uint8_t k=0; k<12; ++k) {
+                memcpy(xp, x, sizeof(xp));
+                memcpy(xm, x, sizeof(xm));
+                memcpy(up, motorvals, n*sizeof(double));
+                xp[k] += EPSILON;
+                xm[k] -= EPSILON;
+                derivative(xp, up, fp);
+                derivative(xm, up, fm);
+                for (uint8_t j=0; j<12; ++j) {
+                    A[j][k] = (fp[j] - fm[j]) / (2*EPSILON);
+                }
+            }
+
+            for (uint8_t k=0; k<n; ++k) {
+                memcpy(up, motorvals, n*sizeof(double));
+                memcpy(um, motorvals, n*sizeof(double));
+                up[k] += EPSILON;
+                um[k] -= EPSILON;
+                derivative(x, up, fp);
+                derivative(x, um, fm);
+                for (uint8_t j=0; j<12; ++j) {
+                    B[j*n+k] = (fp[j] - fm[j]) / (2*EPSILON);
+                }
+            }
+        }
+};
+
+template <class Frame>
+static void check(const char * name, Dynamics::Parameters & params, uint32_t trials)
+{
+    Probe<Frame> probe(&params);
+
+    uint8_t n = probe.motorCount();
+
+    std::mt19937_64 random(0);
+    std::uniform_real_distribution<double> angle(-1, +1);
+    std::uniform_real_distribution<double> rate(-5, +5);
+    std::uniform_real_distribution<double> motor(0.2, 0.8);
+
+    double worst = 0;
+    double analyticTime = 0;
+    double differenceTime = 0;
+
+    for (uint32_t t=0; t<trials; ++t) {
+
+        double x[12] = {};
+        for (uint8_t k=0; k<12; ++k) {
+            x[k] = (k & 1) ? rate(random) : angle(random);
+        }
+
+        double motorvals[Dynamics::MAX_MOTORS] = {};
+        for (uint8_t k=0; k<n; ++k) {
+            motorvals[k] = motor(random);
+        }
+
+        double A1[12][12] = {}, B1[12*Dynamics::MAX_MOTORS] = {};
+        double A2[12][12] = {}, B2[12*Dynamics::MAX_MOTORS] = {};
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        probe.differences(x, motorvals, A2, B2);
+
+        std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+        probe.setState(x);
+        probe.setMotors(motorvals, 0);
+        probe.computeJacobians(A1, B1);
+
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        differenceTime += std::chrono::duration<double>(middle - start).count();
+        analyticTime += std::chrono::duration<double>(end - middle).count();
+
+        // Relative error, against the scale of each entry
+        for (uint8_t j=0; j<12; ++j) {
+            for (uint8_t k=0; k<12; ++k) {
+                worst = fmax(worst, fabs(A1[j][k] - A2[j][k]) / fmax(1, fabs(A2[j][k])));
+            }
+            for (uint8_t k=0; k<n; ++k) {
+                worst = fmax(worst, fabs(B1[j*n+k] - B2[j*n+k]) / fmax(1, fabs(B2[j*n+k])));
+            }
+        }
+    }
+
+    printf("%-14s worst error %.2e   analytic %6.0f ns   differences %6.0f ns   (%.0fx)\n", name, worst,
+            1e9 * analyticTime / trials, 1e9 * differenceTime / trials, differenceTime / analyticTime);
+}
+
+int main(int argc, char ** argv)
+{
+    uint32_t trials = argc > 1 ? atoi(argv[1]) : 100000;
+
+    // Phantom
+    Dynamics::Parameters params(5.E-06, 2.E-06, 1.380, 0.350, 2, 2, 3, 38E-04, 15000);
+
+    check<QuadXAPDynamics>("QuadXAP", params, trials);
+    check<OctoXAPDynamics>("OctoXAP", params, trials);
+    check<ThrustVectorDynamics>("ThrustVector", params, trials);
+
+    return 0;
+}
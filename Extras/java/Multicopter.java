@@ -1,7 +1,13 @@
 /*
    Java Multicopter class
 
-   Uses UDP sockets to communicate with MulticopterSim
+   Uses UDP sockets, or shared memory on the same host, to communicate with MulticopterSim
+
+   Packets are built and read in direct buffers allocated once, and telemetry
+   and motor values pass between threads through preallocated triple buffers,
+   so a running client makes no garbage for the collector to pause on.
+
+   Needs Java 8 or later.
 
    Copyright(C) 2019 Simon D.Levy
 
@@ -9,138 +15,257 @@
  */
 
 import java.lang.Thread;
-import java.io.*;
-import java.net.DatagramSocket;
-import java.net.DatagramPacket;
 import java.net.InetAddress;
+import java.net.InetSocketAddress;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.channels.DatagramChannel;
+import java.nio.channels.SelectionKey;
+import java.nio.channels.Selector;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.locks.LockSupport;
 
 /**
  * Represents a Multicopter object communicating with MulticopterSim via UDP socket calls.
  */
 public class Multicopter {
 
-    // Inner class 
+    /**
+     * Lock-free triple buffer for an array of values, with one writing thread and
+     * one reading thread.  The writer fills its own array and swaps it for the
+     * middle one; the reader swaps its own for the middle one when that holds
+     * something newer.  Neither ever waits for the other.
+     */
+    private static class TripleBuffer {
+
+        // Set in the middle index when it holds an array the reader hasn't taken
+        private static final int FRESH = 0x04;
+
+        private final double [][] _values;
+
+        // The swaps publish the arrays, as AtomicInteger.getAndSet() is a full fence
+        private final AtomicInteger _middle = new AtomicInteger(0);
+        private int _back = 1;
+        private int _front = 2;
+
+        public TripleBuffer(int size)
+        {
+            _values = new double [3][size];
+        }
+
+        public void write(double [] values, int count)
+        {
+            System.arraycopy(values, 0, _values[_back], 0, count);
+
+            _back = _middle.getAndSet(_back | FRESH) & 0x03;
+        }
+
+        public void read(double [] values, int count)
+        {
+            if ((_middle.get() & FRESH) != 0) {
+                _front = _middle.getAndSet(_front) & 0x03;
+            }
+
+            System.arraycopy(_values[_front], 0, values, 0, count);
+        }
+    }
+
+    // Inner class
     private class MulticopterThread extends Thread {
 
         private final int TIMEOUT = 1000;
 
+        public static final int TELEMETRY_COUNT = 10;
+
         public void run()
         {
+            long deadline = System.nanoTime();
+
             while (true) {
 
-                byte [] motorBytes = doublesToBytes(_motorVals);
+                _motors.read(_motorVals, _motorVals.length);
 
-                DatagramPacket motorPacket = new DatagramPacket(motorBytes, motorBytes.length, _addr, _motorPort);
+                _motorBuf.clear();
 
-                try {
-                    _motorSocket.send(motorPacket);
+                if (_versioned) {
+                    WireProtocol.encode(_motorBuf, WireProtocol.TYPE_MOTORS, _motorVals, _motorVals.length, _sequence++,
+                            _latest[0], 0, false);
                 }
-                catch (Exception e) {
-                    handleException(e);
+                else {
+                    _motorBuf.order(ByteOrder.LITTLE_ENDIAN);
+                    for (int i=0; i<_motorVals.length; ++i) {
+                        _motorBuf.putDouble(_motorVals[i]);
+                    }
                 }
 
-                byte [] telemetryBytes = new byte [8*_telemetry.length];
+                _motorBuf.flip();
 
                 try {
-                    DatagramPacket telemetryPacket = new DatagramPacket(telemetryBytes, telemetryBytes.length, _addr, _telemPort);
-                    _telemSocket.receive(telemetryPacket);
+                    if (_shm != null) {
+                        _shm.send(_motorBuf);
+                    }
+                    else {
+                        _motorChannel.write(_motorBuf);
+                    }
                 }
                 catch (Exception e) {
                     handleException(e);
                 }
 
-                _telemetry = bytesToDoubles(telemetryBytes);
+                _telemBuf.clear();
 
-                if (_telemetry[0] < 0) {
-                    break;
+                try {
+                    if (_shm != null) {
+                        if (_shm.receive(_telemBuf) < 0) {
+                            _telemBuf.limit(0);
+                        }
+                    }
+                    else {
+                        // Waits up to TIMEOUT msec; the buffer stays empty if nothing came
+                        if (_selector.select(TIMEOUT) > 0) {
+                            _selector.selectedKeys().clear();
+                            _telemChannel.receive(_telemBuf);
+                        }
+                        _telemBuf.flip();
+                    }
+                }
+                catch (Exception e) {
+                    handleException(e);
+                    _telemBuf.limit(0);
                 }
 
-                yield();
-            }
-
-            _motorSocket.close();
-            _telemSocket.close();
+                int telemetryLength = _telemBuf.remaining();
 
-        } // run
+                // Versioned packet: reply in kind
+                if (WireProtocol.isPacket(_telemBuf)) {
 
-        public double [] getTelemetry()
-        {
-            return  _telemetry;
-        }
+                    if (!WireProtocol.decode(_telemBuf, _header, _fullTelemetry) ||
+                            _tracker.update(_header) != WireProtocol.SequenceTracker.OK) {
+                        continue;
+                    }
 
-        // Adapted from view-source:https://stackoverflow.com/questions/2905556/how-can-i-convert-a-byte-array-into-a-double-and-back
+                    _versioned = true;
 
-        private byte[] doublesToBytes(double [] doubles)
-        {
-            int n = doubles.length;
+                    _latest[0] = _header.simTime;
+                    System.arraycopy(_fullTelemetry, WireProtocol.TELEM_ANGULAR_VEL, _latest, 1, 3);
+                    System.arraycopy(_fullTelemetry, WireProtocol.TELEM_BODY_ACCEL,  _latest, 4, 3);
+                    System.arraycopy(_fullTelemetry, WireProtocol.TELEM_LOCATION,    _latest, 7, 3);
+                    _telemetry.write(_latest, TELEMETRY_COUNT);
+                }
 
-            byte [] bytes = new byte[8*n];
+                // Legacy packet: time, gyro, accel, location
+                else if (telemetryLength == 8*TELEMETRY_COUNT) {
+                    _telemBuf.order(ByteOrder.LITTLE_ENDIAN);
+                    for (int i=0; i<TELEMETRY_COUNT; ++i) {
+                        _latest[i] = _telemBuf.getDouble(8*i);
+                    }
+                    _telemetry.write(_latest, TELEMETRY_COUNT);
+                }
 
-            for (int i=0; i<n; ++i) {
+                if (_latest[0] < 0) {
+                    break;
+                }
 
-                long l = Double.doubleToRawLongBits(doubles[i]);
+                // With a fixed rate, wait for the next period; otherwise the next telemetry packet sets the pace
+                if (_periodNsec > 0) {
+                    deadline += _periodNsec;
+                    long wait = deadline - System.nanoTime();
+                    if (wait > 0) {
+                        LockSupport.parkNanos(wait);
+                    }
+                    else {
+                        deadline = System.nanoTime(); // fell behind; don't try to catch up
+                    }
+                }
+            }
 
-                for (int j=0; j<8; ++j) {
-                    bytes[i*8+j] = (byte)((l >> (j*8)) & 0xff);
+            if (_shm == null) {
+                try {
+                    _selector.close();
+                    _motorChannel.close();
+                    _telemChannel.close();
+                }
+                catch (Exception e) {
+                    handleException(e);
                 }
             }
 
-            return bytes;
-        }
+        } // run
 
-        private double[] bytesToDoubles(byte [] bytes)
+        public void getTelemetry(double [] telemetry)
         {
-            int n = bytes.length>>3;
-
-            double [] doubles = new double [n];
-
-            for (int i=0; i<n; ++i) {
+            _telemetry.read(telemetry, TELEMETRY_COUNT);
+        }
 
-                long bits = 0;
+        public MulticopterThread(String host, int motorPort, int telemetryPort, int motorCount)
+        {
+            try {
+                InetAddress addr = InetAddress.getByName(host);
 
-                int beg = 8 * i;
+                // Connected, so that each send is a plain write with no address to look up
+                _motorChannel = DatagramChannel.open();
+                _motorChannel.connect(new InetSocketAddress(addr, motorPort));
 
-                for (int j=0; j<8; ++j) {
-                    bits = (bits << 8) | (bytes[beg+8-j-1] & 0xff);
-                }
+                _telemChannel = DatagramChannel.open();
+                _telemChannel.bind(new InetSocketAddress(telemetryPort));
+                _telemChannel.configureBlocking(false);
 
-                doubles[i] = Double.longBitsToDouble(bits);
+                _selector = Selector.open();
+                _telemChannel.register(_selector, SelectionKey.OP_READ);
+            }
+            catch (Exception e) {
+                handleException(e);
             }
 
-            return doubles;
+            allocate(motorCount);
         }
 
-        public MulticopterThread(String host, int motorPort, int telemetryPort, int motorCount)
+        public MulticopterThread(String shmName, int motorCount)
         {
-            _motorPort = motorPort;
-            _telemPort = telemetryPort;
-
             try {
-                _addr = InetAddress.getByName(host);
-                _motorSocket = new DatagramSocket();
-                _telemSocket = new DatagramSocket(telemetryPort);
-                _telemSocket.setSoTimeout(TIMEOUT);
-            } 
+                _shm = new TwoWayShm(shmName, TwoWayShm.CONTROLLER, TIMEOUT);
+            }
             catch (Exception e) {
                 handleException(e);
             }
 
+            allocate(motorCount);
+        }
+
+        private void allocate(int motorCount)
+        {
             _motorVals = new double [motorCount];
+            _motors = new TripleBuffer(motorCount);
 
-            _telemetry = new double [10];
+            _latest = new double [TELEMETRY_COUNT];
+            _telemetry = new TripleBuffer(TELEMETRY_COUNT);
         }
 
-        private int _motorPort;
-        private int _telemPort;
-
+        // Motor values as set by the controller, and this thread's copy of them
+        private TripleBuffer _motors;
         private double [] _motorVals;
 
-        private double [] _telemetry;
+        // Latest telemetry, as received by this thread and as published to the controller
+        private double [] _latest;
+        private TripleBuffer _telemetry;
+
+        private long _periodNsec = 0;
 
-        InetAddress _addr;
+        // Versioned-protocol state, used once the simulator sends a versioned packet
+        private boolean _versioned = false;
+        private long _sequence = 0;
+        private WireProtocol.Header _header = new WireProtocol.Header();
+        private double [] _fullTelemetry = new double [WireProtocol.MAX_VALUES];
+        private WireProtocol.SequenceTracker _tracker = new WireProtocol.SequenceTracker();
 
-        private DatagramSocket _motorSocket;
-        private DatagramSocket _telemSocket;
+        private final ByteBuffer _motorBuf = ByteBuffer.allocateDirect(WireProtocol.MAX_PACKET_SIZE);
+        private final ByteBuffer _telemBuf = ByteBuffer.allocateDirect(WireProtocol.MAX_PACKET_SIZE);
+
+        private DatagramChannel _motorChannel;
+        private DatagramChannel _telemChannel;
+        private Selector _selector;
+
+        private TwoWayShm _shm;
 
         private void handleException(Exception e)
         {
@@ -148,9 +273,12 @@ public class Multicopter {
 
         public void setMotors(double [] motorVals)
         {
-            for (int i=0; i<motorVals.length; ++i) {
-                _motorVals[i] = motorVals[i];
-            }
+            _motors.write(motorVals, Math.min(motorVals.length, _motorVals.length));
+        }
+
+        public void setRate(double hz)
+        {
+            _periodNsec = hz > 0 ? (long)(1e9 / hz) : 0;
         }
 
     } // MulticopterThread
@@ -182,6 +310,17 @@ public class Multicopter {
         _thread = new MulticopterThread(host, motorPort, telemetryPort, 4);
     }
 
+    /**
+      * Creates a Multicopter object that talks to a simulator on this host through shared memory.
+      * The simulator end must busy-poll, since Java can't wake it from a futex sleep.
+      * @param shmName name of shared-memory object, e.g. "/multicopter_sim"
+      * @param motorCount number of motors in vehicle running in simulator
+      */
+    public Multicopter(String shmName, int motorCount)
+    {
+        _thread = new MulticopterThread(shmName, motorCount);
+    }
+
     /**
       * Creates a Multicopter object using default parameters.
       */
@@ -190,6 +329,16 @@ public class Multicopter {
         _thread = new MulticopterThread("127.0.0.1", 5000, 5001, 4);
     }
 
+    /**
+      * Runs the communication loop at a fixed rate, instead of as fast as telemetry arrives.
+      * Call before start().
+      * @param hz loop rate in Hz; zero or less for no fixed rate
+      */
+    public void setRate(double hz)
+    {
+        _thread.setRate(hz);
+    }
+
     /**
       * Begins communication with simulator running on host.
       */
@@ -199,18 +348,31 @@ public class Multicopter {
     }
 
     /**
-      * Returns current vehicle state as an array of the form [time, gx, gy, gz, qw, qx, qy, qz, px, py, pz],
-      * where g=gyro; q=quaternion; p=position.
-      * @return vehicle state 
+      * Returns current vehicle state as an array of the form [time, gx, gy, gz, ax, ay, az, px, py, pz],
+      * where g=gyro; a=accelerometer; p=position.  Call from one thread only.
+      * @return vehicle state, in a new array
       */
     public double [] getState()
     {
-        return _thread.getTelemetry();
+        double [] state = new double [MulticopterThread.TELEMETRY_COUNT];
+
+        _thread.getTelemetry(state);
 
+        return state;
+    }
+
+    /**
+      * Gets the current vehicle state without allocating, for control loops that run for a long time.
+      * Call from one thread only.
+      * @param state array of at least 10 values to fill, as for getState()
+      */
+    public void getState(double [] state)
+    {
+        _thread.getTelemetry(state);
     }
 
     /**
-      * Sets motor values.
+      * Sets motor values.  Call from one thread only.
       * @param motorVals array of values between 0 and 1
       */
     public void setMotors(double [] motorVals)
@@ -35,11 +35,15 @@ public class Takeoff {
         // Start the simulation
         copter.start();
 
+        // Allocated once, so the loop makes no garbage
+        double [] telem = new double [10];
+        double [] motors = new double [4];
+
         // Loop until user hits the stop button
         while (true) {
 
             // Get vehicle state from sim
-            double [] telem = copter.getState();
+            copter.getState(telem);
 
             // Extract time from state.  
             double t =  telem[0];
@@ -67,7 +71,8 @@ public class Takeoff {
             }
 
             // Set motor values in sim
-            copter.setMotors(ones(u, 4));
+            java.util.Arrays.fill(motors, u);
+            copter.setMotors(motors);
 
             // Update for first difference
             zprev = z;
@@ -82,14 +87,4 @@ public class Takeoff {
 
         }
     }
-
-    // Helper function like Matlab/Numpy ones()
-    static double [] ones(double x, int n)
-    {
-        double []  v = new double [n];
-        for (int i=0; i<n; ++i) {
-            v[i] = x;
-        }
-        return v;
-    }
 }
@@ -0,0 +1,230 @@
+/*
+   Shared-memory transport for a controller on the same host as MulticopterSim
+
+   Java end of Extras/sockets/TwoWayShm.hpp; see that file for the layout.
+   Linux only, Java 8 or later.
+
+   Java cannot issue futex wakeups, so this end marks the ring it sends on as
+   sleepless, and the other end polls that ring instead of sleeping on it,
+   whatever mode it was opened in.  Ring indices are published with the
+   load and store fences of sun.misc.Unsafe, the only fences Java 8 has.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+import java.io.IOException;
+import java.io.RandomAccessFile;
+import java.lang.invoke.MethodHandle;
+import java.lang.invoke.MethodHandles;
+import java.lang.reflect.Field;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.MappedByteBuffer;
+import java.nio.channels.FileChannel;
+
+/**
+ * Drop-in alternative to a pair of UDP sockets: send() a packet, receive() a packet.
+ */
+public class TwoWayShm {
+
+    public static final int SIMULATOR  = 0;
+    public static final int CONTROLLER = 1;
+
+    public static final int MAGIC   = 0x4d48534d; // "MSHM"
+    public static final int VERSION = 1;
+
+    public static final int SLOT_COUNT = 64;
+    public static final int SLOT_SIZE  = 1024;
+    public static final int MAX_PACKET = SLOT_SIZE - 4;
+
+    public static final int HEADER_SIZE = 64;
+    public static final int RING_SIZE   = 128 + SLOT_COUNT * SLOT_SIZE;
+    public static final int TOTAL_SIZE  = HEADER_SIZE + 2 * RING_SIZE;
+
+    // Byte offsets within a ring
+    private static final int HEAD      = 0;
+    private static final int SLEEPLESS = 4;
+    private static final int TAIL      = 64;
+    private static final int SLOTS     = 128;
+
+    // Checks the clock only this often while spinning
+    private static final int SPINS_PER_CHECK = 256;
+
+    // Unsafe.loadFence() and Unsafe.storeFence(), found by reflection so that no internal class is named here
+    private static final MethodHandle LOAD_FENCE;
+    private static final MethodHandle STORE_FENCE;
+
+    static {
+        try {
+            Class<?> unsafeClass = Class.forName("sun.misc.Unsafe");
+            Field field = unsafeClass.getDeclaredField("theUnsafe");
+            field.setAccessible(true);
+            Object unsafe = field.get(null);
+            MethodHandles.Lookup lookup = MethodHandles.lookup();
+            LOAD_FENCE = lookup.unreflect(unsafeClass.getMethod("loadFence")).bindTo(unsafe);
+            STORE_FENCE = lookup.unreflect(unsafeClass.getMethod("storeFence")).bindTo(unsafe);
+        }
+        catch (Exception e) {
+            throw new ExceptionInInitializerError(e);
+        }
+    }
+
+    private MappedByteBuffer _buf;
+
+    private int _outgoing;
+    private int _incoming;
+
+    private long _timeoutMsec;
+
+    // Keeps later loads and stores after an index load
+    private static void acquireFence()
+    {
+        try {
+            LOAD_FENCE.invokeExact();
+        }
+        catch (Throwable t) {
+            throw new Error(t);
+        }
+    }
+
+    // Keeps earlier loads and stores before an index store
+    private static void releaseFence()
+    {
+        try {
+            STORE_FENCE.invokeExact();
+        }
+        catch (Throwable t) {
+            throw new Error(t);
+        }
+    }
+
+    private int getAcquire(int offset)
+    {
+        int value = _buf.getInt(offset);
+        acquireFence();
+        return value;
+    }
+
+    private void setRelease(int offset, int value)
+    {
+        releaseFence();
+        _buf.putInt(offset, value);
+    }
+
+    /**
+     * Opens (creating if needed) a shared-memory channel.  Packets the other end sent before this one
+     * opened are kept.
+     * @param name name of shared-memory object, as passed to shm_open()
+     * @param endpoint SIMULATOR or CONTROLLER
+     * @param timeoutMsec receive() timeout in milliseconds; zero waits forever
+     * @throws IOException if the object can't be mapped or has an incompatible layout
+     */
+    public TwoWayShm(String name, int endpoint, long timeoutMsec) throws IOException
+    {
+        try (RandomAccessFile file = new RandomAccessFile("/dev/shm/" + name.replaceFirst("^/", ""), "rw")) {
+
+            // Newly created objects are zero-filled, which is a valid empty state
+            if (file.length() < TOTAL_SIZE) {
+                file.setLength(TOTAL_SIZE);
+            }
+
+            _buf = file.getChannel().map(FileChannel.MapMode.READ_WRITE, 0, TOTAL_SIZE);
+        }
+
+        _buf.order(ByteOrder.LITTLE_ENDIAN);
+
+        if (_buf.getInt(0) != 0 && (_buf.getInt(0) != MAGIC || _buf.getInt(4) != VERSION ||
+                    _buf.getInt(8) != SLOT_SIZE || _buf.getInt(12) != SLOT_COUNT)) {
+            throw new IOException(name + " has an incompatible layout");
+        }
+
+        _buf.putInt(4, VERSION);
+        _buf.putInt(8, SLOT_SIZE);
+        _buf.putInt(12, SLOT_COUNT);
+        _buf.putInt(0, MAGIC);
+
+        _outgoing = HEADER_SIZE + (endpoint == SIMULATOR ? 0 : RING_SIZE);
+        _incoming = HEADER_SIZE + (endpoint == SIMULATOR ? RING_SIZE : 0);
+
+        _timeoutMsec = timeoutMsec;
+
+        // We can't wake the other end, so it must poll for our packets
+        setRelease(_outgoing+SLEEPLESS, 1);
+    }
+
+    /**
+     * Opens a shared-memory channel as a controller, waiting forever in receive().
+     * @param name name of shared-memory object
+     * @throws IOException if the object can't be mapped or has an incompatible layout
+     */
+    public TwoWayShm(String name) throws IOException
+    {
+        this(name, CONTROLLER, 0);
+    }
+
+    /**
+     * Sends a packet.
+     * @param data buffer holding packet between its position and limit; position is not changed
+     * @return false if the packet was dropped because it is too big or the ring is full
+     */
+    public boolean send(ByteBuffer data)
+    {
+        int length = data.remaining();
+
+        int head = _buf.getInt(_outgoing+HEAD);
+
+        if (length > MAX_PACKET || head - getAcquire(_outgoing+TAIL) >= SLOT_COUNT) {
+            return false;
+        }
+
+        int slot = _outgoing + SLOTS + (head & (SLOT_COUNT-1)) * SLOT_SIZE;
+
+        _buf.putInt(slot, length);
+
+        ByteBuffer dst = _buf.duplicate();
+        dst.position(slot + 4);
+        dst.put(data.duplicate());
+
+        setRelease(_outgoing+HEAD, head + 1);
+
+        return true;
+    }
+
+    /**
+     * Receives a packet, spinning until one arrives.
+     * @param data buffer to fill from its position; on return its limit marks the end of the packet
+     * @return packet size in bytes, or -1 on timeout; packets longer than the buffer are truncated
+     */
+    public int receive(ByteBuffer data)
+    {
+        int tail = _buf.getInt(_incoming+TAIL);
+
+        long deadline = System.nanoTime() + _timeoutMsec * 1000000;
+
+        for (int spins=1; getAcquire(_incoming+HEAD) == tail; ++spins) {
+
+            if (_timeoutMsec > 0 && spins % SPINS_PER_CHECK == 0 && System.nanoTime() > deadline) {
+                return -1;
+            }
+        }
+
+        int slot = _incoming + SLOTS + (tail & (SLOT_COUNT-1)) * SLOT_SIZE;
+
+        int length = Math.min(_buf.getInt(slot), data.remaining());
+
+        ByteBuffer src = _buf.duplicate();
+        src.position(slot + 4);
+        src.limit(slot + 4 + length);
+
+        int start = data.position();
+        data.put(src);
+        data.limit(data.position());
+        data.position(start);
+
+        setRelease(_incoming+TAIL, tail + 1);
+
+        return length;
+    }
+}
@@ -0,0 +1,286 @@
+/*
+   Versioned binary packet format for MulticopterSim telemetry and commands
+
+   Matches Extras/sockets/WireProtocol.hpp; see that file for the layout.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+
+/**
+ * Encodes and decodes versioned MulticopterSim packets.
+ */
+public class WireProtocol {
+
+    public static final int MAGIC   = 0x5053434d; // "MCSP"
+    public static final int VERSION = 1;
+
+    public static final int TYPE_TELEMETRY = 1;
+    public static final int TYPE_MOTORS    = 2;
+    public static final int TYPE_SUBSCRIBE = 3;
+    public static final int TYPE_STICKS    = 4;
+
+    public static final int FLAG_FLOAT32 = 0x01;
+
+    public static final int HEADER_SIZE = 32;
+    public static final int MAX_VALUES = 64;
+    public static final int MAX_PACKET_SIZE = HEADER_SIZE + 8 * MAX_VALUES;
+
+    // Offsets of Dynamics::state_t fields in TELEMETRY payload
+    public static final int TELEM_ANGULAR_VEL  = 0;
+    public static final int TELEM_BODY_ACCEL   = 3;
+    public static final int TELEM_INERTIAL_VEL = 6;
+    public static final int TELEM_QUATERNION   = 9;
+    public static final int TELEM_LOCATION     = 13;
+    public static final int TELEM_ROTATION     = 16;
+    public static final int TELEM_COUNT        = 19;
+
+    // Field-selection bits for SUBSCRIBE requests and subscribed TELEMETRY packets
+    public static final int FIELD_ANGULAR_VEL  = 0x01;
+    public static final int FIELD_BODY_ACCEL   = 0x02;
+    public static final int FIELD_INERTIAL_VEL = 0x04;
+    public static final int FIELD_QUATERNION   = 0x08;
+    public static final int FIELD_LOCATION     = 0x10;
+    public static final int FIELD_ROTATION     = 0x20;
+    public static final int FIELD_MOTORS       = 0x40;
+    public static final int FIELD_POSE         = FIELD_LOCATION | FIELD_ROTATION;
+    public static final int FIELD_STATE        = 0x3f;
+
+    /**
+     * Decoded packet header.
+     */
+    public static class Header {
+
+        public int version;
+        public int type;
+        public int flags;
+        public int count;
+        public int vehicleId;
+        public int fields;      // TELEMETRY: FIELD_ bits present; zero means all state fields
+        public long sequence;   // unsigned 32-bit
+        public double simTime;
+        public double sendTime;
+    }
+
+    /**
+     * Wall-clock time in seconds, comparable with the sendTime field of packets from the same host.
+     * @return time in seconds since 1970
+     */
+    public static double now()
+    {
+        return System.currentTimeMillis() / 1000.;
+    }
+
+    /**
+     * Tests for a versioned header, as opposed to a legacy raw-double packet.
+     * @param buf little-endian buffer positioned at start of packet, limit at end
+     * @return true if buf holds a versioned packet
+     */
+    public static boolean isPacket(ByteBuffer buf)
+    {
+        return buf.remaining() >= HEADER_SIZE && buf.order(ByteOrder.LITTLE_ENDIAN).getInt(buf.position()) == MAGIC;
+    }
+
+    /**
+     * Encodes a packet into buf, starting at its current position.
+     * @param buf destination buffer; byte order is set to little-endian
+     * @param type packet type
+     * @param values payload values
+     * @param count number of payload values
+     * @param sequence sender's sequence number
+     * @param simTime simulation time in seconds
+     * @param vehicleId vehicle id
+     * @param float32 send values as float32 instead of float64
+     */
+    public static void encode(ByteBuffer buf, int type, double [] values, int count, long sequence,
+            double simTime, int vehicleId, boolean float32)
+    {
+        encode(buf, type, values, count, sequence, simTime, vehicleId, float32, 0);
+    }
+
+    /**
+     * Encodes a packet with a field mask into buf, starting at its current position.
+     * @param buf destination buffer; byte order is set to little-endian
+     * @param type packet type
+     * @param values payload values
+     * @param count number of payload values
+     * @param sequence sender's sequence number
+     * @param simTime simulation time in seconds
+     * @param vehicleId vehicle id
+     * @param float32 send values as float32 instead of float64
+     * @param fields FIELD_ bits describing a TELEMETRY payload
+     */
+    public static void encode(ByteBuffer buf, int type, double [] values, int count, long sequence,
+            double simTime, int vehicleId, boolean float32, int fields)
+    {
+        buf.order(ByteOrder.LITTLE_ENDIAN);
+
+        buf.putInt(MAGIC);
+        buf.put((byte)VERSION);
+        buf.put((byte)type);
+        buf.put((byte)(float32 ? FLAG_FLOAT32 : 0));
+        buf.put((byte)count);
+        buf.putShort((short)vehicleId);
+        buf.putShort((short)fields);
+        buf.putInt((int)sequence);
+        buf.putDouble(simTime);
+        buf.putDouble(now());
+
+        for (int k=0; k<count; ++k) {
+            if (float32) {
+                buf.putFloat((float)values[k]);
+            }
+            else {
+                buf.putDouble(values[k]);
+            }
+        }
+    }
+
+    /**
+     * Encodes a SUBSCRIBE packet into buf, starting at its current position.
+     * @param buf destination buffer
+     * @param fields FIELD_ bits wanted; zero cancels a subscription
+     * @param divisor receive telemetry every divisor-th simulation step
+     */
+    public static void encodeSubscribe(ByteBuffer buf, int fields, int divisor)
+    {
+        encode(buf, TYPE_SUBSCRIBE, new double [] {fields, divisor}, 2, 0, 0, 0, false);
+    }
+
+    /**
+     * Encodes a STICKS packet into buf, starting at its current position.
+     * @param buf destination buffer
+     * @param sticks throttle, roll, pitch, yaw, aux1, aux2, each between -1 and +1
+     * @param sequence sequence number
+     */
+    public static void encodeSticks(ByteBuffer buf, double [] sticks, int sequence)
+    {
+        encode(buf, TYPE_STICKS, sticks, 6, sequence, 0, 0, false);
+    }
+
+    /**
+     * Decodes a packet from buf, starting at its current position.
+     * @param buf source buffer, limit at end of packet
+     * @param header output header
+     * @param values output values
+     * @return true if packet is well-formed and of a version we understand
+     */
+    public static boolean decode(ByteBuffer buf, Header header, double [] values)
+    {
+        if (!isPacket(buf)) {
+            return false;
+        }
+
+        int pos = buf.position();
+
+        header.version   = buf.get(pos+4) & 0xff;
+        header.type      = buf.get(pos+5) & 0xff;
+        header.flags     = buf.get(pos+6) & 0xff;
+        header.count     = buf.get(pos+7) & 0xff;
+        header.vehicleId = buf.getShort(pos+8) & 0xffff;
+        header.fields    = buf.getShort(pos+10) & 0xffff;
+        header.sequence  = buf.getInt(pos+12) & 0xffffffffL;
+        header.simTime   = buf.getDouble(pos+16);
+        header.sendTime  = buf.getDouble(pos+24);
+
+        boolean float32 = (header.flags & FLAG_FLOAT32) != 0;
+        int valsize = float32 ? 4 : 8;
+
+        if (header.version != VERSION || header.count > values.length ||
+                buf.remaining() < HEADER_SIZE + header.count*valsize) {
+            return false;
+        }
+
+        for (int k=0; k<header.count; ++k) {
+            int offset = pos + HEADER_SIZE + k*valsize;
+            values[k] = float32 ? buf.getFloat(offset) : buf.getDouble(offset);
+        }
+
+        return true;
+    }
+
+    /**
+     * Counts lost, late (reordered) and duplicate packets, and transport latency.
+     */
+    public static class SequenceTracker {
+
+        public static final int OK        = 0;
+        public static final int LATE      = 1;
+        public static final int DUPLICATE = 2;
+        public static final int STALE     = 3;
+
+        public long received;
+        public long lost;
+        public long late;
+        public long duplicates;
+        public double maxLatency;
+
+        private boolean _started;
+        private long _first;
+        private long _highest;
+        private long _window; // bit k set => packet (_highest - k) has arrived
+        private double _latencySum;
+
+        /**
+         * Records arrival of a packet.
+         * @param header header of received packet
+         * @return OK, LATE, DUPLICATE, or STALE; callers should normally ignore anything but OK
+         */
+        public int update(Header header)
+        {
+            received++;
+
+            double latency = now() - header.sendTime;
+            _latencySum += latency;
+            maxLatency = Math.max(maxLatency, latency);
+
+            if (!_started) {
+                _started = true;
+                _first = header.sequence;
+                _highest = header.sequence;
+                _window = 1;
+                return OK;
+            }
+
+            // Signed 32-bit difference handles wraparound
+            int ahead = (int)(header.sequence - _highest);
+
+            if (ahead > 0) {
+                lost += ahead - 1;
+                _window = ahead < 64 ? (_window << ahead) | 1 : 1;
+                _highest = header.sequence;
+                return OK;
+            }
+
+            int behind = -ahead;
+
+            // Packets from before the first one seen were never counted as lost
+            if (behind >= 64 || (int)(header.sequence - _first) < 0) {
+                late++;
+                return STALE;
+            }
+
+            long bit = 1L << behind;
+
+            if ((_window & bit) != 0) {
+                duplicates++;
+                return DUPLICATE;
+            }
+
+            _window |= bit;
+            lost--;
+            late++;
+
+            return LATE;
+        }
+
+        public double meanLatency()
+        {
+            return received > 0 ? _latencySum / received : 0;
+        }
+    }
+}
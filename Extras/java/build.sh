@@ -1,3 +1,4 @@
 set -v
-javac Multicopter.java
-jar cvf multicopter.jar Multicopter*.class
+javac --release 8 Multicopter.java WireProtocol.java TwoWayShm.java
+jar cvf multicopter.jar Multicopter*.class WireProtocol*.class TwoWayShm*.class
+cp multicopter.jar ../matlab/
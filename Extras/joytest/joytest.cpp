@@ -9,16 +9,30 @@
 #include <Joystick.h>
 #include <stdio.h>
 
+#ifdef __linux__
+#include <time.h>
+#endif
+
+// Usage: joytest [device], e.g. joytest /dev/input/js1, joytest evdev:0
 int main(int argc, char ** argv)
 {
-    Joystick js;
+    Joystick js(argc > 1 ? argv[1] : "/dev/input/js0");
     float axes[8] = {0};
 
     while (true) {
 
         if (!js.poll(axes)) {
 
-            printf("thr:%+f rol:%+f pit:%+f yaw:%+f aux:%+f\n", axes[0], axes[1], axes[2], axes[3], axes[4]);
+            printf("thr:%+f rol:%+f pit:%+f yaw:%+f aux:%+f", axes[0], axes[1], axes[2], axes[3], axes[4]);
+
+#ifdef __linux__
+            // Time since the kernel saw the input
+            struct timespec now = {};
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            printf(" age:%.1fms", 1000 * (now.tv_sec + now.tv_nsec / 1e9 - js.getEventTime()));
+#endif
+
+            printf("\n");
         }
     }
 
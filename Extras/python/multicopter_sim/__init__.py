@@ -1,7 +1,7 @@
 '''
   Python Multicopter class
 
-  Uses UDP sockets to communicate with MulticopterSim
+  Uses UDP sockets, or shared memory on the same host, to communicate with MulticopterSim
 
   Copyright(C) 2019 Simon D.Levy
 
@@ -12,27 +12,44 @@ from threading import Thread
 import socket
 import numpy as np
 
+from multicopter_sim import protocol
+from multicopter_sim import shm
+from multicopter_sim.subscriber import Subscriber
+from multicopter_sim.observer import Observer
+from multicopter_sim.vecenv import VecEnv
+from multicopter_sim.stepper import Stepper
+
 class Multicopter(object):
     '''
     Represents a Multicopter object communicating with MulticopterSim via UDP socket calls.
     '''
 
-    def __init__(self, host='127.0.0.1', motorPort=5000, telemetryPort=5001, motorCount=4):
+    def __init__(self, host='127.0.0.1', motorPort=5000, telemetryPort=5001, motorCount=4, shmName=None, divisor=1):
         '''
         Creates a Multicopter object.
         host - name of host running MulticopterSim
         motorPort - port over which this object will send motor commands to host
         telemeteryPort - port over which this object will receive telemetry  from host
         motorCount - number of motors in vehicle running in simulator on host
+        shmName - if given, talk to a simulator on this host through this shared-memory object instead of UDP
+        divisor - simulation steps per motor command, for controllers slower than the simulator
         '''
-     
-        self.motorSocket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-        self.motorSocket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, True)
 
-        self.telemSocket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-        self.telemSocket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, True)
+        self.shm = None
+
+        if shmName is not None:
+
+            self.shm = shm.TwoWayShm(shmName, shm.TwoWayShm.CONTROLLER)
+
+        else:
 
-        self.telemSocket.bind((host, telemetryPort))
+            self.motorSocket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.motorSocket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, True)
+
+            self.telemSocket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+            self.telemSocket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, True)
+
+            self.telemSocket.bind((host, telemetryPort))
 
         self.host = host
         self.motorPort = motorPort
@@ -42,7 +59,15 @@ class Multicopter(object):
         self.thread.daemon = True
 
         self.motorVals = np.zeros(motorCount)
-        self.state = np.zeros(11)
+        self.state = np.zeros(10)
+
+        # Full telemetry and packet statistics, available when simulator sends versioned packets
+        self.telemetry = np.zeros(protocol.TELEM_COUNT)
+        self.tracker = protocol.SequenceTracker()
+        self.versioned = False
+        self.sequence = 0
+        self.divisor = divisor
+        self.subscribed = divisor == 1
 
         self.ready = False
 
@@ -72,19 +97,81 @@ class Multicopter(object):
  
         self.motorVals = np.copy(motorVals)
 
+    def getTelemetry(self):
+        '''
+        Returns full vehicle state (see protocol.TELEM_ offsets) when simulator sends versioned packets.
+        '''
+
+        return self.telemetry
+
     def _run(self):
 
         while True:
 
-            data, _ = self.telemSocket.recvfrom(80)
-            self.state = np.frombuffer(data)
+            data = self._receive()
+
+            # Versioned packet: reply in kind
+            if protocol.is_packet(data):
+
+                packet = protocol.decode(data)
+
+                if packet is None:
+                    continue
+
+                header, telemetry = packet
+
+                # Ignore late and duplicate telemetry
+                if self.tracker.update(header) != protocol.SequenceTracker.OK:
+                    continue
+
+                self.versioned = True
+                self.telemetry = telemetry
+                self.state = np.concatenate(([header.simTime],
+                                             telemetry[protocol.TELEM_ANGULAR_VEL:protocol.TELEM_ANGULAR_VEL+3],
+                                             telemetry[protocol.TELEM_BODY_ACCEL:protocol.TELEM_BODY_ACCEL+3],
+                                             telemetry[protocol.TELEM_LOCATION:protocol.TELEM_LOCATION+3]))
+
+            # Legacy packet: time, gyro, accel, location
+            else:
+                self.state = np.frombuffer(data)
 
             self.ready = True
 
             if self.state[0] < 0:
-                self.motorSocket.close()
-                self.telemSocket.close()
+                self._close()
                 break
 
-            self.motorSocket.sendto(np.ndarray.tobytes(self.motorVals), (self.host, self.motorPort))
+            # Simulator answers a subscription with fresh telemetry, so it takes the place of a command
+            if self.versioned and not self.subscribed:
+                self._send(protocol.encode_subscribe(0, self.divisor))
+                self.subscribed = True
+            elif self.versioned:
+                self._send(protocol.encode(protocol.TYPE_MOTORS, self.motorVals, self.sequence, self.state[0]))
+                self.sequence += 1
+            else:
+                self._send(np.ndarray.tobytes(self.motorVals))
+
+    def _receive(self):
+
+        if self.shm is not None:
+            return self.shm.receive()
+
+        data, _ = self.telemSocket.recvfrom(protocol.MAX_PACKET_SIZE)
+
+        return data
+
+    def _send(self, data):
+
+        if self.shm is not None:
+            self.shm.send(data)
+        else:
+            self.motorSocket.sendto(data, (self.host, self.motorPort))
+
+    def _close(self):
+
+        if self.shm is not None:
+            self.shm.close()
+        else:
+            self.motorSocket.close()
+            self.telemSocket.close()
 
@@ -0,0 +1,122 @@
+'''
+  Passive multicast telemetry observer
+
+  Joins the multicast group that MulticopterSim (or simproxy --multicast)
+  publishes every step's state to.  Any number of observers can listen at
+  once, on this host or others on the LAN, without adding any load to the
+  simulator.
+
+  Copyright(C) 2020 Simon D.Levy
+
+  MIT License
+'''
+
+from threading import Thread
+import socket
+
+from multicopter_sim import protocol
+
+
+class Observer(object):
+    '''
+    Receives vehicle state from a multicast group.
+    '''
+
+    def __init__(self, group='239.255.77.1', port=5003, interface='0.0.0.0'):
+        '''
+        Creates an Observer object.
+        group - multicast group address
+        port - port the simulator publishes to
+        interface - address of local interface on which to join the group
+        '''
+
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, True)
+        if hasattr(socket, 'SO_REUSEPORT'):
+            self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, True)
+        self.sock.bind(('', port))
+
+        membership = socket.inet_aton(group) + socket.inet_aton(interface)
+        self.sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+
+        self.sock.settimeout(1.0)
+
+        self.tracker = protocol.SequenceTracker()
+        self.simTime = None
+        self.values = {}
+
+        self.running = False
+        self.thread = Thread(target=self._run)
+        self.thread.daemon = True
+
+    def start(self):
+        '''
+        Begins receiving telemetry.
+        '''
+
+        self.running = True
+        self.thread.start()
+
+    def stop(self):
+        '''
+        Leaves the group.
+        '''
+
+        self.running = False
+        self.thread.join()
+        self.sock.close()
+
+    def getTime(self):
+        '''
+        Returns simulation time of latest telemetry, or None before any has arrived.
+        '''
+
+        return self.simTime
+
+    def getFields(self):
+        '''
+        Returns latest telemetry as a dictionary of named arrays; see protocol.unpack_fields().
+        '''
+
+        return self.values
+
+    def receive(self):
+        '''
+        Waits up to a second for the next packet, returning True if it brought new telemetry.
+        For use instead of start(), by programs that want every packet.
+        '''
+
+        try:
+            data = self.sock.recv(protocol.MAX_PACKET_SIZE)
+        except socket.timeout:
+            return False
+
+        packet = protocol.decode(data)
+
+        if packet is None:
+            return False
+
+        header, values = packet
+
+        if header.type != protocol.TYPE_TELEMETRY:
+            return False
+
+        status = self.tracker.update(header)
+
+        # Sequence restarts with each simulator session
+        if status == protocol.SequenceTracker.STALE:
+            self.tracker = protocol.SequenceTracker()
+            status = self.tracker.update(header)
+
+        if status != protocol.SequenceTracker.OK:
+            return False
+
+        self.values = protocol.unpack_fields(header, values)
+        self.simTime = header.simTime
+
+        return True
+
+    def _run(self):
+
+        while self.running:
+            self.receive()
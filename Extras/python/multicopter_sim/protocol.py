@@ -0,0 +1,215 @@
+'''
+  Versioned binary packet format for MulticopterSim telemetry and commands
+
+  Matches Extras/sockets/WireProtocol.hpp; see that file for the layout.
+
+  Copyright(C) 2020 Simon D.Levy
+
+  MIT License
+'''
+
+import struct
+import time
+import numpy as np
+
+MAGIC = 0x5053434d  # "MCSP"
+VERSION = 1
+
+TYPE_TELEMETRY = 1
+TYPE_MOTORS = 2
+TYPE_SUBSCRIBE = 3
+TYPE_STICKS = 4
+
+FLAG_FLOAT32 = 0x01
+
+# magic, version, type, flags, count, vehicleId, fields, sequence, simTime, sendTime
+HEADER = struct.Struct('<IBBBBHHIdd')
+HEADER_SIZE = HEADER.size
+
+MAX_VALUES = 64
+MAX_PACKET_SIZE = HEADER_SIZE + 8 * MAX_VALUES
+
+# Offsets of Dynamics::state_t fields in TELEMETRY payload
+TELEM_ANGULAR_VEL = 0
+TELEM_BODY_ACCEL = 3
+TELEM_INERTIAL_VEL = 6
+TELEM_QUATERNION = 9
+TELEM_LOCATION = 13
+TELEM_ROTATION = 16
+TELEM_COUNT = 19
+
+# Field-selection bits for SUBSCRIBE requests and subscribed TELEMETRY packets
+FIELD_ANGULAR_VEL = 0x01
+FIELD_BODY_ACCEL = 0x02
+FIELD_INERTIAL_VEL = 0x04
+FIELD_QUATERNION = 0x08
+FIELD_LOCATION = 0x10
+FIELD_ROTATION = 0x20
+FIELD_MOTORS = 0x40
+FIELD_POSE = FIELD_LOCATION | FIELD_ROTATION
+FIELD_STATE = 0x3f
+
+# Names and sizes of state fields, in payload order
+_STATE_FIELDS = (('angularVel', 3), ('bodyAccel', 3), ('inertialVel', 3), ('quaternion', 4), ('location', 3), ('rotation', 3))
+
+
+class Header(object):
+    '''
+    Decoded packet header.
+    '''
+
+    def __init__(self, fields):
+
+        (self.magic, self.version, self.type, self.flags, self.count, self.vehicleId,
+         self.fields, self.sequence, self.simTime, self.sendTime) = fields
+
+
+def now():
+    '''
+    Wall-clock time in seconds, comparable with the sendTime field of packets from the same host.
+    '''
+    return time.time()
+
+
+def is_packet(data):
+    '''
+    Returns True if data starts with a versioned header, False for legacy raw-double packets.
+    '''
+    return len(data) >= HEADER_SIZE and struct.unpack_from('<I', data)[0] == MAGIC
+
+
+def encode(ptype, values, sequence, simTime=0, vehicleId=0, float32=False, sendTime=None, fields=0):
+    '''
+    Returns a packet as bytes.
+    '''
+    values = np.asarray(values, dtype='<f4' if float32 else '<f8')
+    header = HEADER.pack(MAGIC, VERSION, ptype, FLAG_FLOAT32 if float32 else 0, len(values), vehicleId, fields,
+                         sequence & 0xffffffff, simTime, now() if sendTime is None else sendTime)
+    return header + values.tobytes()
+
+
+def decode(data):
+    '''
+    Returns (header, values) for a well-formed packet, or None.  Values are a float64 numpy array.
+    '''
+    if not is_packet(data):
+        return None
+
+    header = Header(HEADER.unpack_from(data))
+
+    dtype = '<f4' if header.flags & FLAG_FLOAT32 else '<f8'
+    size = HEADER_SIZE + header.count * np.dtype(dtype).itemsize
+
+    if header.version != VERSION or len(data) < size:
+        return None
+
+    values = np.frombuffer(data, dtype=dtype, count=header.count, offset=HEADER_SIZE).astype(np.float64)
+
+    return header, values
+
+
+def encode_subscribe(fields, divisor=1, sequence=0, vehicleId=0):
+    '''
+    Returns a SUBSCRIBE packet asking for the given FIELD_ bits every divisor-th simulation step.
+    Zero fields cancels a subscription.
+    '''
+    return encode(TYPE_SUBSCRIBE, (fields, divisor), sequence, vehicleId=vehicleId)
+
+
+def encode_sticks(sticks, simTime=0, sequence=0, vehicleId=0):
+    '''
+    Returns a STICKS packet holding throttle, roll, pitch, yaw, aux1, aux2, each between -1 and +1.
+    '''
+    return encode(TYPE_STICKS, sticks, sequence, simTime=simTime, vehicleId=vehicleId)
+
+
+def unpack_fields(header, values):
+    '''
+    Returns a dictionary of named numpy arrays for the fields of a TELEMETRY packet:
+    angularVel, bodyAccel, inertialVel, quaternion, location, rotation, motors.
+    '''
+    fields = header.fields or FIELD_STATE
+    result = {}
+    offset = 0
+
+    for bit, (name, size) in enumerate(_STATE_FIELDS):
+        if fields & (1 << bit):
+            result[name] = values[offset:offset+size]
+            offset += size
+
+    if fields & FIELD_MOTORS:
+        result['motors'] = values[offset:]
+
+    return result
+
+
+class SequenceTracker(object):
+    '''
+    Counts lost, late (reordered) and duplicate packets, and transport latency.
+    '''
+
+    OK, LATE, DUPLICATE, STALE = range(4)
+
+    def __init__(self):
+
+        self.received = 0
+        self.lost = 0
+        self.late = 0
+        self.duplicates = 0
+        self.maxLatency = 0
+        self._latencySum = 0
+        self._first = None
+        self._highest = None
+        self._window = 0  # bit k set => packet (highest - k) has arrived
+
+    def update(self, header, receiveTime=None):
+        '''
+        Records arrival of a packet, returning one of OK, LATE, DUPLICATE, STALE.
+        Callers should normally ignore anything but OK.
+        '''
+
+        self.received += 1
+
+        latency = (now() if receiveTime is None else receiveTime) - header.sendTime
+        self._latencySum += latency
+        self.maxLatency = max(self.maxLatency, latency)
+
+        seq = header.sequence
+
+        if self._highest is None:
+            self._first = seq
+            self._highest = seq
+            self._window = 1
+            return self.OK
+
+        # Signed 32-bit difference handles wraparound
+        ahead = ((seq - self._highest + 0x80000000) & 0xffffffff) - 0x80000000
+
+        if ahead > 0:
+            self.lost += ahead - 1
+            self._window = ((self._window << ahead) | 1) & 0xffffffffffffffff if ahead < 64 else 1
+            self._highest = seq
+            return self.OK
+
+        behind = -ahead
+
+        # Packets from before the first one seen were never counted as lost
+        if behind >= 64 or ((seq - self._first) & 0x80000000):
+            self.late += 1
+            return self.STALE
+
+        bit = 1 << behind
+
+        if self._window & bit:
+            self.duplicates += 1
+            return self.DUPLICATE
+
+        self._window |= bit
+        self.lost -= 1
+        self.late += 1
+
+        return self.LATE
+
+    def meanLatency(self):
+
+        return self._latencySum / self.received if self.received else 0
@@ -0,0 +1,209 @@
+'''
+  Shared-memory transport for a controller on the same host as MulticopterSim
+
+  Python end of Extras/sockets/TwoWayShm.hpp; see that file for the layout.
+  Linux on x86 only.  Python has no memory fences, so ring indices are read
+  and written as aligned 32-bit words, relying on x86 keeping stores in
+  order with stores and loads in order with loads; on other processors a
+  receiver could see a packet's index before the packet itself.
+
+  Copyright(C) 2020 Simon D.Levy
+
+  MIT License
+'''
+
+import os
+import mmap
+import time
+import ctypes
+import platform
+import numpy as np
+
+MAGIC = 0x4d48534d  # "MSHM"
+VERSION = 1
+
+SLOT_COUNT = 64
+SLOT_SIZE = 1024
+MAX_PACKET = SLOT_SIZE - 4
+
+HEADER_SIZE = 64
+RING_SIZE = 128 + SLOT_COUNT * SLOT_SIZE
+TOTAL_SIZE = HEADER_SIZE + 2 * RING_SIZE
+
+# Byte offsets within a ring
+HEAD = 0
+SLEEPLESS = 4
+TAIL = 64
+WAITERS = 68
+SLOTS = 128
+
+FUTEX_WAIT = 0
+FUTEX_WAKE = 1
+
+# Plain Python stores can't be ordered against loads, so a futex sleep may
+# occasionally miss a wakeup; sleeping in slices bounds the cost of that.
+FUTEX_SLICE = 0.001
+
+_SYS_FUTEX = {'x86_64': 202, 'AMD64': 202, 'i386': 240, 'i686': 240}.get(platform.machine())
+
+
+class _Timespec(ctypes.Structure):
+
+    _fields_ = [('tv_sec', ctypes.c_long), ('tv_nsec', ctypes.c_long)]
+
+
+class TwoWayShm(object):
+    '''
+    Drop-in alternative to a pair of UDP sockets: send() a packet, receive() a packet.
+    '''
+
+    SIMULATOR, CONTROLLER = range(2)
+
+    BUSY_POLL, FUTEX = range(2)
+
+    def __init__(self, name='/multicopter_sim', endpoint=CONTROLLER, mode=FUTEX, timeout=None):
+        '''
+        Opens (creating if needed) a shared-memory channel.
+        name - name of shared-memory object, as passed to shm_open()
+        endpoint - SIMULATOR or CONTROLLER
+        mode - BUSY_POLL or FUTEX; how receive() waits for packets
+        timeout - receive() timeout in seconds, or None to wait forever
+        '''
+
+        if _SYS_FUTEX is None:
+            raise IOError('Shared memory needs an x86 processor, not ' + platform.machine())
+
+        fd = os.open('/dev/shm/' + name.lstrip('/'), os.O_RDWR | os.O_CREAT, 0o666)
+
+        try:
+            # Newly created objects are zero-filled, which is a valid empty state
+            if os.fstat(fd).st_size < TOTAL_SIZE:
+                os.ftruncate(fd, TOTAL_SIZE)
+            self._mm = mmap.mmap(fd, TOTAL_SIZE)
+        finally:
+            os.close(fd)
+
+        header = np.frombuffer(self._mm, dtype='<u4', count=4)
+
+        if header[0] and tuple(header) != (MAGIC, VERSION, SLOT_SIZE, SLOT_COUNT):
+            raise IOError('%s has an incompatible layout' % name)
+
+        header[1:] = VERSION, SLOT_SIZE, SLOT_COUNT
+        header[0] = MAGIC
+
+        outgoing = HEADER_SIZE + (0 if endpoint == self.SIMULATOR else RING_SIZE)
+        incoming = HEADER_SIZE + (RING_SIZE if endpoint == self.SIMULATOR else 0)
+
+        self._outgoing = self._ring(outgoing)
+        self._incoming = self._ring(incoming)
+
+        self.mode = mode
+        self.timeout = timeout
+
+        self._libc = ctypes.CDLL(None, use_errno=True)
+        self._outgoingHeadAddr = ctypes.addressof(ctypes.c_uint32.from_buffer(self._mm, outgoing + HEAD))
+        self._incomingHeadAddr = ctypes.addressof(ctypes.c_uint32.from_buffer(self._mm, incoming + HEAD))
+
+        # This end can wake a sleeping receiver
+        self._outgoing['sleepless'][0] = 0
+
+    def _ring(self, offset):
+
+        return {'head': np.frombuffer(self._mm, dtype='<u4', count=1, offset=offset+HEAD),
+                'sleepless': np.frombuffer(self._mm, dtype='<u4', count=1, offset=offset+SLEEPLESS),
+                'tail': np.frombuffer(self._mm, dtype='<u4', count=1, offset=offset+TAIL),
+                'waiters': np.frombuffer(self._mm, dtype='<u4', count=1, offset=offset+WAITERS),
+                'slots': np.frombuffer(self._mm, dtype=np.uint8, count=SLOT_COUNT*SLOT_SIZE,
+                                       offset=offset+SLOTS).reshape(SLOT_COUNT, SLOT_SIZE)}
+
+    def send(self, data):
+        '''
+        Sends a packet (bytes or numpy array).  Returns False if the packet was dropped
+        because it is too big or the ring is full.
+        '''
+
+        data = np.frombuffer(data, dtype=np.uint8)
+
+        ring = self._outgoing
+
+        head = int(ring['head'][0])
+
+        if len(data) > MAX_PACKET or (head - int(ring['tail'][0])) & 0xffffffff >= SLOT_COUNT:
+            return False
+
+        slot = ring['slots'][head & (SLOT_COUNT-1)]
+        slot[:4].view('<u4')[0] = len(data)
+        slot[4:4+len(data)] = data
+
+        ring['head'][0] = (head + 1) & 0xffffffff
+
+        # Waking unconditionally avoids racing with the receiver's waiter count
+        self._libc.syscall(_SYS_FUTEX, ctypes.c_void_p(self._outgoingHeadAddr), FUTEX_WAKE, 1, None, None, 0)
+
+        return True
+
+    def receive_into(self, buf):
+        '''
+        Copies the next packet into buf (a writable uint8 numpy array), returning its size, or -1 on timeout.
+        Packets longer than buf are truncated.
+        '''
+
+        ring = self._incoming
+
+        tail = int(ring['tail'][0])
+
+        if not self._wait(tail):
+            return -1
+
+        slot = ring['slots'][tail & (SLOT_COUNT-1)]
+        length = min(int(slot[:4].view('<u4')[0]), len(buf))
+        buf[:length] = slot[4:4+length]
+
+        ring['tail'][0] = (tail + 1) & 0xffffffff
+
+        return length
+
+    def receive(self, maxsize=MAX_PACKET):
+        '''
+        Returns the next packet as bytes, or None on timeout.
+        '''
+
+        buf = np.empty(maxsize, dtype=np.uint8)
+
+        length = self.receive_into(buf)
+
+        return None if length < 0 else buf[:length].tobytes()
+
+    def close(self):
+
+        self._outgoing = self._incoming = None
+        self._mm.close()
+
+    def _wait(self, tail):
+
+        ring = self._incoming
+
+        deadline = None if self.timeout is None else time.monotonic() + self.timeout
+
+        while ring['head'][0] == tail:
+
+            remaining = FUTEX_SLICE if deadline is None else min(deadline - time.monotonic(), FUTEX_SLICE)
+
+            if remaining <= 0:
+                return False
+
+            # A sleepless (Java) sender can't wake us
+            if self.mode == self.BUSY_POLL or ring['sleepless'][0]:
+                continue
+
+            # Only this end changes the waiter count, so a plain store suffices
+            ring['waiters'][0] += 1
+
+            if ring['head'][0] == tail:
+                timeout = _Timespec(0, int(remaining * 1e9))
+                self._libc.syscall(_SYS_FUTEX, ctypes.c_void_p(self._incomingHeadAddr), FUTEX_WAIT,
+                                   ctypes.c_uint32(tail), ctypes.byref(timeout), None, 0)
+
+            ring['waiters'][0] -= 1
+
+        return True
@@ -0,0 +1,264 @@
+'''
+  Step-synchronous client for one or many vehicles, with no threads
+
+  Where Multicopter runs a thread that keeps exchanging packets while the
+  controller reads and writes shared state, a Stepper exchanges exactly one
+  command and one telemetry packet per vehicle on each call to step(), from
+  the caller's own thread.  One selector waits on every simulator's socket
+  at once, so a single loop can fly many vehicles.
+
+  Packets are built and read in place: motor values are written straight into
+  a preallocated outgoing packet, telemetry is received with recv_into into a
+  preallocated buffer, and results land in numpy arrays allocated once, so a
+  control loop makes next to no garbage.
+
+  Copyright(C) 2020 Simon D.Levy
+
+  MIT License
+'''
+
+import selectors
+import socket
+import time
+import numpy as np
+
+from multicopter_sim import protocol
+
+# Telemetry values making up a state: gyro, accel, location (the time comes from the header)
+_STATE_INDEX = np.array([protocol.TELEM_ANGULAR_VEL + k for k in range(3)] +
+                        [protocol.TELEM_BODY_ACCEL + k for k in range(3)] +
+                        [protocol.TELEM_LOCATION + k for k in range(3)])
+
+_LEGACY_SIZE = 8 * 10
+
+
+class _Link(object):
+    '''
+    One simulator: a socket, its receive buffer, and the vehicles behind it.
+    '''
+
+    def __init__(self, host, motorPort, telemetryPort, first, count):
+
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, True)
+        self.sock.bind((host, telemetryPort))
+        self.sock.setblocking(False)
+
+        # Commands go out through the telemetry socket, so a swarm simulator replies to the port we listen on
+        self.address = (host, motorPort)
+
+        self.first = first
+        self.count = count
+
+        self.versioned = count > 1
+        self.tracker = [protocol.SequenceTracker() for _ in range(count)]
+
+        self.buffer = bytearray(protocol.MAX_PACKET_SIZE)
+        self.values64 = np.frombuffer(self.buffer, dtype='<f8', count=protocol.MAX_VALUES,
+                                      offset=protocol.HEADER_SIZE)
+        self.values32 = np.frombuffer(self.buffer, dtype='<f4', count=protocol.MAX_VALUES,
+                                      offset=protocol.HEADER_SIZE)
+        self.legacy = np.frombuffer(self.buffer, dtype='<f8', count=10)
+
+
+class Stepper(object):
+    '''
+    Flies one or more vehicles in lockstep with the simulator.
+    '''
+
+    def __init__(self, count=1, motorCount=4, host='127.0.0.1', motorPort=5000, telemetryPort=5001,
+                 simulators=None, timeout=1.0):
+        '''
+        Creates a Stepper object.
+        count - vehicles per simulator; more than one needs a simulator serving a swarm (simproxy --swarm)
+        motorCount - number of motors in each vehicle
+        host, motorPort, telemetryPort - where the simulator is, as for Multicopter
+        simulators - list of (host, motorPort, telemetryPort), to fly the vehicles of several simulators together
+        timeout - seconds step() waits for telemetry before giving up on the vehicles that haven't answered
+        '''
+
+        if simulators is None:
+            simulators = [(host, motorPort, telemetryPort)]
+
+        self.count = count * len(simulators)
+        self.motorCount = motorCount
+        self.timeout = timeout
+
+        self.selector = selectors.DefaultSelector()
+        self.links = []
+
+        for k, (linkHost, linkMotorPort, linkTelemetryPort) in enumerate(simulators):
+            link = _Link(linkHost, linkMotorPort, linkTelemetryPort, k * count, count)
+            self.selector.register(link.sock, selectors.EVENT_READ, link)
+            self.links.append(link)
+
+        # Results of the latest step, updated in place: [time, gx, gy, gz, ax, ay, az, px, py, pz] per vehicle,
+        # full state (see protocol.TELEM_ offsets) per vehicle when the simulator sends versioned packets,
+        # whether each vehicle answered, and whether its simulator has stopped (negative time)
+        self.states = np.zeros((self.count, 10))
+        self.telemetry = np.zeros((self.count, protocol.TELEM_COUNT))
+        self.fresh = np.zeros(self.count, dtype=np.bool_)
+        self.done = np.zeros(self.count, dtype=np.bool_)
+
+        # Outgoing MOTORS packet per vehicle, whose values the caller can write in place through self.motors
+        packetSize = protocol.HEADER_SIZE + 8 * motorCount
+        self.packets = bytearray(self.count * packetSize)
+        self.motors = np.frombuffer(self.packets, dtype='<f8').reshape(self.count, -1)[:, protocol.HEADER_SIZE//8:]
+        self.packetViews = [memoryview(self.packets)[v*packetSize:(v+1)*packetSize] for v in range(self.count)]
+
+        # Legacy simulators get the motor values alone
+        self.payloadViews = [view[protocol.HEADER_SIZE:] for view in self.packetViews]
+
+        self.sequence = 0
+
+        self._answered = 0
+
+    def start(self):
+        '''
+        Waits for each vehicle's first telemetry, checking in with the swarm simulators first so they know
+        where to send it.  Returns the states.
+        '''
+
+        for link in self.links:
+            if link.count > 1:
+                for v in range(link.first, link.first + link.count):
+                    self._send(link, v)
+
+        self.sequence += 1
+
+        self._wait()
+
+        return self._result(self.states)
+
+    def step(self, motors=None):
+        '''
+        Sends each vehicle's motor values (count x motorCount, between 0 and 1) and waits for the telemetry
+        they produce.  Pass None after writing self.motors in place.  Returns the states, which are updated in
+        place by each step; with one vehicle, its state alone.  Vehicles whose simulators have stopped are
+        skipped.
+        '''
+
+        if motors is not None:
+            self.motors[:] = motors
+
+        for link in self.links:
+            for v in range(link.first, link.first + link.count):
+                if not self.done[v]:
+                    self._send(link, v)
+
+        self.sequence += 1
+
+        self._wait()
+
+        return self._result(self.states)
+
+    def getTelemetry(self):
+        '''
+        Returns full vehicle states (see protocol.TELEM_ offsets) when simulators send versioned packets.
+        '''
+
+        return self._result(self.telemetry)
+
+    def close(self):
+
+        for link in self.links:
+            self.selector.unregister(link.sock)
+            link.sock.close()
+
+        self.selector.close()
+        self.links = []
+
+    def _result(self, array):
+
+        return array[0] if self.count == 1 else array
+
+    def _send(self, link, v):
+
+        packet = self.packetViews[v]
+
+        if link.versioned:
+            protocol.HEADER.pack_into(packet, 0, protocol.MAGIC, protocol.VERSION, protocol.TYPE_MOTORS, 0,
+                                      self.motorCount, v - link.first, 0, self.sequence & 0xffffffff,
+                                      self.states[v, 0], protocol.now())
+            link.sock.sendto(packet, link.address)
+        else:
+            link.sock.sendto(self.payloadViews[v], link.address)
+
+    def _wait(self):
+
+        self.fresh[:] = False
+
+        self._answered = np.count_nonzero(self.done)
+
+        deadline = time.monotonic() + self.timeout
+
+        while self._answered < self.count:
+
+            remaining = deadline - time.monotonic()
+
+            if remaining <= 0:
+                break
+
+            for key, _ in self.selector.select(remaining):
+                self._drain(key.data)
+
+    def _drain(self, link):
+
+        while True:
+
+            try:
+                size = link.sock.recv_into(link.buffer)
+            except (BlockingIOError, InterruptedError):
+                return
+
+            self._receive(link, size)
+
+    def _receive(self, link, size):
+
+        buffer = link.buffer
+
+        fields = protocol.HEADER.unpack_from(buffer) if size >= protocol.HEADER_SIZE else None
+
+        # Versioned packet: reply in kind
+        if fields is not None and fields[0] == protocol.MAGIC:
+
+            header = protocol.Header(fields)
+
+            float32 = header.flags & protocol.FLAG_FLOAT32
+
+            if (header.version != protocol.VERSION or header.type != protocol.TYPE_TELEMETRY or
+                    header.count < protocol.TELEM_COUNT or header.fields not in (0, protocol.FIELD_STATE) or
+                    size < protocol.HEADER_SIZE + header.count * (4 if float32 else 8) or
+                    header.vehicleId >= link.count):
+                return
+
+            # Ignore late and duplicate telemetry
+            if link.tracker[header.vehicleId].update(header) != protocol.SequenceTracker.OK:
+                return
+
+            link.versioned = True
+
+            v = link.first + header.vehicleId
+
+            telemetry = self.telemetry[v]
+            telemetry[:] = (link.values32 if float32 else link.values64)[:protocol.TELEM_COUNT]
+
+            state = self.states[v]
+            state[0] = header.simTime
+            np.take(telemetry, _STATE_INDEX, out=state[1:])
+
+        # Legacy packet: time, gyro, accel, location
+        elif size == _LEGACY_SIZE and link.count == 1:
+
+            v = link.first
+            self.states[v] = link.legacy
+
+        else:
+            return
+
+        if not self.fresh[v] and not self.done[v]:
+            self.fresh[v] = True
+            self._answered += 1
+
+        # Negative time means the simulator has stopped
+        self.done[v] = self.states[v, 0] < 0
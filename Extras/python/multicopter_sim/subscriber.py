@@ -0,0 +1,108 @@
+'''
+  Passive telemetry subscriber for loggers, plotters and dashboards
+
+  Asks MulticopterSim for just the state fields it needs, at a fraction of
+  the simulation rate, and renews the subscription while it runs.
+
+  Copyright(C) 2020 Simon D.Levy
+
+  MIT License
+'''
+
+from threading import Thread
+import socket
+import time
+
+from multicopter_sim import protocol
+
+
+class Subscriber(object):
+    '''
+    Receives a subset of vehicle state from MulticopterSim.
+    '''
+
+    RENEW_PERIOD = 1.0  # seconds; publisher leases last longer than this
+
+    def __init__(self, fields=protocol.FIELD_POSE, divisor=10, host='127.0.0.1', port=5002):
+        '''
+        Creates a Subscriber object.
+        fields - protocol.FIELD_ bits for the state fields wanted
+        divisor - receive telemetry every divisor-th simulation step
+        host - name of host running MulticopterSim
+        port - port on which simulator accepts subscriptions
+        '''
+
+        self.fields = fields
+        self.divisor = divisor
+        self.address = (host, port)
+
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(self.RENEW_PERIOD)
+
+        self.tracker = protocol.SequenceTracker()
+        self.simTime = None
+        self.values = {}
+
+        self.running = False
+        self.thread = Thread(target=self._run)
+        self.thread.daemon = True
+
+    def start(self):
+        '''
+        Subscribes and begins receiving telemetry.
+        '''
+
+        self.running = True
+        self.thread.start()
+
+    def stop(self):
+        '''
+        Cancels the subscription.
+        '''
+
+        self.running = False
+        self.thread.join()
+        self.sock.sendto(protocol.encode_subscribe(0), self.address)
+        self.sock.close()
+
+    def getTime(self):
+        '''
+        Returns simulation time of latest telemetry, or None before any has arrived.
+        '''
+
+        return self.simTime
+
+    def getFields(self):
+        '''
+        Returns latest telemetry as a dictionary of named arrays; see protocol.unpack_fields().
+        '''
+
+        return self.values
+
+    def _run(self):
+
+        renewed = 0
+
+        while self.running:
+
+            if time.time() - renewed > self.RENEW_PERIOD:
+                self.sock.sendto(protocol.encode_subscribe(self.fields, self.divisor), self.address)
+                renewed = time.time()
+
+            try:
+                data = self.sock.recv(protocol.MAX_PACKET_SIZE)
+            except socket.timeout:
+                continue
+
+            packet = protocol.decode(data)
+
+            if packet is None:
+                continue
+
+            header, values = packet
+
+            if header.type != protocol.TYPE_TELEMETRY or self.tracker.update(header) != protocol.SequenceTracker.OK:
+                continue
+
+            self.values = protocol.unpack_fields(header, values)
+            self.simTime = header.simTime
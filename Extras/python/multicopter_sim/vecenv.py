@@ -0,0 +1,159 @@
+'''
+  Vectorized environment for training controllers on many vehicles at once
+
+  Loads the VecEnv shared library built in ../vecenv, which steps N vehicles
+  in-process with no simulator, sockets or threads.  The actions, obs, reward
+  and done arrays are numpy views onto the library's own buffers, so writing
+  actions in place and reading the results costs no copying.
+
+  Copyright(C) 2020 Simon D.Levy
+
+  MIT License
+'''
+
+import ctypes
+import os
+import numpy as np
+
+# Phantom parameters: b, d, m, l, Ix, Iy, Iz, Jr, maxrpm
+PHANTOM = (5.E-06, 2.E-06, 1.380, 0.350, 2, 2, 3, 38E-04, 15000)
+
+# Offsets of fields in an observation (see Dynamics::state_t)
+OBS_ANGULAR_VEL = 0
+OBS_BODY_ACCEL = 3
+OBS_INERTIAL_VEL = 6
+OBS_QUATERNION = 9
+OBS_LOCATION = 13
+OBS_ROTATION = 16
+OBS_SIZE = 19
+
+
+def _load(path):
+
+    lib = ctypes.CDLL(path)
+
+    p = ctypes.c_void_p
+    u32 = ctypes.c_uint32
+    dbl = ctypes.POINTER(ctypes.c_double)
+
+    lib.vecenv_create.restype = p
+    lib.vecenv_create.argtypes = [ctypes.c_char_p, u32, dbl, ctypes.c_double, u32, u32,
+                                  ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double, ctypes.c_double,
+                                  ctypes.c_uint64]
+    lib.vecenv_free.argtypes = [p]
+    lib.vecenv_reset.argtypes = [p, ctypes.POINTER(ctypes.c_uint8)]
+    lib.vecenv_step.argtypes = [p]
+    lib.vecenv_set_parameters.argtypes = [p, u32, dbl]
+
+    for name in ('count', 'motor_count', 'obs_size'):
+        fun = getattr(lib, 'vecenv_' + name)
+        fun.argtypes = [p]
+        fun.restype = u32
+
+    for name in ('actions', 'obs', 'reward'):
+        fun = getattr(lib, 'vecenv_' + name)
+        fun.argtypes = [p]
+        fun.restype = dbl
+
+    lib.vecenv_done.argtypes = [p]
+    lib.vecenv_done.restype = ctypes.POINTER(ctypes.c_uint8)
+
+    return lib
+
+
+def _params(params):
+
+    return (ctypes.c_double * 9)(*params)
+
+
+class VecEnv(object):
+    '''
+    Steps many vehicles at once, over buffers shared with the VecEnv library.
+    '''
+
+    def __init__(self, count, frame='quadxap', params=PHANTOM, dt=0.001, actionRepeat=10, maxSteps=1000,
+                 startAltitude=1, targetAltitude=1, initialTilt=0.1, maxTilt=1.0, tiltPenalty=0.1, seed=0,
+                 library=None):
+        '''
+        Creates a VecEnv object.
+        count - number of vehicles
+        frame - 'quadxap', 'octoxap' or 'thrustvector'
+        params - vehicle parameters b, d, m, l, Ix, Iy, Iz, Jr, maxrpm
+        dt - seconds per physics step
+        actionRepeat - physics steps per call to step()
+        maxSteps - calls to step() per episode
+        startAltitude, targetAltitude - meters
+        initialTilt - largest initial roll and pitch, radians
+        maxTilt - roll or pitch past which an episode ends, radians
+        tiltPenalty - reward per radian squared of tilt
+        seed - for initial attitudes
+        library - path to libvecenv.so; defaults to the one built in Extras/vecenv
+        '''
+
+        if library is None:
+            library = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'vecenv', 'libvecenv.so')
+
+        self.lib = _load(library)
+
+        self.env = self.lib.vecenv_create(frame.encode(), count, _params(params), dt, actionRepeat, maxSteps,
+                                          startAltitude, targetAltitude, initialTilt, maxTilt, tiltPenalty, seed)
+
+        if not self.env:
+            raise ValueError('Unknown frame: ' + frame)
+
+        self.count = count
+        self.motorCount = self.lib.vecenv_motor_count(self.env)
+
+        # Views onto the library's buffers: write actions, read the rest
+        self.actions = np.ctypeslib.as_array(self.lib.vecenv_actions(self.env), (count, self.motorCount))
+        self.obs = np.ctypeslib.as_array(self.lib.vecenv_obs(self.env), (count, OBS_SIZE))
+        self.reward = np.ctypeslib.as_array(self.lib.vecenv_reward(self.env), (count,))
+        self.done = np.ctypeslib.as_array(self.lib.vecenv_done(self.env), (count,)).view(np.bool_)
+
+    def reset(self, mask=None):
+        '''
+        Starts new episodes for vehicles where mask is true, or for all of them if mask is None.
+        Returns the observations.
+        '''
+
+        if mask is None:
+            self.lib.vecenv_reset(self.env, None)
+        else:
+            mask = np.ascontiguousarray(mask, dtype=np.uint8)
+            self.lib.vecenv_reset(self.env, mask.ctypes.data_as(ctypes.POINTER(ctypes.c_uint8)))
+
+        return self.obs
+
+    def step(self, actions=None):
+        '''
+        Applies actions (count x motorCount values in [0,1]) to every vehicle not done.  Pass None after writing
+        self.actions in place.  Returns the obs, reward and done arrays, which are updated in place by each step.
+        '''
+
+        if actions is not None:
+            self.actions[:] = actions
+
+        self.lib.vecenv_step(self.env)
+
+        return self.obs, self.reward, self.done
+
+    def setParameters(self, index, params):
+        '''
+        Changes one vehicle's parameters (b, d, m, l, Ix, Iy, Iz, Jr, maxrpm), e.g. to randomize them between episodes.
+        '''
+
+        self.lib.vecenv_set_parameters(self.env, index, _params(params))
+
+    def close(self):
+        '''
+        Frees the environment.  Arrays obtained from it must not be used afterward.
+        '''
+
+        # Nothing to free if __init__ failed before creating the environment
+        if getattr(self, 'env', None):
+            self.lib.vecenv_free(self.env)
+            self.env = None
+
+    def __del__(self):
+
+        self.close()
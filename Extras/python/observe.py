@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+'''
+Prints multicast telemetry as CSV (time, throttle, altitude, climb rate),
+e.g. for piping to plotalt.py
+
+Copyright (C) 2020 Simon D. Levy
+
+MIT License
+'''
+
+from multicopter_sim import Observer
+from sys import argv, stdout
+
+# Optional argument is the address of the interface to join the group on
+observer = Observer(interface=argv[1]) if len(argv) > 1 else Observer()
+
+try:
+
+    while True:
+
+        if not observer.receive():
+            continue
+
+        fields = observer.getFields()
+
+        if 'motors' not in fields or 'location' not in fields:
+            continue
+
+        u = fields['motors'].mean()
+        z = -fields['location'][2]         # NED => ENU
+        dzdt = -fields['inertialVel'][2]
+
+        stdout.write('%f,%f,%f,%f\n' % (observer.getTime(), u, z, dzdt))
+
+except KeyboardInterrupt:
+
+    pass
@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+'''
+Test of SequenceTracker's packet accounting, as in ../simproxy/seqtest.cpp
+
+Usage: seqtest.py
+
+Prints one line per case and exits nonzero if any fails.
+
+Copyright (C) 2020 Simon D. Levy
+
+MIT License
+'''
+
+from sys import exit
+from multicopter_sim import protocol
+
+# Name, sequence numbers in order of arrival, expected lost, late, duplicates
+CASES = (
+    ('in order', (1, 2, 3), 0, 0, 0),
+    ('gap', (1, 2, 5), 2, 0, 0),
+    ('gap filled late', (1, 3, 2), 0, 1, 0),
+    ('duplicate', (1, 2, 2), 0, 0, 1),
+    ('first two reordered', (10, 9), 0, 1, 0),
+    ('older than first, later', (10, 11, 8, 9), 0, 2, 0),
+    ('wraparound', (0xffffffff, 0, 1), 0, 0, 0),
+)
+
+if __name__ == '__main__':
+
+    failures = 0
+
+    for name, sequences, lost, late, duplicates in CASES:
+
+        tracker = protocol.SequenceTracker()
+
+        for sequence in sequences:
+            header = protocol.Header((protocol.MAGIC, protocol.VERSION, protocol.TYPE_TELEMETRY, 0, 0, 0, 0,
+                                      sequence, 0, 0))
+            tracker.update(header, 0)
+
+        ok = (tracker.lost, tracker.late, tracker.duplicates) == (lost, late, duplicates)
+
+        print('%-26s lost %d late %d duplicates %d %s' %
+              (name, tracker.lost, tracker.late, tracker.duplicates, 'ok' if ok else 'FAILED'))
+
+        failures += not ok
+
+    exit(1 if failures else 0)
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+'''
+Test simple altitude-hold PID controller, stepping in lockstep with the simulator
+
+Usage: steptakeoff.py [COUNT]
+
+With a COUNT above one, flies that many vehicles through a simulator serving a swarm
+(../simproxy/simproxy --swarm COUNT), one PID controller each, from one loop.
+
+Copyright (C) 2020 Simon D. Levy
+
+MIT License
+'''
+
+from sys import argv, stdout
+from time import perf_counter
+import numpy as np
+from pidcontroller import AltitudePidController
+from multicopter_sim import Stepper
+
+# Target
+ALTITUDE_TARGET = 10
+
+# PID params
+ALT_P = 1.0
+VEL_P = 1.0
+VEL_I = 0
+VEL_D = 0
+
+# Simulated seconds to fly
+DURATION = 20
+
+if __name__ == '__main__':
+
+    count = int(argv[1]) if len(argv) > 1 else 1
+
+    # One PID controller per vehicle
+    pids = [AltitudePidController(ALTITUDE_TARGET, ALT_P, VEL_P, VEL_I, VEL_D) for _ in range(count)]
+
+    stepper = Stepper(count)
+
+    print('Hit the start button ... ')
+    stdout.flush()
+
+    states = stepper.start().reshape(count, -1)
+
+    # Altitude is in NED coordinates, so we negate it to use as input to PID controller
+    zprev = -states[:, 9].copy()
+    tprev = states[:, 0].copy()
+
+    steps = 0
+    start = perf_counter()
+
+    # Loop until user hits the stop button, or time runs out
+    while not stepper.done.all() and tprev.min() < DURATION:
+
+        for k in range(count):
+
+            t = states[k, 0]
+            z = -states[k, 9]
+
+            # Hold last motor value until time moves on
+            if t > tprev[k]:
+
+                # Use temporal first difference to compute vertical velocity
+                dt = t - tprev[k]
+                dzdt = (z - zprev[k]) / dt
+
+                # Constrain correction to [0,1] to represent motor value, writing it straight into the outgoing packet
+                stepper.motors[k] = max(0, min(1, pids[k].u(z, dzdt, dt)))
+
+                zprev[k] = z
+                tprev[k] = t
+
+        states = stepper.step().reshape(count, -1)
+
+        steps += 1
+
+    elapsed = perf_counter() - start
+
+    print('%d steps in %3.3f sec (%d Hz); altitudes %s' %
+          (steps, elapsed, steps / elapsed, np.array2string(-states[:, 9], precision=2)))
+
+    stepper.close()
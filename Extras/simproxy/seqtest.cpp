@@ -0,0 +1,63 @@
+/*
+   Test of SequenceTracker's packet accounting
+
+   Usage: seqtest
+
+   Feeds the tracker sequence numbers in orders a network can deliver them,
+   checking its counts after each run.  Prints one line per case and exits
+   nonzero if any fails.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+#include <stdio.h>
+#include "../sockets/WireProtocol.hpp"
+
+typedef struct {
+
+    const char * name;
+    uint32_t sequences[8];
+    uint8_t count;
+    uint32_t lost;
+    uint32_t late;
+    uint32_t duplicates;
+
+} case_t;
+
+static const case_t CASES[] = {
+
+    {"in order",                 {1, 2, 3},        3, 0, 0, 0},
+    {"gap",                      {1, 2, 5},        3, 2, 0, 0},
+    {"gap filled late",          {1, 3, 2},        3, 0, 1, 0},
+    {"duplicate",                {1, 2, 2},        3, 0, 0, 1},
+    {"first two reordered",      {10, 9},          2, 0, 1, 0},
+    {"older than first, later",  {10, 11, 8, 9},   4, 0, 2, 0},
+    {"wraparound",               {0xffffffff, 0, 1}, 3, 0, 0, 0},
+};
+
+int main(int argc, char ** argv)
+{
+    int failures = 0;
+
+    for (const case_t & c : CASES) {
+
+        SequenceTracker tracker;
+
+        for (uint8_t k=0; k<c.count; ++k) {
+            WireProtocol::header_t header = {};
+            header.sequence = c.sequences[k];
+            tracker.update(header, 0);
+        }
+
+        bool ok = tracker.lost == c.lost && tracker.late == c.late && tracker.duplicates == c.duplicates;
+
+        printf("%-26s lost %u late %u duplicates %u %s\n", c.name, tracker.lost, tracker.late, tracker.duplicates,
+                ok ? "ok" : "FAILED");
+
+        failures += !ok;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -1,21 +1,65 @@
 /*
    UDP proxy for testing MulticopterSim socket comms
 
+   Usage: simproxy [--legacy] [--shm [--poll]] [--swarm COUNT] [--serve] [--multicast [--iface ADDRESS]] [--log FILE]
+
+   By default, sends versioned telemetry packets (see ../sockets/WireProtocol.hpp)
+   and accepts versioned or legacy motor packets.  With --legacy, sends the
+   original packet of ten doubles (time, gyro, accel, location).  With --shm,
+   talks to a controller on the same host through shared memory
+   (../sockets/TwoWayShm.hpp) instead of UDP, sleeping on a futex between
+   packets, or spinning with --poll.  With --swarm, simulates COUNT vehicles
+   behind one UDP port (../sockets/UdpMuxSocket.hpp), answering each vehicle
+   id at the address its commands come from; see swarmclient.cpp.  With
+   --serve, gives every controller that connects over TCP, or sends a UDP
+   datagram, to port 5000 a vehicle of its own, all served from one thread
+   (../sockets/SocketReactor.hpp).  TCP messages carry a uint32 length prefix.
+
+   A controller may send a SUBSCRIBE packet in place of a command to choose
+   which fields its telemetry carries and how many simulation steps each
+   command covers.  In the single-vehicle modes, passive observers such as
+   loggers can also subscribe on port 5002 (../sockets/TelemetryPublisher.hpp).
+
+   With --multicast, the single-vehicle modes also publish every step's state
+   and motor values to multicast group 239.255.77.1, port 5003, for any number
+   of observers (../sockets/UdpMulticastObserver.hpp, ../python/observe.py).
+   Commands still come over the unicast channel.  --iface picks the interface
+   to publish on, e.g. 127.0.0.1 on a host without a multicast route.
+
+   With --log, the single-vehicle modes write every step to a columnar
+   flight log (../../Source/MainModule/FlightLog.hpp); see ../flightlog.
+
    Copyright(C) 2019 Simon D.Levy
 
    MIT License
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "../sockets/TwoWayUdp.hpp"
+#include "../sockets/TwoWayShm.hpp"
+#include "../sockets/UdpMuxSocket.hpp"
+#include "../sockets/SocketReactor.hpp"
+#include "../sockets/TelemetryPublisher.hpp"
+#include "../sockets/UdpMulticastPublisher.hpp"
+#include "../sockets/WireProtocol.hpp"
 #include <dynamics/QuadXAP.hpp>
+#include <FlightLog.hpp>
 
 static const char * HOST           = "127.0.0.1";
 static const short  MOTOR_PORT     = 5000;
 static const short  TELEM_PORT     = 5001;
+static const short  SUBSCRIBE_PORT = 5002;
+static const char * MULTICAST_GROUP = "239.255.77.1";
+static const short  MULTICAST_PORT = 5003;
 static const double DELTA_T        = 0.001;
+static const uint16_t VEHICLE_ID   = 0;
+static const char * SHM_NAME       = "/multicopter_sim";
+static const uint32_t SWARM_TIMEOUT_MSEC = 100;
+static const uint32_t SERVE_IDLE_MSEC    = 1000;
 
-static MultirotorDynamics::Parameters params = MultirotorDynamics::Parameters(
+static Dynamics::Parameters params = Dynamics::Parameters(
 
         5.30216718361085E-05,   // b
         2.23656692806239E-06,   // d
@@ -28,51 +72,476 @@ static MultirotorDynamics::Parameters params = MultirotorDynamics::Parameters(
         15000                   // maxrpm
         );
 
+// What a controller has subscribed to over its own channel
+typedef struct {
 
-int main(int argc, char ** argv)
+    uint16_t fields;    // zero => all state fields
+    uint32_t divisor;   // simulation steps per command
+
+} subscription_t;
+
+static const subscription_t DEFAULT_SUBSCRIPTION = {0, 1};
+
+static void stateToTelemetry(Dynamics::state_t & state, double telemetry[WireProtocol::TELEM_COUNT])
 {
-    while (true) {
+    memcpy(&telemetry[WireProtocol::TELEM_ANGULAR_VEL],  state.angularVel,    3*sizeof(double));
+    memcpy(&telemetry[WireProtocol::TELEM_BODY_ACCEL],   state.bodyAccel,     3*sizeof(double));
+    memcpy(&telemetry[WireProtocol::TELEM_INERTIAL_VEL], state.inertialVel,   3*sizeof(double));
+    memcpy(&telemetry[WireProtocol::TELEM_QUATERNION],   state.quaternion,    4*sizeof(double));
+    memcpy(&telemetry[WireProtocol::TELEM_LOCATION],     state.pose.location, 3*sizeof(double));
+    memcpy(&telemetry[WireProtocol::TELEM_ROTATION],     state.pose.rotation, 3*sizeof(double));
+}
 
-        TwoWayUdp twoWayUdp = TwoWayUdp(HOST, TELEM_PORT, MOTOR_PORT);
+static uint32_t packTelemetry(uint8_t * buf, bool legacy, uint16_t vehicleId, uint32_t sequence, double time,
+        Dynamics::state_t & state, uint16_t fields=0, const double motorvals[4]=NULL)
+{
+    if (legacy) {
 
-        QuadXAPDynamics quad = QuadXAPDynamics(&params);
+        // Time Gyro, Accel, Location
+        double telemetry[10] = {0};
 
-        double time = 0;
+        telemetry[0] = time;
 
-        MultirotorDynamics::pose_t pose = {};
+        memcpy(&telemetry[1], &state.angularVel, 3*sizeof(double));
+        memcpy(&telemetry[4], &state.bodyAccel, 3*sizeof(double));
+        memcpy(&telemetry[7], &state.pose.location, 3*sizeof(double));
 
-        quad.init(pose);
+        memcpy(buf, telemetry, sizeof(telemetry));
 
-        while (true) {
+        return sizeof(telemetry);
+    }
 
-            MultirotorDynamics::state_t state = quad.getState();
+    double telemetry[WireProtocol::TELEM_COUNT] = {0};
 
-            // Time Gyro, Quat, Location
-            double telemetry[10] = {0};
+    stateToTelemetry(state, telemetry);
 
-            telemetry[0] = time;
+    if (fields == 0) {
+        return WireProtocol::encode(buf, WireProtocol::MAX_PACKET_SIZE, WireProtocol::TYPE_TELEMETRY, vehicleId,
+                sequence, time, telemetry, WireProtocol::TELEM_COUNT);
+    }
 
-            memcpy(&telemetry[1], &state.angularVel, 3*sizeof(double));
-            memcpy(&telemetry[4], &state.bodyAccel, 3*sizeof(double));
-            memcpy(&telemetry[7], &state.pose.location, 3*sizeof(double));
+    double values[WireProtocol::MAX_VALUES] = {0};
 
-            twoWayUdp.send(telemetry, sizeof(telemetry));
+    uint8_t count = WireProtocol::selectFields(fields, telemetry, motorvals, 4, values);
 
-            double motorvals[4] = {};
+    return WireProtocol::encode(buf, WireProtocol::MAX_PACKET_SIZE, WireProtocol::TYPE_TELEMETRY, vehicleId,
+            sequence, time, values, count, false, -1, fields);
+}
+
+// Returns true if packet is a SUBSCRIBE request, updating subscription accordingly
+static bool unpackSubscribe(const uint8_t * buf, int size, subscription_t & subscription)
+{
+    WireProtocol::header_t header = {};
+    double values[WireProtocol::MAX_VALUES] = {};
 
-            twoWayUdp.receive(motorvals, sizeof(motorvals));
+    if (size < 0 || !WireProtocol::decode(buf, size, header, values, WireProtocol::MAX_VALUES) ||
+            header.type != WireProtocol::TYPE_SUBSCRIBE || header.count < WireProtocol::SUBSCRIBE_COUNT) {
+        return false;
+    }
 
-            printf("t=%05f   m=%f %f %f %f  z=%+3.3f\n", 
-                    time, motorvals[0], motorvals[1], motorvals[2], motorvals[3], state.pose.location[2]);
+    double divisor = values[WireProtocol::SUBSCRIBE_DIVISOR];
 
-            quad.setMotors(motorvals);
+    subscription.fields = (uint16_t)values[WireProtocol::SUBSCRIBE_FIELDS];
+    subscription.divisor = divisor >= 1 ? (uint32_t)divisor : 1;
+
+    return true;
+}
+
+// Accepts either a versioned MOTORS packet or four raw doubles
+static bool unpackMotors(const uint8_t * buf, int size, double motorvals[4], SequenceTracker & tracker)
+{
+    // Failed receive
+    if (size < 0) {
+        return false;
+    }
+
+    if (WireProtocol::isPacket(buf, size)) {
+
+        WireProtocol::header_t header = {};
+        double values[WireProtocol::MAX_VALUES] = {};
+
+        if (!WireProtocol::decode(buf, size, header, values, WireProtocol::MAX_VALUES) ||
+                header.type != WireProtocol::TYPE_MOTORS || header.count < 4) {
+            return false;
+        }
+
+        SequenceTracker::status_t status = tracker.update(header, WireProtocol::now());
+
+        // A jump far backwards means the controller restarted its numbering
+        if (status == SequenceTracker::PACKET_STALE) {
+            tracker = SequenceTracker();
+            status = tracker.update(header, WireProtocol::now());
+        }
+
+        // Ignore late and duplicate commands
+        if (status != SequenceTracker::PACKET_OK) {
+            return false;
+        }
+
+        memcpy(motorvals, values, 4*sizeof(double));
+        return true;
+    }
+
+    if (size == (int)(4*sizeof(double))) {
+        memcpy(motorvals, buf, 4*sizeof(double));
+        return true;
+    }
+
+    return false;
+}
+
+// Sends every step's state and motors to the multicast group
+static void publishMulticast(UdpMulticastPublisher * multicast, uint32_t sequence, double time,
+        Dynamics::state_t & state, const double motorvals[4])
+{
+    uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+
+    multicast->sendData(buf, packTelemetry(buf, false, VEHICLE_ID, sequence, time, state,
+                WireProtocol::FIELD_STATE | WireProtocol::FIELD_MOTORS, motorvals));
+}
+
+// Runs one session; Transport is TwoWayUdp or TwoWayShm; multicast and log may be NULL
+template <class Transport>
+static void run(Transport & transport, bool legacy, UdpMulticastPublisher * multicast, FlightLogWriter * log)
+{
+    QuadXAPDynamics quad = QuadXAPDynamics(&params);
+
+    double time = 0;
+
+    double rotation[3] = {};
+
+    quad.init(rotation);
+
+    SequenceTracker tracker;
+
+    TelemetryPublisher publisher(SUBSCRIBE_PORT, VEHICLE_ID);
+
+    subscription_t subscription = DEFAULT_SUBSCRIPTION;
+
+    double motorvals[4] = {};
+
+    uint64_t step = 0;
+
+    for (uint32_t sequence=0; ; ++sequence) {
+
+        Dynamics::state_t state = quad.getState();
+
+        uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+
+        transport.send(buf, packTelemetry(buf, legacy, VEHICLE_ID, sequence, time, state,
+                    subscription.fields, motorvals));
+
+        int size = transport.receiveDatagram(buf, sizeof(buf));
+
+        // A new subscription gets an immediate reply in its new form, without a step
+        if (unpackSubscribe(buf, size, subscription)) continue;
+
+        unpackMotors(buf, size, motorvals, tracker);
+
+        printf("t=%05f   m=%f %f %f %f  z=%+3.3f  lost=%u late=%u  subscribers=%zu\n", 
+                time, motorvals[0], motorvals[1], motorvals[2], motorvals[3], state.pose.location[2],
+                tracker.lost, tracker.late, publisher.getSubscriberCount());
+
+        // Each command holds for as many steps as the controller's rate divisor
+        for (uint32_t k=0; k<subscription.divisor; ++k) {
+
+            quad.setMotors(motorvals, DELTA_T);
 
             quad.update(DELTA_T);
 
             time += DELTA_T;
+
+            step++;
+
+            // Observers get their own field sets and rates
+            publisher.poll(WireProtocol::now());
+
+            Dynamics::state_t stepState = quad.getState();
+
+            if (publisher.getSubscriberCount() > 0) {
+                double telemetry[WireProtocol::TELEM_COUNT] = {};
+                stateToTelemetry(stepState, telemetry);
+                publisher.publish(step, time, telemetry, motorvals, 4);
+            }
+
+            // Observers count losses from gaps in the step number
+            if (multicast) {
+                publishMulticast(multicast, (uint32_t)step, time, stepState, motorvals);
+            }
+
+            if (log) {
+                log->append(time, stepState, motorvals);
+            }
+        }
+    }
+}
+
+// Steps every vehicle in lockstep with its controller, moving each step's packets in one batch each way
+static void runSwarm(uint16_t count)
+{
+    UdpMuxSocket socket(MOTOR_PORT, SWARM_TIMEOUT_MSEC, count);
+
+    QuadXAPDynamics ** quads = new QuadXAPDynamics * [count];
+    SequenceTracker * trackers = new SequenceTracker [count];
+    double (*motorvals)[4] = new double [count][4]();
+    bool * expected = new bool [count];
+    bool * replied = new bool [count];
+
+    for (uint16_t v=0; v<count; ++v) {
+        double rotation[3] = {};
+        quads[v] = new QuadXAPDynamics(&params);
+        quads[v]->init(rotation);
+    }
+
+    double time = 0;
+
+    for (uint32_t sequence=0; ; ++sequence) {
+
+        // Telemetry goes only to vehicles whose controllers have checked in
+        uint16_t active = 0;
+
+        for (uint16_t v=0; v<count; ++v) {
+            expected[v] = socket.hasPeer(v);
+            if (expected[v]) {
+                Dynamics::state_t state = quads[v]->getState();
+                uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+                socket.queue(v, buf, packTelemetry(buf, false, v, sequence, time, state));
+                active++;
+            }
+        }
+
+        socket.flush();
+
+        // Collect a command from each of those vehicles, or whatever arrives before a timeout
+        memset(replied, 0, count*sizeof(bool));
+
+        uint16_t received = 0;
+
+        do {
+
+            uint16_t npackets = socket.receiveBatch();
+
+            if (npackets == 0) break;
+
+            for (uint16_t k=0; k<npackets; ++k) {
+
+                const UdpMuxSocket::packet_t & packet = socket.getPacket(k);
+
+                uint16_t v = packet.vehicleId;
+
+                // A new controller starts its own sequence numbering
+                if (packet.newPeer) {
+                    trackers[v] = SequenceTracker();
+                }
+
+                if (unpackMotors(packet.data, (int)packet.size, motorvals[v], trackers[v]) && expected[v] && !replied[v]) {
+                    replied[v] = true;
+                    received++;
+                }
+            }
+
+        } while (received < active);
+
+        // Controllers that missed a whole timeout are presumed gone
+        if (received < active) {
+            for (uint16_t v=0; v<count; ++v) {
+                if (expected[v] && !replied[v]) {
+                    socket.clearPeer(v);
+                }
+            }
         }
 
-    } while (true)
+        // Wait for controllers before starting the clock
+        if (active == 0) continue;
+
+        for (uint16_t v=0; v<count; ++v) {
+            quads[v]->setMotors(motorvals[v], DELTA_T);
+            quads[v]->update(DELTA_T);
+        }
+
+        if (sequence % 1000 == 0) {
+            uint32_t lost = 0;
+            for (uint16_t v=0; v<count; ++v) {
+                lost += trackers[v].lost;
+            }
+            printf("t=%05f   vehicles=%d  z0=%+3.3f  lost=%u\n", time, active, quads[0]->getState().pose.location[2], lost);
+        }
+
+        time += DELTA_T;
+    }
+}
+
+// Gives each controller its own vehicle, stepped whenever that controller sends a command
+class VehicleServer : public SocketReactor::Handler {
+
+    private:
+
+        typedef struct {
+
+            QuadXAPDynamics * quad;
+            SequenceTracker tracker;
+            double motorvals[4];
+            double time;
+            uint32_t sequence;
+            subscription_t subscription;
+
+        } vehicle_t;
+
+        std::map<SocketReactor::client_t, vehicle_t> _vehicles;
+
+        void sendTelemetry(SocketReactor & reactor, SocketReactor::client_t client, vehicle_t & vehicle)
+        {
+            Dynamics::state_t state = vehicle.quad->getState();
+            uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+            reactor.send(client, buf, packTelemetry(buf, false, 0, vehicle.sequence++, vehicle.time, state,
+                        vehicle.subscription.fields, vehicle.motorvals));
+        }
+
+    public:
+
+        virtual void onConnect(SocketReactor & reactor, SocketReactor::client_t client,
+                SocketReactor::transport_t transport) override
+        {
+            vehicle_t & vehicle = _vehicles[client];
+            vehicle.quad = new QuadXAPDynamics(&params);
+            memset(vehicle.motorvals, 0, sizeof(vehicle.motorvals));
+            vehicle.time = 0;
+            vehicle.sequence = 0;
+            vehicle.subscription = DEFAULT_SUBSCRIPTION;
+
+            double rotation[3] = {};
+            vehicle.quad->init(rotation);
+
+            printf("client %u connected over %s; %zu vehicles\n", client,
+                    transport == SocketReactor::TRANSPORT_TCP ? "TCP" : "UDP", _vehicles.size());
+
+            // UDP controllers speak first; TCP controllers are sent initial state
+            if (transport == SocketReactor::TRANSPORT_TCP) {
+                sendTelemetry(reactor, client, vehicle);
+            }
+        }
+
+        virtual void onMessage(SocketReactor & reactor, SocketReactor::client_t client,
+                const uint8_t * data, uint32_t size) override
+        {
+            vehicle_t & vehicle = _vehicles[client];
+
+            if (unpackSubscribe(data, (int)size, vehicle.subscription)) {
+                sendTelemetry(reactor, client, vehicle);
+                return;
+            }
+
+            if (!unpackMotors(data, (int)size, vehicle.motorvals, vehicle.tracker)) return;
+
+            for (uint32_t k=0; k<vehicle.subscription.divisor; ++k) {
+                vehicle.quad->setMotors(vehicle.motorvals, DELTA_T);
+                vehicle.quad->update(DELTA_T);
+                vehicle.time += DELTA_T;
+            }
+
+            sendTelemetry(reactor, client, vehicle);
+        }
+
+        virtual void onDisconnect(SocketReactor & reactor, SocketReactor::client_t client) override
+        {
+            (void)reactor;
+
+            delete _vehicles[client].quad;
+            _vehicles.erase(client);
+
+            printf("client %u disconnected; %zu vehicles\n", client, _vehicles.size());
+        }
+};
+
+static void runServer(void)
+{
+    VehicleServer server;
+
+    SocketReactor reactor(&server);
+
+    if (!reactor.listenTcp(MOTOR_PORT) || !reactor.bindUdp(MOTOR_PORT)) {
+        fprintf(stderr, "%s\n", reactor.getMessage());
+        return;
+    }
+
+    while (reactor.poll(SERVE_IDLE_MSEC) >= 0) {
+        reactor.expireIdle(SERVE_IDLE_MSEC);
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    bool legacy = false;
+    bool shm = false;
+    bool poll = false;
+    int swarm = 0;
+    bool serve = false;
+    bool multicast = false;
+    const char * iface = NULL;
+    const char * logPath = NULL;
+
+    for (int k=1; k<argc; ++k) {
+        legacy |= !strcmp(argv[k], "--legacy");
+        shm    |= !strcmp(argv[k], "--shm");
+        poll   |= !strcmp(argv[k], "--poll");
+        serve  |= !strcmp(argv[k], "--serve");
+        multicast |= !strcmp(argv[k], "--multicast");
+        if (!strcmp(argv[k], "--log") && k+1 < argc) {
+            logPath = argv[++k];
+        }
+        if (!strcmp(argv[k], "--iface") && k+1 < argc) {
+            iface = argv[++k];
+        }
+        if (!strcmp(argv[k], "--swarm") && k+1 < argc) {
+            swarm = atoi(argv[++k]);
+        }
+    }
+
+    if (swarm > 0) {
+        runSwarm(swarm);
+    }
+
+    if (serve) {
+        runServer();
+        return 1;
+    }
+
+    UdpMulticastPublisher * publisher = multicast ?
+        new UdpMulticastPublisher(MULTICAST_GROUP, MULTICAST_PORT, iface) : NULL;
+
+    // Sessions follow one another in the same log; the log is readable even if never closed
+    FlightLogWriter * log = NULL;
+
+    if (logPath) {
+        log = new FlightLogWriter(logPath, 4);
+        if (!log->isOpen()) {
+            fprintf(stderr, "%s\n", log->getMessage());
+            return 1;
+        }
+    }
+
+    while (true) {
+
+        if (shm) {
+
+            TwoWayShm twoWayShm(SHM_NAME, TwoWayShm::ENDPOINT_SIMULATOR,
+                poll ? TwoWayShm::MODE_BUSY_POLL : TwoWayShm::MODE_FUTEX);
+
+            if (!twoWayShm.isOpen()) {
+                fprintf(stderr, "%s\n", twoWayShm.getMessage());
+                return 1;
+            }
+
+            run(twoWayShm, legacy, publisher, log);
+        }
+
+        else {
+
+            TwoWayUdp twoWayUdp = TwoWayUdp(HOST, TELEM_PORT, MOTOR_PORT);
+
+            run(twoWayUdp, legacy, publisher, log);
+        }
+    }
 
     return 0;
 }
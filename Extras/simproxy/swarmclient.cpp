@@ -0,0 +1,118 @@
+/*
+   Swarm controller for testing simproxy --swarm
+
+   Usage: swarmclient COUNT [STEPS]
+
+   Flies COUNT vehicles through one UDP port, receiving every vehicle's
+   telemetry for a step in one batch and sending every vehicle's motor
+   command in another.  Prints the step rate and packet loss at the end.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "../sockets/UdpMuxSocket.hpp"
+
+static const char * HOST           = "127.0.0.1";
+static const short  MOTOR_PORT     = 5000;
+static const short  TELEM_PORT     = 5001;
+static const uint32_t TIMEOUT_MSEC = 1000;
+static const double MOTOR_VALUE    = 0.6;
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s COUNT [STEPS]\n", argv[0]);
+        return 1;
+    }
+
+    uint16_t count = atoi(argv[1]);
+    uint32_t steps = argc > 2 ? atoi(argv[2]) : 10000;
+
+    UdpMuxSocket socket(TELEM_PORT, TIMEOUT_MSEC, count);
+
+    SequenceTracker * trackers = new SequenceTracker [count];
+    bool * reported = new bool [count];
+
+    double motorvals[4] = {MOTOR_VALUE, MOTOR_VALUE, MOTOR_VALUE, MOTOR_VALUE};
+
+    uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+
+    // Every vehicle checks in with an initial command, so simulator learns our address
+    for (uint16_t v=0; v<count; ++v) {
+        socket.setPeer(v, HOST, MOTOR_PORT);
+        socket.queue(v, buf, WireProtocol::encode(buf, sizeof(buf), WireProtocol::TYPE_MOTORS, v, 0, 0, motorvals, 4));
+    }
+    socket.flush();
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t step = 0;
+
+    for (; step<steps; ++step) {
+
+        memset(reported, 0, count*sizeof(bool));
+
+        uint16_t received = 0;
+        double simTime = 0;
+
+        while (received < count) {
+
+            uint16_t npackets = socket.receiveBatch();
+
+            if (npackets == 0) break;
+
+            for (uint16_t k=0; k<npackets; ++k) {
+
+                const UdpMuxSocket::packet_t & packet = socket.getPacket(k);
+
+                WireProtocol::header_t header = {};
+                double telemetry[WireProtocol::MAX_VALUES] = {};
+
+                if (!WireProtocol::decode(packet.data, packet.size, header, telemetry, WireProtocol::MAX_VALUES) ||
+                        trackers[packet.vehicleId].update(header, WireProtocol::now()) != SequenceTracker::PACKET_OK) {
+                    continue;
+                }
+
+                simTime = header.simTime;
+
+                if (!reported[packet.vehicleId]) {
+                    reported[packet.vehicleId] = true;
+                    received++;
+                }
+            }
+        }
+
+        if (received < count) {
+            fprintf(stderr, "Timed out waiting for telemetry\n");
+            break;
+        }
+
+        for (uint16_t v=0; v<count; ++v) {
+            socket.queue(v, buf, WireProtocol::encode(buf, sizeof(buf), WireProtocol::TYPE_MOTORS, v,
+                        step+1, simTime, motorvals, 4));
+        }
+
+        socket.flush();
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t lost = 0;
+    for (uint16_t v=0; v<count; ++v) {
+        lost += trackers[v].lost;
+    }
+
+    printf("%d vehicles: %u steps in %3.3f sec (%3.0f steps/sec), %u telemetry packets lost\n",
+            count, step, elapsed, step/elapsed, lost);
+
+    delete[] trackers;
+    delete[] reported;
+
+    return 0;
+}
@@ -29,6 +29,7 @@ typedef int SOCKET;
 #include <arpa/inet.h>
 static const int INVALID_SOCKET = -1;
 static const int SOCKET_ERROR   = -1;
+static inline void closesocket(int socket) { close(socket); }
 #endif
 
 #include <stdio.h>
@@ -87,6 +88,17 @@ class Socket {
 
     public:
 
+        // Larger kernel buffers help with bursts of datagrams, such as chunked images
+        void setBufferSizes(int sendBytes, int receiveBytes)
+        {
+            if (sendBytes > 0) {
+                setsockopt(_sock, SOL_SOCKET, SO_SNDBUF, (const char *)&sendBytes, sizeof(sendBytes));
+            }
+            if (receiveBytes > 0) {
+                setsockopt(_sock, SOL_SOCKET, SO_RCVBUF, (const char *)&receiveBytes, sizeof(receiveBytes));
+            }
+        }
+
         void closeConnection(void)
         {
 #ifdef _WIN32
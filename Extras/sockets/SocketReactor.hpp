@@ -0,0 +1,630 @@
+/*
+ * Event-driven server for many controller connections on one thread
+ *
+ * One epoll loop serves any number of TCP connections and UDP peers with
+ * non-blocking sockets.  Every socket is handled the same way:
+ *
+ *   - TCP messages are framed by a little-endian uint32 length prefix;
+ *     bytes are buffered per connection until a whole frame has arrived,
+ *     however the stream happens to be split.
+ *   - Each UDP datagram is one message.  Peers are told apart by address
+ *     and get a client id on their first datagram; since UDP has no hangup,
+ *     expireIdle() forgets peers that have gone quiet.
+ *   - Outgoing TCP data that the kernel can't take yet is queued and sent
+ *     when the socket becomes writable.  A client whose queue would exceed
+ *     a limit is slow: its new messages are dropped, or it is disconnected,
+ *     according to the back-pressure policy, so it can't stall the others.
+ *
+ * TCP connections get TCP_NODELAY, since messages are small and latency
+ * matters more than throughput.
+ *
+ * Linux only.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "SocketCompat.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <time.h>
+
+#include <map>
+#include <vector>
+
+class SocketReactor {
+
+    public:
+
+        typedef uint32_t client_t;
+
+        typedef enum {
+
+            TRANSPORT_TCP,
+            TRANSPORT_UDP
+
+        } transport_t;
+
+        typedef enum {
+
+            BACKPRESSURE_DROP,          // drop messages to a slow client
+            BACKPRESSURE_DISCONNECT     // disconnect a slow client
+
+        } backpressure_t;
+
+        // Receives events; all calls happen on the thread calling poll()
+        class Handler {
+
+            public:
+
+                virtual void onConnect(SocketReactor & reactor, client_t client, transport_t transport)
+                {
+                    (void)reactor;
+                    (void)client;
+                    (void)transport;
+                }
+
+                virtual void onMessage(SocketReactor & reactor, client_t client, const uint8_t * data, uint32_t size) = 0;
+
+                virtual void onDisconnect(SocketReactor & reactor, client_t client)
+                {
+                    (void)reactor;
+                    (void)client;
+                }
+
+                virtual ~Handler(void) { }
+        };
+
+        static const uint32_t MAX_MESSAGE = 65536;
+
+    private:
+
+        static const int MAX_EVENTS = 64;
+
+        typedef struct {
+
+            transport_t transport;
+
+            int fd;
+
+            // UDP: peer address
+            struct sockaddr_in address;
+
+            // TCP: partial incoming frame
+            std::vector<uint8_t> input;
+
+            // TCP: bytes not yet taken by the kernel, starting at outputStart
+            std::vector<uint8_t> output;
+            size_t outputStart;
+
+            // TCP: whether epoll is currently asked for writability
+            bool watchingOutput;
+
+            uint32_t messagesDropped;
+
+            double lastReceived;
+
+        } connection_t;
+
+        // What an epoll event refers to
+        typedef enum {
+
+            SOURCE_TCP_LISTENER,
+            SOURCE_UDP,
+            SOURCE_TCP
+
+        } source_t;
+
+        char _message[200] = {};
+
+        Handler * _handler = NULL;
+
+        backpressure_t _backpressure = BACKPRESSURE_DROP;
+        size_t _maxQueuedBytes = 0;
+
+        int _epoll = -1;
+
+        std::vector<int> _listeners;
+        std::vector<int> _udpSockets;
+
+        std::map<client_t, connection_t> _connections;
+
+        // UDP peers, keyed by socket, address and port
+        std::map<std::pair<int, uint64_t>, client_t> _udpClients;
+
+        client_t _nextClient = 1;
+
+        uint8_t _datagram[MAX_MESSAGE] = {};
+
+        static uint64_t addressKey(const struct sockaddr_in & address)
+        {
+            return ((uint64_t)address.sin_addr.s_addr << 16) | address.sin_port;
+        }
+
+        static double monotonic(void)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec + ts.tv_nsec / 1e9;
+        }
+
+        static bool setNonBlocking(int fd)
+        {
+            int flags = fcntl(fd, F_GETFL, 0);
+            return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+        }
+
+        // epoll data holds the source type in the top bits and the fd or client id below
+        bool watch(int fd, source_t source, uint32_t id, uint32_t events)
+        {
+            struct epoll_event event = {};
+            event.events = events;
+            event.data.u64 = ((uint64_t)source << 32) | id;
+            return epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+        }
+
+        void rewatch(int fd, source_t source, uint32_t id, uint32_t events)
+        {
+            struct epoll_event event = {};
+            event.events = events;
+            event.data.u64 = ((uint64_t)source << 32) | id;
+            epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &event);
+        }
+
+        int bindSocket(short port, int type)
+        {
+            int fd = socket(AF_INET, type, 0);
+            if (fd < 0) {
+                snprintf(_message, sizeof(_message), "socket() failed");
+                return -1;
+            }
+
+            int on = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+            struct sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = INADDR_ANY;
+            local.sin_port = htons(port);
+
+            if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0 || !setNonBlocking(fd)) {
+                snprintf(_message, sizeof(_message), "bind() failed on port %d", port);
+                close(fd);
+                return -1;
+            }
+
+            return fd;
+        }
+
+        void acceptConnections(int listener)
+        {
+            while (true) {
+
+                int fd = accept(listener, NULL, NULL);
+
+                if (fd < 0) return; // EAGAIN: no more pending connections
+
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+                client_t client = _nextClient++;
+
+                if (!setNonBlocking(fd) || !watch(fd, SOURCE_TCP, client, EPOLLIN | EPOLLRDHUP)) {
+                    close(fd);
+                    continue;
+                }
+
+                connection_t & connection = _connections[client];
+                connection.transport = TRANSPORT_TCP;
+                connection.fd = fd;
+                connection.outputStart = 0;
+                connection.watchingOutput = false;
+                connection.messagesDropped = 0;
+                connection.lastReceived = monotonic();
+
+                _handler->onConnect(*this, client, TRANSPORT_TCP);
+            }
+        }
+
+        void receiveDatagrams(int fd)
+        {
+            while (true) {
+
+                struct sockaddr_in address = {};
+                socklen_t addrlen = sizeof(address);
+
+                ssize_t size = recvfrom(fd, _datagram, sizeof(_datagram), 0, (struct sockaddr *)&address, &addrlen);
+
+                if (size < 0) return; // EAGAIN: socket drained
+
+                std::pair<int, uint64_t> key(fd, addressKey(address));
+
+                client_t client = 0;
+
+                std::map<std::pair<int, uint64_t>, client_t>::iterator found = _udpClients.find(key);
+
+                if (found == _udpClients.end()) {
+
+                    client = _nextClient++;
+                    _udpClients[key] = client;
+
+                    connection_t & connection = _connections[client];
+                    connection.transport = TRANSPORT_UDP;
+                    connection.fd = fd;
+                    connection.address = address;
+                    connection.outputStart = 0;
+                    connection.watchingOutput = false;
+                    connection.messagesDropped = 0;
+                    connection.lastReceived = monotonic();
+
+                    _handler->onConnect(*this, client, TRANSPORT_UDP);
+
+                    // The handler may have turned the peer away
+                    if (_connections.find(client) == _connections.end()) continue;
+                }
+                else {
+                    client = found->second;
+                    _connections[client].lastReceived = monotonic();
+                }
+
+                _handler->onMessage(*this, client, _datagram, (uint32_t)size);
+            }
+        }
+
+        // Reads everything available, delivering each complete frame
+        void receiveStream(client_t client)
+        {
+            uint8_t chunk[16384];
+
+            while (true) {
+
+                std::map<client_t, connection_t>::iterator found = _connections.find(client);
+                if (found == _connections.end()) return; // handler closed it
+
+                connection_t & connection = found->second;
+
+                ssize_t n = recv(connection.fd, chunk, sizeof(chunk), 0);
+
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    disconnect(client);
+                    return;
+                }
+
+                if (n < 0) return;
+
+                connection.lastReceived = monotonic();
+
+                connection.input.insert(connection.input.end(), chunk, chunk+n);
+
+                if (!deliverFrames(client)) return;
+            }
+        }
+
+        // Returns false if the connection went away
+        bool deliverFrames(client_t client)
+        {
+            size_t start = 0;
+
+            while (true) {
+
+                std::map<client_t, connection_t>::iterator found = _connections.find(client);
+                if (found == _connections.end()) return false;
+
+                std::vector<uint8_t> & input = found->second.input;
+
+                if (input.size() - start < sizeof(uint32_t)) break;
+
+                uint32_t size = 0;
+                memcpy(&size, &input[start], sizeof(size));
+
+                if (size > MAX_MESSAGE) {
+                    disconnect(client); // not speaking our framing
+                    return false;
+                }
+
+                if (input.size() - start < sizeof(uint32_t) + size) break;
+
+                // Copy out, since the handler may send or close and so touch the buffer
+                std::vector<uint8_t> message(input.begin() + start + sizeof(uint32_t),
+                        input.begin() + start + sizeof(uint32_t) + size);
+
+                start += sizeof(uint32_t) + size;
+
+                _handler->onMessage(*this, client, message.data(), size);
+            }
+
+            std::map<client_t, connection_t>::iterator found = _connections.find(client);
+            if (found == _connections.end()) return false;
+
+            std::vector<uint8_t> & input = found->second.input;
+            input.erase(input.begin(), input.begin() + start);
+
+            return true;
+        }
+
+        // Writes as much queued output as the kernel will take
+        void flushOutput(client_t client, connection_t & connection)
+        {
+            while (connection.outputStart < connection.output.size()) {
+
+                ssize_t n = ::send(connection.fd, &connection.output[connection.outputStart],
+                        connection.output.size() - connection.outputStart, MSG_NOSIGNAL);
+
+                if (n < 0) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                    if (errno == EINTR) continue;
+                    disconnect(client);
+                    return;
+                }
+
+                connection.outputStart += n;
+            }
+
+            bool pending = connection.outputStart < connection.output.size();
+
+            if (!pending) {
+                connection.output.clear();
+                connection.outputStart = 0;
+            }
+
+            // Drop what the kernel has taken once it's most of the buffer, so a client that
+            // never quite catches up doesn't grow the buffer without bound
+            else if (connection.outputStart > connection.output.size() / 2) {
+                connection.output.erase(connection.output.begin(), connection.output.begin() + connection.outputStart);
+                connection.outputStart = 0;
+            }
+
+            // Ask for writability only while something is waiting, changing the watch only when that changes
+            if (pending != connection.watchingOutput) {
+                rewatch(connection.fd, SOURCE_TCP, client, EPOLLIN | EPOLLRDHUP | (pending ? EPOLLOUT : 0));
+                connection.watchingOutput = pending;
+            }
+        }
+
+    public:
+
+        /**
+         * @param handler receives connection and message events
+         * @param backpressure what to do with a client that isn't keeping up
+         * @param maxQueuedBytes outgoing bytes that may wait for a TCP client before it counts as slow
+         */
+        SocketReactor(Handler * handler, backpressure_t backpressure=BACKPRESSURE_DROP, size_t maxQueuedBytes=1<<20)
+        {
+            _handler = handler;
+            _backpressure = backpressure;
+            _maxQueuedBytes = maxQueuedBytes;
+
+            _epoll = epoll_create1(0);
+
+            if (_epoll < 0) {
+                snprintf(_message, sizeof(_message), "epoll_create1() failed");
+            }
+        }
+
+        SocketReactor(const SocketReactor &) = delete;
+        SocketReactor & operator=(const SocketReactor &) = delete;
+
+        // Closes everything without calling the handler, which may already be gone
+        ~SocketReactor(void)
+        {
+            for (auto & entry : _connections) {
+                if (entry.second.transport == TRANSPORT_TCP) {
+                    close(entry.second.fd);
+                }
+            }
+
+            for (int fd : _listeners) close(fd);
+            for (int fd : _udpSockets) close(fd);
+
+            if (_epoll >= 0) close(_epoll);
+        }
+
+        // Accepts TCP connections on a port
+        bool listenTcp(short port)
+        {
+            int fd = bindSocket(port, SOCK_STREAM);
+
+            if (fd < 0) return false;
+
+            if (listen(fd, SOMAXCONN) < 0 || !watch(fd, SOURCE_TCP_LISTENER, fd, EPOLLIN)) {
+                snprintf(_message, sizeof(_message), "listen() failed on port %d", port);
+                close(fd);
+                return false;
+            }
+
+            _listeners.push_back(fd);
+
+            return true;
+        }
+
+        // Receives UDP datagrams on a port
+        bool bindUdp(short port)
+        {
+            int fd = bindSocket(port, SOCK_DGRAM);
+
+            if (fd < 0) return false;
+
+            if (!watch(fd, SOURCE_UDP, fd, EPOLLIN)) {
+                close(fd);
+                return false;
+            }
+
+            _udpSockets.push_back(fd);
+
+            return true;
+        }
+
+        /**
+         * Waits for socket events and dispatches them to the handler.
+         *
+         * @param timeoutMsec how long to wait; negative waits forever, zero doesn't wait
+         * @return number of events handled, or -1 on error
+         */
+        int poll(int timeoutMsec)
+        {
+            struct epoll_event events[MAX_EVENTS];
+
+            int count = epoll_wait(_epoll, events, MAX_EVENTS, timeoutMsec);
+
+            if (count < 0) return errno == EINTR ? 0 : -1;
+
+            for (int k=0; k<count; ++k) {
+
+                source_t source = (source_t)(events[k].data.u64 >> 32);
+                uint32_t id = (uint32_t)events[k].data.u64;
+
+                switch (source) {
+
+                    case SOURCE_TCP_LISTENER:
+                        acceptConnections((int)id);
+                        break;
+
+                    case SOURCE_UDP:
+                        receiveDatagrams((int)id);
+                        break;
+
+                    case SOURCE_TCP: {
+
+                        if (events[k].events & EPOLLOUT) {
+                            std::map<client_t, connection_t>::iterator found = _connections.find(id);
+                            if (found != _connections.end()) {
+                                flushOutput(id, found->second);
+                            }
+                        }
+
+                        // Read before honoring a hangup, so final messages aren't lost
+                        if (events[k].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                            receiveStream(id);
+                        }
+
+                        break;
+                    }
+                }
+            }
+
+            return count;
+        }
+
+        /**
+         * Sends a message to a client without blocking.
+         *
+         * @return false if the message was dropped, or the client disconnected, for not keeping up
+         */
+        bool send(client_t client, const void * data, uint32_t size)
+        {
+            std::map<client_t, connection_t>::iterator found = _connections.find(client);
+
+            if (found == _connections.end() || size > MAX_MESSAGE) return false;
+
+            connection_t & connection = found->second;
+
+            if (connection.transport == TRANSPORT_UDP) {
+
+                // A full socket buffer drops the datagram, as UDP would anyway
+                if (sendto(connection.fd, data, size, 0, (struct sockaddr *)&connection.address,
+                            sizeof(connection.address)) < 0) {
+                    connection.messagesDropped++;
+                    return false;
+                }
+
+                return true;
+            }
+
+            size_t queued = connection.output.size() - connection.outputStart;
+
+            if (queued + sizeof(uint32_t) + size > _maxQueuedBytes) {
+
+                connection.messagesDropped++;
+
+                if (_backpressure == BACKPRESSURE_DISCONNECT) {
+                    disconnect(client);
+                }
+
+                return false;
+            }
+
+            const uint8_t * bytes = (const uint8_t *)data;
+            uint8_t prefix[sizeof(uint32_t)];
+            memcpy(prefix, &size, sizeof(size));
+
+            connection.output.insert(connection.output.end(), prefix, prefix+sizeof(prefix));
+            connection.output.insert(connection.output.end(), bytes, bytes+size);
+
+            // Nothing was waiting, so try to send right away
+            if (queued == 0) {
+                flushOutput(client, connection);
+            }
+
+            return true;
+        }
+
+        // Closes a TCP connection, or forgets a UDP peer
+        void disconnect(client_t client)
+        {
+            std::map<client_t, connection_t>::iterator found = _connections.find(client);
+
+            if (found == _connections.end()) return;
+
+            connection_t & connection = found->second;
+
+            if (connection.transport == TRANSPORT_TCP) {
+                epoll_ctl(_epoll, EPOLL_CTL_DEL, connection.fd, NULL);
+                close(connection.fd);
+            }
+            else {
+                _udpClients.erase(std::pair<int, uint64_t>(connection.fd, addressKey(connection.address)));
+            }
+
+            _connections.erase(found);
+
+            _handler->onDisconnect(*this, client);
+        }
+
+        // Disconnects clients, such as UDP peers that simply stopped, not heard from for a while
+        void expireIdle(uint32_t msec)
+        {
+            double cutoff = monotonic() - msec / 1e3;
+
+            std::vector<client_t> idle;
+
+            for (auto & entry : _connections) {
+                if (entry.second.lastReceived < cutoff) {
+                    idle.push_back(entry.first);
+                }
+            }
+
+            for (client_t client : idle) {
+                disconnect(client);
+            }
+        }
+
+        // Messages dropped for a client by back-pressure
+        uint32_t getMessagesDropped(client_t client)
+        {
+            std::map<client_t, connection_t>::iterator found = _connections.find(client);
+            return found == _connections.end() ? 0 : found->second.messagesDropped;
+        }
+
+        size_t getClientCount(void)
+        {
+            return _connections.size();
+        }
+
+        bool isOpen(void)
+        {
+            return _epoll >= 0;
+        }
+
+        const char * getMessage(void)
+        {
+            return _message;
+        }
+};
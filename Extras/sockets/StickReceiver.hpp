@@ -0,0 +1,124 @@
+/*
+ * Class for receiving stick values over UDP
+ *
+ * Another program (a test harness, say, or a pilot on another machine) sends
+ * WireProtocol STICKS packets holding throttle, roll, pitch, yaw, aux1 and
+ * aux2.  The socket never blocks: each call to poll() handles whatever has
+ * arrived since the last one and keeps the newest values.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "SocketCompat.hpp"
+#include "WireProtocol.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+class StickReceiver : public Socket {
+
+    public:
+
+        static const uint8_t STICK_COUNT = 6;
+
+    private:
+
+        double _sticks[STICK_COUNT] = {};
+
+        bool _received = false;
+
+        bool _open = false;
+
+    public:
+
+        /**
+         * @param port port on which to receive STICKS packets
+         */
+        StickReceiver(const short port)
+        {
+            _message[0] = 0;
+
+            // Initialize Winsock, returning on failure
+            if (!initWinsock()) return;
+
+            // Create socket
+            _sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (_sock == INVALID_SOCKET) {
+                sprintf_s(_message, "socket() failed");
+                return;
+            }
+
+            // Bind
+            struct sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = INADDR_ANY;
+            local.sin_port = htons(port);
+
+            if (bind(_sock, (struct sockaddr *)&local, sizeof(local)) == SOCKET_ERROR) {
+                sprintf_s(_message, "bind() failed");
+                closeConnection();
+                return;
+            }
+
+            // Packets are picked up between simulation steps, so the socket must never block
+#ifdef _WIN32
+            u_long nonblocking = 1;
+            ioctlsocket(_sock, FIONBIO, &nonblocking);
+#else
+            fcntl(_sock, F_SETFL, fcntl(_sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+            _open = true;
+        }
+
+        ~StickReceiver(void)
+        {
+            if (_open) {
+                closeConnection();
+            }
+        }
+
+        /**
+         * Handles any pending packets.
+         *
+         * @param sticks newest stick values (output)
+         * @return false until the first STICKS packet arrives
+         */
+        bool poll(double sticks[STICK_COUNT])
+        {
+            while (_open) {
+
+                uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+
+                int size = (int)recv(_sock, (char *)buf, sizeof(buf), 0);
+
+                if (size < 0) break;
+
+                WireProtocol::header_t header = {};
+                double values[WireProtocol::MAX_VALUES] = {};
+
+                if (!WireProtocol::decode(buf, (uint32_t)size, header, values, WireProtocol::MAX_VALUES) ||
+                        header.type != WireProtocol::TYPE_STICKS || header.count < STICK_COUNT) {
+                    continue;
+                }
+
+                memcpy(_sticks, values, sizeof(_sticks));
+
+                _received = true;
+            }
+
+            memcpy(sticks, _sticks, sizeof(_sticks));
+
+            return _received;
+        }
+
+        bool isOpen(void)
+        {
+            return _open;
+        }
+};
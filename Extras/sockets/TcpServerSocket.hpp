@@ -10,10 +10,6 @@
 
 #include "TcpSocket.hpp"
 
-#ifndef _WIN32
-static void closesocket(int socket) { close(socket); }
-#endif
-
 class TcpServerSocket : public TcpSocket {
 
     public:
@@ -46,6 +42,7 @@ class TcpServerSocket : public TcpSocket {
                 sprintf_s(_message, "accept() failed");
                 return;
             }
+            _connected = true;
             printf("connected\n");
             fflush(stdout);
         }
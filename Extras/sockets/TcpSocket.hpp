@@ -61,15 +61,26 @@ class TcpSocket : public Socket {
 
     public:
 
+        // Large messages may be split across several send() and recv() calls, so we loop until done
+
         bool sendData(void *buf, size_t len)
         {
-            return (size_t)send(_conn, (const char *)buf, len, 0) == len;
+            for (size_t sent=0; sent<len; ) {
+                int n = (int)send(_conn, (const char *)buf+sent, (int)(len-sent), 0);
+                if (n <= 0) return false;
+                sent += n;
+            }
+            return true;
         }
 
-
         bool receiveData(void *buf, size_t len)
         {
-            return (size_t)recv(_conn, (char *)buf, len, 0) == len;
+            for (size_t received=0; received<len; ) {
+                int n = (int)recv(_conn, (char *)buf+received, (int)(len-received), 0);
+                if (n <= 0) return false;
+                received += n;
+            }
+            return true;
         }
         bool isConnected()
         {
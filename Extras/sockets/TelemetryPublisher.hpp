@@ -0,0 +1,196 @@
+/*
+ * Class for sending each telemetry subscriber only the fields it asked for
+ *
+ * Clients such as loggers and dashboards send a WireProtocol SUBSCRIBE
+ * packet to the publisher's port, naming the state fields they want and a
+ * rate divisor.  Each call to publish() sends every subscriber whose step
+ * has come up a TELEMETRY packet holding just its fields, with its own
+ * sequence numbers so it can count losses.
+ *
+ * A subscription lapses unless renewed within the lease time, so clients
+ * that exit without unsubscribing don't cost anything for long; clients
+ * should resend their SUBSCRIBE packet every second or so.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "SocketCompat.hpp"
+#include "WireProtocol.hpp"
+
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#endif
+
+class TelemetryPublisher : public Socket {
+
+    private:
+
+        typedef struct {
+
+            struct sockaddr_in address;
+            uint16_t fields;
+            uint32_t divisor;
+            uint32_t sequence;
+            double expires;
+
+        } subscriber_t;
+
+        std::vector<subscriber_t> _subscribers;
+
+        double _leaseSeconds = 0;
+
+        uint16_t _vehicleId = 0;
+
+        void subscribe(const struct sockaddr_in & address, uint16_t fields, uint32_t divisor, double now)
+        {
+            for (size_t k=0; k<_subscribers.size(); ++k) {
+
+                subscriber_t & subscriber = _subscribers[k];
+
+                if (subscriber.address.sin_addr.s_addr == address.sin_addr.s_addr &&
+                        subscriber.address.sin_port == address.sin_port) {
+
+                    if (fields == 0) {
+                        _subscribers.erase(_subscribers.begin() + k);
+                    }
+                    else {
+                        subscriber.fields = fields;
+                        subscriber.divisor = divisor;
+                        subscriber.expires = now + _leaseSeconds;
+                    }
+
+                    return;
+                }
+            }
+
+            if (fields) {
+                subscriber_t subscriber = {};
+                subscriber.address = address;
+                subscriber.fields = fields;
+                subscriber.divisor = divisor;
+                subscriber.expires = now + _leaseSeconds;
+                _subscribers.push_back(subscriber);
+            }
+        }
+
+    public:
+
+        /**
+         * @param port port on which to accept SUBSCRIBE packets
+         * @param vehicleId vehicle id for outgoing packets
+         * @param leaseSeconds how long a subscription lasts without renewal
+         */
+        TelemetryPublisher(const short port, uint16_t vehicleId=0, double leaseSeconds=5)
+        {
+            _vehicleId = vehicleId;
+            _leaseSeconds = leaseSeconds;
+
+            // Initialize Winsock, returning on failure
+            if (!initWinsock()) return;
+
+            // Create socket
+            _sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (_sock == INVALID_SOCKET) {
+                sprintf_s(_message, "socket() failed");
+                return;
+            }
+
+            // Bind
+            struct sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = INADDR_ANY;
+            local.sin_port = htons(port);
+
+            if (bind(_sock, (struct sockaddr *)&local, sizeof(local)) == SOCKET_ERROR) {
+                sprintf_s(_message, "bind() failed");
+                return;
+            }
+
+            // Requests are picked up between simulation steps, so the socket must never block
+#ifdef _WIN32
+            u_long nonblocking = 1;
+            ioctlsocket(_sock, FIONBIO, &nonblocking);
+#else
+            fcntl(_sock, F_SETFL, fcntl(_sock, F_GETFL, 0) | O_NONBLOCK);
+#endif
+        }
+
+        // Handles any pending SUBSCRIBE packets, and drops lapsed subscriptions
+        void poll(double now)
+        {
+            while (true) {
+
+                uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+                struct sockaddr_in from = {};
+                socklen_t fromlen = sizeof(from);
+
+                int size = (int)recvfrom(_sock, (char *)buf, sizeof(buf), 0, (struct sockaddr *)&from, &fromlen);
+
+                if (size < 0) break;
+
+                WireProtocol::header_t header = {};
+                double values[WireProtocol::MAX_VALUES] = {};
+
+                if (WireProtocol::decode(buf, size, header, values, WireProtocol::MAX_VALUES) &&
+                        header.type == WireProtocol::TYPE_SUBSCRIBE && header.count >= WireProtocol::SUBSCRIBE_COUNT) {
+
+                    uint16_t fields = (uint16_t)values[WireProtocol::SUBSCRIBE_FIELDS];
+                    double divisor = values[WireProtocol::SUBSCRIBE_DIVISOR];
+
+                    subscribe(from, fields, divisor >= 1 ? (uint32_t)divisor : 1, now);
+                }
+            }
+
+            for (size_t k=_subscribers.size(); k>0; --k) {
+                if (_subscribers[k-1].expires < now) {
+                    _subscribers.erase(_subscribers.begin() + k - 1);
+                }
+            }
+        }
+
+        /**
+         * Sends each subscriber due at this step its fields.
+         *
+         * @param step simulation step count
+         * @param simTime simulation time in seconds
+         * @param telemetry all state fields, at WireProtocol::TELEM_ offsets
+         * @param motors motor values
+         * @param motorCount number of motor values
+         */
+        void publish(uint64_t step, double simTime, const double * telemetry, const double * motors, uint8_t motorCount)
+        {
+            for (subscriber_t & subscriber : _subscribers) {
+
+                if (step % subscriber.divisor) continue;
+
+                double values[WireProtocol::MAX_VALUES] = {};
+                uint8_t count = WireProtocol::selectFields(subscriber.fields, telemetry, motors, motorCount, values);
+
+                uint8_t buf[WireProtocol::MAX_PACKET_SIZE] = {};
+                uint32_t size = WireProtocol::encode(buf, sizeof(buf), WireProtocol::TYPE_TELEMETRY, _vehicleId,
+                        subscriber.sequence++, simTime, values, count, false, -1, subscriber.fields);
+
+                sendto(_sock, (const char *)buf, (int)size, 0, (struct sockaddr *)&subscriber.address,
+                        sizeof(subscriber.address));
+            }
+        }
+
+        size_t getSubscriberCount(void)
+        {
+            return _subscribers.size();
+        }
+
+        static TelemetryPublisher * free(TelemetryPublisher * publisher)
+        {
+            publisher->closeConnection();
+            delete publisher;
+            return NULL;
+        }
+};
@@ -0,0 +1,342 @@
+/*
+   Shared-memory alternative to TwoWayUdp, for a controller on the same host
+
+   Two single-producer/single-consumer rings live in a POSIX shared-memory
+   object: one carries packets from simulator to controller (telemetry), the
+   other from controller to simulator (commands).  A packet is copied once
+   into a ring slot and once out of it, with no system calls on the fast
+   path.
+
+   Receivers can either spin on the ring (MODE_BUSY_POLL: lowest latency,
+   burns a core) or sleep on a futex until the sender publishes
+   (MODE_FUTEX).  Senders always wake a sleeping receiver, so the two ends
+   may use different modes.  A sender that can't issue futex wakeups (the
+   Java end) marks its ring as sleepless, and the receiver then polls
+   whatever its mode.  Futex sleeps last at most FUTEX_SLICE_MSEC before
+   the ring is checked again.  On platforms without futexes MODE_FUTEX falls
+   back to polling with sched_yield().
+
+   Layout (all fields little-endian; matches Extras/python/multicopter_sim/shm.py
+   and Extras/java/TwoWayShm.java):
+
+     offset           size       contents
+     ---------------  ---------  ----------------------------------------
+     0                64         magic, version, slot size, slot count
+     64               RING_SIZE  ring 0: simulator => controller
+     64 + RING_SIZE   RING_SIZE  ring 1: controller => simulator
+
+   Each ring is one cache line holding the producer's head index and
+   sleepless flag, one holding the consumer's tail index and waiter count,
+   then SLOT_COUNT slots of SLOT_SIZE bytes, each a uint32 length followed
+   by the packet.  An all-zero object is a valid empty pair of rings, so
+   either end may create it, and either end may attach after the other has
+   sent: packets already in its incoming ring are kept.  A full ring drops
+   the new packet, as a full UDP socket buffer would.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <atomic>
+
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+class TwoWayShm {
+
+    public:
+
+        typedef enum {
+
+            MODE_BUSY_POLL,
+            MODE_FUTEX
+
+        } wait_mode_t;
+
+        typedef enum {
+
+            ENDPOINT_SIMULATOR,
+            ENDPOINT_CONTROLLER
+
+        } endpoint_t;
+
+        static const uint32_t MAGIC      = 0x4d48534d; // "MSHM"
+        static const uint32_t VERSION    = 1;
+
+        static const uint32_t SLOT_COUNT = 64;   // power of two
+        static const uint32_t SLOT_SIZE  = 1024;
+        static const uint32_t MAX_PACKET = SLOT_SIZE - sizeof(uint32_t);
+
+        static const uint32_t FUTEX_SLICE_MSEC = 100;
+
+        static const uint32_t HEADER_SIZE = 64;
+        static const uint32_t RING_SIZE   = 128 + SLOT_COUNT * SLOT_SIZE;
+        static const uint32_t TOTAL_SIZE  = HEADER_SIZE + 2 * RING_SIZE;
+
+    private:
+
+        typedef struct {
+
+            uint32_t magic;
+            uint32_t version;
+            uint32_t slotSize;
+            uint32_t slotCount;
+
+        } header_t;
+
+        // Producer and consumer indices on separate cache lines to avoid false sharing
+        typedef struct {
+
+            alignas(64) std::atomic<uint32_t> head;
+            std::atomic<uint32_t> sleepless;
+
+            alignas(64) std::atomic<uint32_t> tail;
+            std::atomic<uint32_t> waiters;
+
+            alignas(64) uint8_t slots[SLOT_COUNT][SLOT_SIZE];
+
+        } ring_t;
+
+        static_assert(sizeof(ring_t) == RING_SIZE, "unexpected ring layout");
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomics must be plain words");
+
+        char _message[200] = {};
+
+        uint8_t * _base = NULL;
+
+        ring_t * _outgoing = NULL;
+        ring_t * _incoming = NULL;
+
+        wait_mode_t _mode = MODE_FUTEX;
+
+        uint32_t _timeoutMsec = 0;
+
+        static void futexWait(std::atomic<uint32_t> * addr, uint32_t expected, const struct timespec * timeout)
+        {
+#ifdef __linux__
+            // Not FUTEX_PRIVATE: the word is shared with another process
+            syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAIT, expected, timeout, NULL, 0);
+#else
+            (void)addr;
+            (void)expected;
+            (void)timeout;
+            sched_yield();
+#endif
+        }
+
+        static void futexWake(std::atomic<uint32_t> * addr)
+        {
+#ifdef __linux__
+            syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+#else
+            (void)addr;
+#endif
+        }
+
+        static double monotonic(void)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ts.tv_sec + ts.tv_nsec / 1e9;
+        }
+
+        // Waits until incoming ring is non-empty; returns false on timeout
+        bool waitForPacket(uint32_t tail)
+        {
+            double deadline = _timeoutMsec ? monotonic() + _timeoutMsec / 1e3 : 0;
+
+            for (uint32_t spins=0; ; ++spins) {
+
+                uint32_t head = _incoming->head.load(std::memory_order_acquire);
+
+                if (head != tail) return true;
+
+                // Check the clock only occasionally while spinning
+                if (_timeoutMsec && (spins & 0xff) == 0 && monotonic() > deadline) return false;
+
+                if (_mode == MODE_BUSY_POLL || _incoming->sleepless.load(std::memory_order_relaxed)) continue;
+
+                // Announce ourselves, then re-check so a concurrent send can't be missed
+                _incoming->waiters.fetch_add(1, std::memory_order_seq_cst);
+
+                if (_incoming->head.load(std::memory_order_seq_cst) == tail) {
+
+                    // Sleep in slices, so that a peer that attaches sleepless is noticed
+                    double remaining = FUTEX_SLICE_MSEC / 1e3;
+
+                    if (_timeoutMsec) {
+                        double left = deadline - monotonic();
+                        if (left <= 0) {
+                            _incoming->waiters.fetch_sub(1, std::memory_order_relaxed);
+                            return false;
+                        }
+                        remaining = left < remaining ? left : remaining;
+                    }
+
+                    struct timespec timeout = {};
+                    timeout.tv_sec = (time_t)remaining;
+                    timeout.tv_nsec = (long)((remaining - timeout.tv_sec) * 1e9);
+
+                    futexWait(&_incoming->head, head, &timeout);
+                }
+
+                _incoming->waiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+
+    public:
+
+        /**
+         * Opens (creating if needed) a shared-memory channel.
+         *
+         * @param name name of shared-memory object, e.g. "/multicopter_sim"
+         * @param endpoint which end of the channel this is
+         * @param mode how receive() waits for packets
+         * @param timeout_msec receive() timeout; zero waits forever
+         */
+        TwoWayShm(const char * name, endpoint_t endpoint, wait_mode_t mode=MODE_FUTEX, uint32_t timeout_msec=0)
+        {
+            _mode = mode;
+            _timeoutMsec = timeout_msec;
+
+            int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+            if (fd < 0) {
+                snprintf(_message, sizeof(_message), "shm_open() failed");
+                return;
+            }
+
+            // Newly created objects are zero-filled, which is a valid empty state
+            struct stat st = {};
+            if (fstat(fd, &st) < 0 || (st.st_size < (off_t)TOTAL_SIZE && ftruncate(fd, TOTAL_SIZE) < 0)) {
+                snprintf(_message, sizeof(_message), "ftruncate() failed");
+                close(fd);
+                return;
+            }
+
+            void * base = mmap(NULL, TOTAL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+
+            if (base == MAP_FAILED) {
+                snprintf(_message, sizeof(_message), "mmap() failed");
+                return;
+            }
+
+            header_t * header = (header_t *)base;
+
+            if (header->magic && (header->magic != MAGIC || header->version != VERSION ||
+                        header->slotSize != SLOT_SIZE || header->slotCount != SLOT_COUNT)) {
+                snprintf(_message, sizeof(_message), "%s has an incompatible layout", name);
+                munmap(base, TOTAL_SIZE);
+                return;
+            }
+
+            // Both ends write identical values, so no ordering is needed
+            header->version = VERSION;
+            header->slotSize = SLOT_SIZE;
+            header->slotCount = SLOT_COUNT;
+            header->magic = MAGIC;
+
+            _base = (uint8_t *)base;
+
+            ring_t * rings = (ring_t *)(_base + HEADER_SIZE);
+
+            _outgoing = &rings[endpoint == ENDPOINT_SIMULATOR ? 0 : 1];
+            _incoming = &rings[endpoint == ENDPOINT_SIMULATOR ? 1 : 0];
+
+            // This end can wake a sleeping receiver
+            _outgoing->sleepless.store(0, std::memory_order_relaxed);
+        }
+
+        // The mapping is owned by one object
+        TwoWayShm(const TwoWayShm &) = delete;
+        TwoWayShm & operator=(const TwoWayShm &) = delete;
+
+        ~TwoWayShm()
+        {
+            if (_base) {
+                munmap(_base, TOTAL_SIZE);
+            }
+        }
+
+        // Removes the shared-memory object; mapped ends keep working until they close
+        static void unlink(const char * name)
+        {
+            shm_unlink(name);
+        }
+
+        bool isOpen(void)
+        {
+            return _base != NULL;
+        }
+
+        const char * getMessage(void)
+        {
+            return _message;
+        }
+
+        // Returns false if the packet was dropped because it is too big or the ring is full
+        bool send(void * data, size_t size)
+        {
+            if (!_base || size > MAX_PACKET) return false;
+
+            uint32_t head = _outgoing->head.load(std::memory_order_relaxed);
+
+            if (head - _outgoing->tail.load(std::memory_order_acquire) >= SLOT_COUNT) return false;
+
+            uint8_t * slot = _outgoing->slots[head & (SLOT_COUNT-1)];
+            uint32_t length = (uint32_t)size;
+            memcpy(slot, &length, sizeof(length));
+            memcpy(slot + sizeof(length), data, size);
+
+            // seq_cst pairs with the receiver's waiter announcement in waitForPacket()
+            _outgoing->head.store(head + 1, std::memory_order_seq_cst);
+
+            if (_outgoing->waiters.load(std::memory_order_seq_cst)) {
+                futexWake(&_outgoing->head);
+            }
+
+            return true;
+        }
+
+        bool receive(void * data, size_t size)
+        {
+            return receiveDatagram(data, size) == (int)size;
+        }
+
+        // For variable-sized packets: returns number of bytes received, or -1 on timeout/error
+        int receiveDatagram(void * data, size_t maxsize)
+        {
+            if (!_base) return -1;
+
+            uint32_t tail = _incoming->tail.load(std::memory_order_relaxed);
+
+            if (!waitForPacket(tail)) return -1;
+
+            const uint8_t * slot = _incoming->slots[tail & (SLOT_COUNT-1)];
+            uint32_t length = 0;
+            memcpy(&length, slot, sizeof(length));
+
+            // Like recvfrom(), truncate packets that don't fit
+            uint32_t copied = length < maxsize ? length : (uint32_t)maxsize;
+            memcpy(data, slot + sizeof(length), copied);
+
+            _incoming->tail.store(tail + 1, std::memory_order_release);
+
+            return (int)copied;
+        }
+};
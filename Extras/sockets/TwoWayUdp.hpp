@@ -42,4 +42,10 @@ class TwoWayUdp {
         {
             return _server ?  _server->receiveData(data, size) : false;
         }
+
+        // For variable-sized packets: returns number of bytes received, or -1 on timeout/error
+        int receiveDatagram(void * data, size_t maxsize)
+        {
+            return _server ? _server->receiveDatagram(data, maxsize) : -1;
+        }
 }; 
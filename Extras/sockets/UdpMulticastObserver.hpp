@@ -0,0 +1,86 @@
+/*
+ * Class for UDP sockets that observe a multicast group
+ *
+ * Any number of observers, on this host or others, can join the same
+ * group and port; each receives its own copy of every packet.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "UdpSocket.hpp"
+
+#include <string.h>
+
+class UdpMulticastObserver : public UdpSocket {
+
+    public:
+
+        /**
+         * @param group multicast group address, e.g. "239.255.77.1"
+         * @param port port packets are published to
+         * @param interfaceAddress address of interface to join on, or NULL for the system's choice
+         * @param timeoutMsec receive timeout; zero waits forever
+         */
+        UdpMulticastObserver(const char * group, const short port, const char * interfaceAddress=NULL,
+                const uint32_t timeoutMsec=0)
+        {
+            // Initialize Winsock, returning on failure
+            if (!initWinsock()) return;
+
+            // Create socket
+            _sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (_sock == INVALID_SOCKET) {
+                sprintf_s(_message, "socket() failed");
+                return;
+            }
+
+            // Let several observers on one host share the port
+            int reuse = 1;
+            setsockopt(_sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&reuse, sizeof(reuse));
+#ifdef SO_REUSEPORT
+            setsockopt(_sock, SOL_SOCKET, SO_REUSEPORT, (const char *)&reuse, sizeof(reuse));
+#endif
+
+            // Bind
+            struct sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = INADDR_ANY;
+            local.sin_port = htons(port);
+
+            if (bind(_sock, (struct sockaddr *)&local, sizeof(local)) == SOCKET_ERROR) {
+                sprintf_s(_message, "bind() failed");
+                return;
+            }
+
+            // Join group
+            struct sockaddr_in groupAddress = {};
+            Socket::inetPton(group, groupAddress);
+
+            struct ip_mreq membership = {};
+            membership.imr_multiaddr = groupAddress.sin_addr;
+            membership.imr_interface.s_addr = htonl(INADDR_ANY);
+
+            if (interfaceAddress) {
+                struct sockaddr_in iface = {};
+                Socket::inetPton(interfaceAddress, iface);
+                membership.imr_interface = iface.sin_addr;
+            }
+
+            if (setsockopt(_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char *)&membership, sizeof(membership)) < 0) {
+                sprintf_s(_message, "setsockopt(IP_ADD_MEMBERSHIP) failed");
+                return;
+            }
+
+            // Check for / set up optional timeout for receiveData
+            UdpSocket::setUdpTimeout(timeoutMsec);
+        }
+
+        static UdpMulticastObserver * free(UdpMulticastObserver * socket)
+        {
+            return (UdpMulticastObserver *)UdpSocket::free(socket);
+        }
+};
@@ -0,0 +1,67 @@
+/*
+ * Class for UDP sockets that publish to a multicast group
+ *
+ * One send reaches every observer that has joined the group, however many
+ * there are.  Loopback is enabled by default, so observers on the
+ * publishing host receive the packets too.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "UdpSocket.hpp"
+
+#include <string.h>
+
+class UdpMulticastPublisher : public UdpSocket {
+
+    public:
+
+        /**
+         * @param group multicast group address, e.g. "239.255.77.1"
+         * @param port destination port
+         * @param interfaceAddress address of interface to send on (e.g. "127.0.0.1" on a host
+         *        without a multicast route), or NULL for the system's choice
+         * @param ttl hops packets may travel; 1 keeps them on the local network
+         * @param loopback deliver to observers on this host
+         */
+        UdpMulticastPublisher(const char * group, const short port, const char * interfaceAddress=NULL,
+                const uint8_t ttl=1, const bool loopback=true)
+        {
+            // Initialize Winsock, returning on failure
+            if (!initWinsock()) return;
+
+            // Create socket
+            _sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (_sock == INVALID_SOCKET) {
+                sprintf_s(_message, "socket() failed");
+                return;
+            }
+
+            // Setup address structure
+            memset((char *)&_si_other, 0, sizeof(_si_other));
+            _si_other.sin_family = AF_INET;
+            _si_other.sin_port = htons(port);
+            Socket::inetPton(group, _si_other);
+
+            int ittl = ttl;
+            setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&ittl, sizeof(ittl));
+
+            int iloop = loopback ? 1 : 0;
+            setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_LOOP, (const char *)&iloop, sizeof(iloop));
+
+            if (interfaceAddress) {
+                struct sockaddr_in iface = {};
+                Socket::inetPton(interfaceAddress, iface);
+                setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_IF, (const char *)&iface.sin_addr, sizeof(iface.sin_addr));
+            }
+        }
+
+        static UdpMulticastPublisher * free(UdpMulticastPublisher * socket)
+        {
+            return (UdpMulticastPublisher *)UdpSocket::free(socket);
+        }
+};
@@ -0,0 +1,357 @@
+/*
+ * Class for a UDP socket shared by many vehicles, with batched I/O
+ *
+ * Every packet carries a WireProtocol header, whose vehicle id selects the
+ * vehicle.  The socket remembers the address each vehicle's packets come
+ * from and sends that vehicle's packets back there, so one socket and port
+ * serves a whole swarm.
+ *
+ * On Linux, receiveBatch() and flush() move a whole batch of datagrams with
+ * a single recvmmsg() / sendmmsg() call; elsewhere they fall back to a loop
+ * of recvfrom() / sendto().
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "SocketCompat.hpp"
+#include "WireProtocol.hpp"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
+
+class UdpMuxSocket : public Socket {
+
+    public:
+
+        static const uint16_t MAX_BATCH = 256;
+
+        typedef struct {
+
+            uint16_t vehicleId;
+            uint32_t size;
+            const uint8_t * data;
+            bool newPeer;   // first packet for this vehicle, or from a new address
+
+        } packet_t;
+
+    private:
+
+        static const uint32_t SLOT_SIZE = WireProtocol::MAX_PACKET_SIZE;
+
+        static const int BUFFER_SIZE = 4 * 1024 * 1024;
+
+        uint16_t _maxVehicles = 0;
+
+        // Address of each vehicle's peer, learned from its packets or set with setPeer()
+        struct sockaddr_in * _peers = NULL;
+        bool * _havePeer = NULL;
+
+        // Receive batch
+        uint8_t * _recvBuffers = NULL;
+        struct sockaddr_in * _recvAddrs = NULL;
+        packet_t * _received = NULL;
+
+        // Send batch
+        uint8_t * _sendBuffers = NULL;
+        uint32_t * _sendSizes = NULL;
+        uint16_t * _sendVehicles = NULL;
+        uint16_t _sendCount = 0;
+
+#ifdef __linux__
+        struct mmsghdr * _recvMsgs = NULL;
+        struct iovec * _recvIovs = NULL;
+
+        struct mmsghdr * _sendMsgs = NULL;
+        struct iovec * _sendIovs = NULL;
+#endif
+
+        // Receives up to MAX_BATCH datagrams, returning how many arrived
+        int receiveRaw(void)
+        {
+#ifdef __linux__
+            for (uint16_t k=0; k<MAX_BATCH; ++k) {
+                _recvMsgs[k].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            }
+
+            // Waits (up to the socket timeout) for the first datagram only
+            int count = recvmmsg(_sock, _recvMsgs, MAX_BATCH, MSG_WAITFORONE, NULL);
+
+            for (int k=0; k<count; ++k) {
+                _received[k].size = _recvMsgs[k].msg_len;
+            }
+
+            return count;
+#else
+            int count = 0;
+
+            while (count < MAX_BATCH) {
+
+                // Only the first datagram may wait
+                if (count > 0) {
+                    fd_set readable;
+                    FD_ZERO(&readable);
+                    FD_SET(_sock, &readable);
+                    struct timeval zero = {};
+                    if (select((int)_sock+1, &readable, NULL, NULL, &zero) <= 0) break;
+                }
+
+                socklen_t addrlen = sizeof(struct sockaddr_in);
+
+                int size = (int)recvfrom(_sock, (char *)&_recvBuffers[count*SLOT_SIZE], SLOT_SIZE, 0,
+                        (struct sockaddr *)&_recvAddrs[count], &addrlen);
+
+                if (size < 0) break;
+
+                _received[count++].size = size;
+            }
+
+            return count > 0 ? count : -1;
+#endif
+        }
+
+    public:
+
+        // Datagrams dropped by receiveBatch() for lacking a valid header or vehicle id
+        uint32_t packetsRejected = 0;
+
+        /**
+         * @param port local port; zero picks any free port
+         * @param timeoutMsec how long receiveBatch() waits for the first datagram; zero waits forever
+         * @param maxVehicles vehicle ids must be less than this
+         */
+        UdpMuxSocket(const short port, const uint32_t timeoutMsec=0, const uint16_t maxVehicles=256)
+        {
+            _maxVehicles = maxVehicles;
+
+            _peers = new struct sockaddr_in [maxVehicles]();
+            _havePeer = new bool [maxVehicles]();
+
+            _recvBuffers = new uint8_t [MAX_BATCH * SLOT_SIZE];
+            _recvAddrs = new struct sockaddr_in [MAX_BATCH]();
+            _received = new packet_t [MAX_BATCH]();
+
+            _sendBuffers = new uint8_t [MAX_BATCH * SLOT_SIZE];
+            _sendSizes = new uint32_t [MAX_BATCH];
+            _sendVehicles = new uint16_t [MAX_BATCH];
+
+#ifdef __linux__
+            _recvMsgs = new struct mmsghdr [MAX_BATCH]();
+            _recvIovs = new struct iovec [MAX_BATCH]();
+            _sendMsgs = new struct mmsghdr [MAX_BATCH]();
+            _sendIovs = new struct iovec [MAX_BATCH]();
+
+            // Receive buffers and addresses never move, so their headers are set up once
+            for (uint16_t k=0; k<MAX_BATCH; ++k) {
+                _recvIovs[k].iov_base = &_recvBuffers[k*SLOT_SIZE];
+                _recvIovs[k].iov_len = SLOT_SIZE;
+                _recvMsgs[k].msg_hdr.msg_iov = &_recvIovs[k];
+                _recvMsgs[k].msg_hdr.msg_iovlen = 1;
+                _recvMsgs[k].msg_hdr.msg_name = &_recvAddrs[k];
+
+                _sendIovs[k].iov_base = &_sendBuffers[k*SLOT_SIZE];
+                _sendMsgs[k].msg_hdr.msg_iov = &_sendIovs[k];
+                _sendMsgs[k].msg_hdr.msg_iovlen = 1;
+                _sendMsgs[k].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            }
+#endif
+
+            // Initialize Winsock, returning on failure
+            if (!initWinsock()) return;
+
+            // Create socket
+            _sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+            if (_sock == INVALID_SOCKET) {
+                sprintf_s(_message, "socket() failed");
+                return;
+            }
+
+            // Bind
+            struct sockaddr_in local = {};
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = INADDR_ANY;
+            local.sin_port = htons(port);
+
+            if (bind(_sock, (struct sockaddr *)&local, sizeof(local)) == SOCKET_ERROR) {
+                sprintf_s(_message, "bind() failed");
+                return;
+            }
+
+            // A whole swarm's packets can arrive at once
+            setBufferSizes(BUFFER_SIZE, BUFFER_SIZE);
+
+            // Check for / set up optional timeout for receiveBatch
+            if (timeoutMsec > 0) {
+                Socket::setUdpTimeout(timeoutMsec);
+            }
+        }
+
+        ~UdpMuxSocket(void)
+        {
+            delete[] _peers;
+            delete[] _havePeer;
+            delete[] _recvBuffers;
+            delete[] _recvAddrs;
+            delete[] _received;
+            delete[] _sendBuffers;
+            delete[] _sendSizes;
+            delete[] _sendVehicles;
+
+#ifdef __linux__
+            delete[] _recvMsgs;
+            delete[] _recvIovs;
+            delete[] _sendMsgs;
+            delete[] _sendIovs;
+#endif
+        }
+
+        // Sets where a vehicle's packets go, for vehicles that haven't sent anything yet
+        void setPeer(uint16_t vehicleId, const char * host, const short port)
+        {
+            if (vehicleId >= _maxVehicles) return;
+
+            memset(&_peers[vehicleId], 0, sizeof(struct sockaddr_in));
+            _peers[vehicleId].sin_family = AF_INET;
+            _peers[vehicleId].sin_port = htons(port);
+            Socket::inetPton(host, _peers[vehicleId]);
+            _havePeer[vehicleId] = true;
+        }
+
+        // Stops sending to a vehicle until it is heard from again
+        void clearPeer(uint16_t vehicleId)
+        {
+            if (vehicleId < _maxVehicles) {
+                _havePeer[vehicleId] = false;
+            }
+        }
+
+        bool hasPeer(uint16_t vehicleId)
+        {
+            return vehicleId < _maxVehicles && _havePeer[vehicleId];
+        }
+
+        /**
+         * Receives all datagrams that are waiting, up to MAX_BATCH, waiting for the first one
+         * up to the timeout.  Packets stay valid until the next call.
+         *
+         * @return number of packets, available through getPacket()
+         */
+        uint16_t receiveBatch(void)
+        {
+            int count = receiveRaw();
+
+            uint16_t accepted = 0;
+
+            for (int k=0; k<count; ++k) {
+
+                const uint8_t * data = &_recvBuffers[k*SLOT_SIZE];
+                uint32_t size = _received[k].size;
+
+                WireProtocol::header_t header = {};
+
+                if (!WireProtocol::isPacket(data, size)) {
+                    packetsRejected++;
+                    continue;
+                }
+
+                memcpy(&header, data, sizeof(header));
+
+                if (header.vehicleId >= _maxVehicles) {
+                    packetsRejected++;
+                    continue;
+                }
+
+                struct sockaddr_in & from = _recvAddrs[k];
+                struct sockaddr_in & peer = _peers[header.vehicleId];
+
+                bool newPeer = !_havePeer[header.vehicleId] ||
+                    from.sin_addr.s_addr != peer.sin_addr.s_addr || from.sin_port != peer.sin_port;
+
+                // Replies to this vehicle go wherever its latest packet came from
+                peer = from;
+                _havePeer[header.vehicleId] = true;
+
+                packet_t & packet = _received[accepted++];
+                packet.vehicleId = header.vehicleId;
+                packet.newPeer = newPeer;
+                packet.size = size;
+                packet.data = data;
+            }
+
+            return accepted;
+        }
+
+        const packet_t & getPacket(uint16_t index)
+        {
+            return _received[index];
+        }
+
+        /**
+         * Copies a packet into the send batch, flushing first if the batch is full.
+         *
+         * @return false if the vehicle has no known peer or the packet is too big
+         */
+        bool queue(uint16_t vehicleId, const void * data, size_t size)
+        {
+            if (!hasPeer(vehicleId) || size > SLOT_SIZE) return false;
+
+            if (_sendCount == MAX_BATCH) {
+                flush();
+            }
+
+            memcpy(&_sendBuffers[_sendCount*SLOT_SIZE], data, size);
+            _sendSizes[_sendCount] = (uint32_t)size;
+            _sendVehicles[_sendCount] = vehicleId;
+            _sendCount++;
+
+            return true;
+        }
+
+        /**
+         * Sends every queued packet.
+         *
+         * @return number of packets sent
+         */
+        uint16_t flush(void)
+        {
+            uint16_t sent = 0;
+
+#ifdef __linux__
+            for (uint16_t k=0; k<_sendCount; ++k) {
+                _sendIovs[k].iov_len = _sendSizes[k];
+                _sendMsgs[k].msg_hdr.msg_name = &_peers[_sendVehicles[k]];
+            }
+
+            // sendmmsg() may stop early, e.g. when interrupted
+            while (sent < _sendCount) {
+                int count = sendmmsg(_sock, &_sendMsgs[sent], _sendCount - sent, 0);
+                if (count <= 0) break;
+                sent += count;
+            }
+#else
+            for (uint16_t k=0; k<_sendCount; ++k) {
+                if (sendto(_sock, (const char *)&_sendBuffers[k*SLOT_SIZE], (int)_sendSizes[k], 0,
+                            (struct sockaddr *)&_peers[_sendVehicles[k]], sizeof(struct sockaddr_in)) >= 0) {
+                    sent++;
+                }
+            }
+#endif
+
+            _sendCount = 0;
+
+            return sent;
+        }
+
+        static UdpMuxSocket * free(UdpMuxSocket * socket)
+        {
+            socket->closeConnection();
+            delete socket;
+            return NULL;
+        }
+};
@@ -37,6 +37,12 @@ class UdpSocket : public Socket {
             return recvfrom(_sock, (char *)buf, (int)len, 0, (struct sockaddr *) &_si_other, &_slen) == (RECVSIZE)len;
         }
 
+        // For variable-sized datagrams: returns number of bytes received, or -1 on timeout/error
+        int receiveDatagram(void * buf, size_t maxlen)
+        {
+            return (int)recvfrom(_sock, (char *)buf, (int)maxlen, 0, (struct sockaddr *) &_si_other, &_slen);
+        }
+
         static UdpSocket * free(UdpSocket * socket)
         {
             socket->closeConnection();
@@ -0,0 +1,362 @@
+/*
+ * Versioned binary packet format for MulticopterSim telemetry and commands
+ *
+ * Every packet starts with a 32-byte header:
+ *
+ *   offset  type     field
+ *   ------  -------  ---------------------------------------------
+ *    0      uint32   magic ("MCSP")
+ *    4      uint8    version
+ *    5      uint8    type (TELEMETRY, MOTORS, ...)
+ *    6      uint8    flags (FLAG_FLOAT32 => payload is float32)
+ *    7      uint8    count of payload values
+ *    8      uint16   vehicle id
+ *   10      uint16   fields (TELEMETRY: FIELD_ bits present; zero => all state fields)
+ *   12      uint32   sequence number, incremented per packet by sender
+ *   16      float64  simulation time in seconds
+ *   24      float64  sender's wall-clock time in seconds (for latency)
+ *
+ * followed by count float64 (or float32) values.  All fields are
+ * little-endian.  TELEMETRY payloads follow the field order of
+ * Dynamics::state_t; see the TELEM_ offsets below.  A subscribed TELEMETRY
+ * packet carries only the fields its subscriber asked for, in the same
+ * order, with any motor values last.
+ *
+ * A SUBSCRIBE packet asks for TELEMETRY with the FIELD_ bits in its first
+ * value, every n-th simulation step, n being its second value.  Zero
+ * fields cancels the subscription.
+ *
+ * A STICKS packet carries stick values for a vehicle's receiver: throttle,
+ * roll, pitch, yaw, aux1 and aux2, each between -1 and +1.
+ *
+ * Matching decoders: Extras/python/multicopter_sim/protocol.py and
+ * Extras/java/WireProtocol.java.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+class WireProtocol {
+
+    public:
+
+        static const uint32_t MAGIC   = 0x5053434d; // "MCSP"
+        static const uint8_t  VERSION = 1;
+
+        typedef enum {
+
+            TYPE_TELEMETRY = 1,
+            TYPE_MOTORS    = 2,
+            TYPE_SUBSCRIBE = 3,
+            TYPE_STICKS    = 4
+
+        } type_t;
+
+        static const uint8_t FLAG_FLOAT32 = 0x01;
+
+#pragma pack(push, 1)
+        typedef struct {
+
+            uint32_t magic;
+            uint8_t  version;
+            uint8_t  type;
+            uint8_t  flags;
+            uint8_t  count;
+            uint16_t vehicleId;
+            uint16_t fields;
+            uint32_t sequence;
+            double   simTime;
+            double   sendTime;
+
+        } header_t;
+#pragma pack(pop)
+
+        static const uint8_t  MAX_VALUES = 64;
+        static const uint32_t MAX_PACKET_SIZE = sizeof(header_t) + MAX_VALUES * sizeof(double);
+
+        // Offsets of state_t fields in TELEMETRY payload
+        enum {
+
+            TELEM_ANGULAR_VEL  = 0,
+            TELEM_BODY_ACCEL   = 3,
+            TELEM_INERTIAL_VEL = 6,
+            TELEM_QUATERNION   = 9,
+            TELEM_LOCATION     = 13,
+            TELEM_ROTATION     = 16,
+            TELEM_COUNT        = 19
+        };
+
+        // Field-selection bits for SUBSCRIBE requests and subscribed TELEMETRY packets
+        enum {
+
+            FIELD_ANGULAR_VEL  = 0x01,
+            FIELD_BODY_ACCEL   = 0x02,
+            FIELD_INERTIAL_VEL = 0x04,
+            FIELD_QUATERNION   = 0x08,
+            FIELD_LOCATION     = 0x10,
+            FIELD_ROTATION     = 0x20,
+            FIELD_MOTORS       = 0x40,
+
+            FIELD_POSE         = FIELD_LOCATION | FIELD_ROTATION,
+            FIELD_STATE        = 0x3f
+        };
+
+        // Offsets of values in SUBSCRIBE payload
+        enum {
+
+            SUBSCRIBE_FIELDS  = 0,
+            SUBSCRIBE_DIVISOR = 1,
+            SUBSCRIBE_COUNT   = 2
+        };
+
+        /**
+         * Packs the requested fields, in TELEM_ order with motors last.
+         *
+         * @param fields FIELD_ bits
+         * @param telemetry all state fields, at TELEM_ offsets
+         * @param motors motor values, used if fields includes FIELD_MOTORS
+         * @param motorCount number of motor values
+         * @param values output, with room for TELEM_COUNT + motorCount values
+         * @return number of values packed
+         */
+        static uint8_t selectFields(uint16_t fields, const double * telemetry, const double * motors,
+                uint8_t motorCount, double * values)
+        {
+            static const uint8_t offsets[6] = {TELEM_ANGULAR_VEL, TELEM_BODY_ACCEL, TELEM_INERTIAL_VEL,
+                TELEM_QUATERNION, TELEM_LOCATION, TELEM_ROTATION};
+            static const uint8_t sizes[6] = {3, 3, 3, 4, 3, 3};
+
+            uint8_t count = 0;
+
+            for (uint8_t k=0; k<6; ++k) {
+                if (fields & (1<<k)) {
+                    memcpy(&values[count], &telemetry[offsets[k]], sizes[k]*sizeof(double));
+                    count += sizes[k];
+                }
+            }
+
+            if (fields & FIELD_MOTORS) {
+                memcpy(&values[count], motors, motorCount*sizeof(double));
+                count += motorCount;
+            }
+
+            return count;
+        }
+
+        /**
+         * Encodes a packet.
+         *
+         * @return packet size in bytes, or zero if buffer is too small
+         */
+        static uint32_t encode(uint8_t * buf, uint32_t bufsize, uint8_t type, uint16_t vehicleId, uint32_t sequence,
+                double simTime, const double * values, uint8_t count, bool asFloat32=false, double sendTime=-1,
+                uint16_t fields=0)
+        {
+            uint32_t valsize = asFloat32 ? sizeof(float) : sizeof(double);
+            uint32_t size = sizeof(header_t) + count * valsize;
+
+            if (size > bufsize || count > MAX_VALUES) return 0;
+
+            header_t header = {};
+            header.magic = MAGIC;
+            header.version = VERSION;
+            header.type = type;
+            header.flags = asFloat32 ? FLAG_FLOAT32 : 0;
+            header.count = count;
+            header.vehicleId = vehicleId;
+            header.fields = fields;
+            header.sequence = sequence;
+            header.simTime = simTime;
+            header.sendTime = sendTime < 0 ? now() : sendTime;
+
+            memcpy(buf, &header, sizeof(header));
+
+            uint8_t * payload = buf + sizeof(header);
+
+            if (asFloat32) {
+                for (uint8_t k=0; k<count; ++k) {
+                    float f = (float)values[k];
+                    memcpy(&payload[k*sizeof(float)], &f, sizeof(float));
+                }
+            }
+            else {
+                memcpy(payload, values, count*sizeof(double));
+            }
+
+            return size;
+        }
+
+        /**
+         * Decodes a packet.
+         *
+         * @param buf received bytes
+         * @param size number of bytes received
+         * @param header output header
+         * @param values output values (always double)
+         * @param maxcount capacity of values
+         * @return true if packet is well-formed and of a version we understand
+         */
+        static bool decode(const uint8_t * buf, uint32_t size, header_t & header, double * values, uint8_t maxcount)
+        {
+            if (!isPacket(buf, size)) return false;
+
+            memcpy(&header, buf, sizeof(header));
+
+            bool asFloat32 = (header.flags & FLAG_FLOAT32) != 0;
+            uint32_t valsize = asFloat32 ? sizeof(float) : sizeof(double);
+
+            if (header.version != VERSION || header.count > maxcount || size < sizeof(header) + header.count*valsize) {
+                return false;
+            }
+
+            const uint8_t * payload = buf + sizeof(header);
+
+            if (asFloat32) {
+                for (uint8_t k=0; k<header.count; ++k) {
+                    float f = 0;
+                    memcpy(&f, &payload[k*sizeof(float)], sizeof(float));
+                    values[k] = f;
+                }
+            }
+            else {
+                memcpy(values, payload, header.count*sizeof(double));
+            }
+
+            return true;
+        }
+
+        // Distinguishes versioned packets from legacy raw-double packets
+        static bool isPacket(const uint8_t * buf, uint32_t size)
+        {
+            uint32_t magic = 0;
+            if (size < sizeof(header_t)) return false;
+            memcpy(&magic, buf, sizeof(magic));
+            return magic == MAGIC;
+        }
+
+        // Wall-clock time in seconds, comparable across processes on the same host
+        static double now(void)
+        {
+#ifdef _WIN32
+            FILETIME ft;
+            GetSystemTimeAsFileTime(&ft);
+            uint64_t t = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+            return t / 1e7 - 11644473600.; // 100-ns ticks since 1601 => seconds since 1970
+#else
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+        }
+
+}; // class WireProtocol
+
+/**
+ * Tracks sequence numbers on a receiving end, counting lost, late
+ * (reordered) and duplicate packets, and transport latency.
+ */
+class SequenceTracker {
+
+    private:
+
+        bool     _started = false;
+        uint32_t _first = 0;
+        uint32_t _highest = 0;
+
+        // Bit k set => packet (_highest - k) has arrived
+        uint64_t _window = 0;
+
+        double   _latencySum = 0;
+
+    public:
+
+        typedef enum {
+
+            PACKET_OK,          // newest packet so far
+            PACKET_LATE,        // arrived after a newer one; previously counted as lost
+            PACKET_DUPLICATE,   // already seen
+            PACKET_STALE        // too old to tell, or older than the first packet; treat as stale
+
+        } status_t;
+
+        uint32_t received   = 0;
+        uint32_t lost       = 0;
+        uint32_t late       = 0;
+        uint32_t duplicates = 0;
+
+        double   maxLatency = 0;
+
+        /**
+         * Records arrival of a packet.
+         *
+         * @param header header of received packet
+         * @param receiveTime receiver wall-clock time, from WireProtocol::now()
+         * @return status of packet; callers should normally ignore anything but PACKET_OK
+         */
+        status_t update(const WireProtocol::header_t & header, double receiveTime)
+        {
+            uint32_t seq = header.sequence;
+
+            received++;
+
+            double latency = receiveTime - header.sendTime;
+            _latencySum += latency;
+            if (latency > maxLatency) maxLatency = latency;
+
+            if (!_started) {
+                _started = true;
+                _first = seq;
+                _highest = seq;
+                _window = 1;
+                return PACKET_OK;
+            }
+
+            int32_t ahead = (int32_t)(seq - _highest);
+
+            if (ahead > 0) {
+                lost += ahead - 1;
+                _window = ahead < 64 ? (_window << ahead) | 1 : 1;
+                _highest = seq;
+                return PACKET_OK;
+            }
+
+            uint32_t behind = (uint32_t)(-ahead);
+
+            // Packets from before the first one seen were never counted as lost
+            if (behind >= 64 || (int32_t)(seq - _first) < 0) {
+                late++;
+                return PACKET_STALE;
+            }
+
+            uint64_t bit = (uint64_t)1 << behind;
+
+            if (_window & bit) {
+                duplicates++;
+                return PACKET_DUPLICATE;
+            }
+
+            _window |= bit;
+            lost--;
+            late++;
+
+            return PACKET_LATE;
+        }
+
+        double meanLatency(void)
+        {
+            return received ? _latencySum / received : 0;
+        }
+
+}; // class SequenceTracker
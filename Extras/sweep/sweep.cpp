@@ -0,0 +1,465 @@
+/*
+   Headless Monte Carlo / parameter-sweep runner for MulticopterSim dynamics
+
+   Usage: sweep SPECFILE [THREADS]
+
+   Flies many copies of a vehicle through a scenario with no simulator,
+   varying the Dynamics::Parameters and initial attitude from run to run as
+   the spec file says, and prints one CSV row of results per run.  Runs are
+   shared out across THREADS worker threads (default: one per core); each
+   thread steps a pool of vehicles in lockstep, reusing them from run to run.
+   Each run's random numbers come from its own seed, so results don't depend
+   on the thread count.  See phantom.sweep for the spec-file format.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+
+#include <HoverController.hpp>
+#include <VehicleConfig.hpp>
+
+static const uint8_t POOL_SIZE = 8;
+
+static const double CRASH_SPEED = 2.0;        // m/s
+static const double CRASH_TILT  = M_PI / 2;   // radians
+
+// Parameters and initial attitude, in the order they appear in results
+enum {
+    VAR_B,
+    VAR_D,
+    VAR_M,
+    VAR_L,
+    VAR_IX,
+    VAR_IY,
+    VAR_IZ,
+    VAR_JR,
+    VAR_MAXRPM,
+    VAR_ROLL,
+    VAR_PITCH,
+    VAR_YAW,
+    VAR_COUNT
+};
+
+static const char * VAR_NAMES[VAR_COUNT] = {"b", "d", "m", "l", "Ix", "Iy", "Iz", "Jr", "maxrpm", "roll", "pitch", "yaw"};
+
+// How a variable is chosen for each run
+typedef struct {
+
+    enum {FIXED, GRID, UNIFORM, NORMAL} kind;
+
+    double a;           // FIXED: value; GRID, UNIFORM: minimum; NORMAL: mean
+    double b;           // GRID, UNIFORM: maximum; NORMAL: standard deviation
+    uint32_t count;     // GRID: number of points
+
+} distribution_t;
+
+typedef struct {
+
+    double time;
+    double altitude;
+
+} target_t;
+
+typedef struct {
+
+    VehicleConfig::frame_t frame = VehicleConfig::FRAME_QUADXAP;
+
+    distribution_t vars[VAR_COUNT] = {};
+
+    uint32_t runs = 1;      // per grid point
+    uint64_t seed = 0;
+
+    double duration = 10;
+    double dt = 0.001;
+    double start = 0;       // initial altitude; zero starts on the ground
+
+    std::vector<target_t> targets;  // altitudes above ground
+
+    HoverController::gains_t gains;
+
+    uint32_t gridPoints = 1;
+
+} spec_t;
+
+typedef struct {
+
+    double rmsError;        // altitude error over the run, m
+    double finalError;      // altitude error at the end, m
+    double maxTilt;         // largest roll or pitch, radians
+    bool crashed;
+
+} result_t;
+
+// One vehicle in a worker's pool
+class Vehicle {
+
+    private:
+
+        Dynamics::Parameters _params = Dynamics::Parameters(0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+        Dynamics * _dynamics = NULL;
+
+        HoverController _controller;
+
+        const spec_t * _spec = NULL;
+
+        double _altIntegral = 0;
+        double _errorSquared = 0;
+        uint32_t _steps = 0;
+        bool _flown = false;
+
+        double targetAltitude(double time)
+        {
+            double altitude = 0;
+            for (const target_t & target : _spec->targets) {
+                if (target.time <= time) altitude = target.altitude;
+            }
+            return altitude;
+        }
+
+    public:
+
+        Vehicle(const spec_t & spec)
+        {
+            _spec = &spec;
+
+            _dynamics = VehicleConfig::createDynamics(spec.frame, &_params);
+
+            _controller = HoverController(spec.gains, _dynamics, &_params);
+        }
+
+        ~Vehicle(void)
+        {
+            delete _dynamics;
+        }
+
+        // Starts a run with the given parameters and initial attitude
+        void reset(const double vars[VAR_COUNT])
+        {
+            _params.b = vars[VAR_B];
+            _params.d = vars[VAR_D];
+            _params.m = vars[VAR_M];
+            _params.l = vars[VAR_L];
+            _params.Ix = vars[VAR_IX];
+            _params.Iy = vars[VAR_IY];
+            _params.Iz = vars[VAR_IZ];
+            _params.Jr = vars[VAR_JR];
+            _params.maxrpm = (uint16_t)vars[VAR_MAXRPM];
+
+            double rotation[3] = {vars[VAR_ROLL], vars[VAR_PITCH], vars[VAR_YAW]};
+            _dynamics->init(rotation, _spec->start > 0);
+
+            _altIntegral = 0;
+            _errorSquared = 0;
+            _steps = 0;
+            _flown = _spec->start > 0;
+        }
+
+        // Advances one step, returning false once the vehicle has crashed
+        bool step(double time, result_t & result)
+        {
+            Dynamics::state_t state = _dynamics->getState();
+
+            // Dynamics locations are relative to the starting point
+            double agl = _spec->start - state.pose.location[2];
+
+            // Hitting the ground hard, or tipping over, ends the run
+            if ((_flown && agl <= 0 && state.inertialVel[2] > CRASH_SPEED) ||
+                    fabs(state.pose.rotation[0]) > CRASH_TILT || fabs(state.pose.rotation[1]) > CRASH_TILT) {
+                result.crashed = true;
+                return false;
+            }
+
+            _flown |= agl > 0.1;
+
+            double target = targetAltitude(time);
+
+            double motorvals[Dynamics::MAX_MOTORS] = {};
+            _controller.control(state, agl, target, _altIntegral, _spec->dt, motorvals);
+
+            _dynamics->setAgl(agl);
+            _dynamics->setMotors(motorvals, _spec->dt);
+            _dynamics->update(_spec->dt);
+
+            double error = target - agl;
+            _errorSquared += error * error;
+            _steps++;
+
+            double tilt = fmax(fabs(state.pose.rotation[0]), fabs(state.pose.rotation[1]));
+            result.maxTilt = fmax(result.maxTilt, tilt);
+            result.finalError = error;
+            result.rmsError = sqrt(_errorSquared / _steps);
+
+            return true;
+        }
+};
+
+// Chooses run's variables: grid variables from its grid point, the rest at random
+static void chooseVars(const spec_t & spec, uint64_t run, double vars[VAR_COUNT])
+{
+    uint64_t point = run / spec.runs;
+
+    std::mt19937_64 random(spec.seed * 0x9e3779b97f4a7c15ull + run);
+
+    for (uint8_t j=0; j<VAR_COUNT; ++j) {
+
+        const distribution_t & dist = spec.vars[j];
+
+        switch (dist.kind) {
+
+            case distribution_t::FIXED:
+                vars[j] = dist.a;
+                break;
+
+            case distribution_t::GRID:
+                vars[j] = dist.count > 1 ? dist.a + (dist.b - dist.a) * (point % dist.count) / (dist.count - 1) : dist.a;
+                point /= dist.count;
+                break;
+
+            case distribution_t::UNIFORM:
+                vars[j] = std::uniform_real_distribution<double>(dist.a, dist.b)(random);
+                break;
+
+            case distribution_t::NORMAL:
+                vars[j] = std::normal_distribution<double>(dist.a, dist.b)(random);
+                break;
+        }
+    }
+}
+
+// Shared by the workers
+static std::atomic<uint64_t> nextRun;
+static std::mutex outputLock;
+
+static void work(const spec_t & spec, uint64_t totalRuns)
+{
+    std::vector<Vehicle *> pool;
+    for (uint8_t k=0; k<POOL_SIZE; ++k) {
+        pool.push_back(new Vehicle(spec));
+    }
+
+    uint64_t steps = (uint64_t)(spec.duration / spec.dt + 0.5);
+
+    std::string rows;
+
+    while (true) {
+
+        // Claim a pool's worth of runs
+        uint64_t first = nextRun.fetch_add(POOL_SIZE);
+        if (first >= totalRuns) break;
+
+        uint8_t count = (uint8_t)(totalRuns - first < POOL_SIZE ? totalRuns - first : POOL_SIZE);
+
+        double vars[POOL_SIZE][VAR_COUNT] = {};
+        result_t results[POOL_SIZE] = {};
+        bool flying[POOL_SIZE] = {};
+
+        for (uint8_t k=0; k<count; ++k) {
+            chooseVars(spec, first + k, vars[k]);
+            pool[k]->reset(vars[k]);
+            flying[k] = true;
+        }
+
+        // Step the pool in lockstep
+        for (uint64_t s=0; s<steps; ++s) {
+            double time = s * spec.dt;
+            for (uint8_t k=0; k<count; ++k) {
+                if (flying[k]) {
+                    flying[k] = pool[k]->step(time, results[k]);
+                }
+            }
+        }
+
+        rows.clear();
+
+        for (uint8_t k=0; k<count; ++k) {
+
+            char row[512] = {};
+            int n = snprintf(row, sizeof(row), "%llu", (unsigned long long)(first + k));
+            for (uint8_t j=0; j<VAR_COUNT; ++j) {
+                n += snprintf(row + n, sizeof(row) - n, ",%.6g", vars[k][j]);
+            }
+            snprintf(row + n, sizeof(row) - n, ",%.4f,%.4f,%.4f,%d\n",
+                    results[k].rmsError, results[k].finalError, results[k].maxTilt, results[k].crashed);
+
+            rows += row;
+        }
+
+        std::lock_guard<std::mutex> lock(outputLock);
+        fputs(rows.c_str(), stdout);
+    }
+
+    for (Vehicle * vehicle : pool) {
+        delete vehicle;
+    }
+}
+
+static bool parseSpec(const char * path, spec_t & spec)
+{
+    // Runs measure altitude hold alone, so the vehicle is free to drift
+    spec.gains.posP = 0;
+    spec.gains.posD = 0;
+
+    // Defaults are the Phantom's parameters, level, on the ground
+    const double defaults[VAR_COUNT] = {5.E-06, 2.E-06, 1.380, 0.350, 2, 2, 3, 38E-04, 15000, 0, 0, 0};
+
+    for (uint8_t j=0; j<VAR_COUNT; ++j) {
+        spec.vars[j].kind = distribution_t::FIXED;
+        spec.vars[j].a = defaults[j];
+    }
+
+    FILE * fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "Can't open %s\n", path);
+        return false;
+    }
+
+    char line[256] = {};
+
+    for (uint32_t lineno=1; fgets(line, sizeof(line), fp); ++lineno) {
+
+        // Strip comments
+        char * hash = strchr(line, '#');
+        if (hash) *hash = 0;
+
+        char name[64] = {}, kind[64] = {};
+        double a = 0, b = 0, c = 0;
+
+        int n = sscanf(line, "%63s %63s %lf %lf %lf", name, kind, &a, &b, &c);
+        if (n <= 0) continue;
+
+        int var = -1;
+        for (uint8_t j=0; j<VAR_COUNT; ++j) {
+            if (!strcmp(name, VAR_NAMES[j])) var = j;
+        }
+
+        bool ok = true;
+
+        if (var >= 0) {
+
+            distribution_t & dist = spec.vars[var];
+
+            if (!strcmp(kind, "fixed") && n >= 3) {
+                dist.kind = distribution_t::FIXED;
+                dist.a = a;
+            }
+            else if (!strcmp(kind, "grid") && n >= 5 && c >= 1) {
+                dist.kind = distribution_t::GRID;
+                dist.a = a;
+                dist.b = b;
+                dist.count = (uint32_t)c;
+            }
+            else if (!strcmp(kind, "uniform") && n >= 4) {
+                dist.kind = distribution_t::UNIFORM;
+                dist.a = a;
+                dist.b = b;
+            }
+            else if (!strcmp(kind, "normal") && n >= 4) {
+                dist.kind = distribution_t::NORMAL;
+                dist.a = a;
+                dist.b = b;
+            }
+            else {
+                ok = false;
+            }
+        }
+
+        else if (!strcmp(name, "frame") && n >= 2) {
+            ok = VehicleConfig::parseFrame(kind, spec.frame);
+        }
+
+        else {
+
+            // Everything else is a name and one or two numbers
+            n = sscanf(line, "%63s %lf %lf", name, &a, &b);
+
+            if (!strcmp(name, "runs") && n >= 2 && a >= 1) spec.runs = (uint32_t)a;
+            else if (!strcmp(name, "seed") && n >= 2) spec.seed = (uint64_t)a;
+            else if (!strcmp(name, "duration") && n >= 2 && a > 0) spec.duration = a;
+            else if (!strcmp(name, "dt") && n >= 2 && a > 0) spec.dt = a;
+            else if (!strcmp(name, "start") && n >= 2) spec.start = a;
+            else if (!strcmp(name, "target") && n >= 3) spec.targets.push_back({a, b});
+            else if (!strcmp(name, "altP") && n >= 2) spec.gains.altP = a;
+            else if (!strcmp(name, "altI") && n >= 2) spec.gains.altI = a;
+            else if (!strcmp(name, "altD") && n >= 2) spec.gains.altD = a;
+            else if (!strcmp(name, "attP") && n >= 2) spec.gains.attP = a;
+            else if (!strcmp(name, "attD") && n >= 2) spec.gains.attD = a;
+            else if (!strcmp(name, "yawD") && n >= 2) spec.gains.yawD = a;
+            else ok = false;
+        }
+
+        if (!ok) {
+            fprintf(stderr, "%s:%u: can't parse: %s", path, lineno, line);
+            fclose(fp);
+            return false;
+        }
+    }
+
+    fclose(fp);
+
+    for (uint8_t j=0; j<VAR_COUNT; ++j) {
+        if (spec.vars[j].kind == distribution_t::GRID) {
+            spec.gridPoints *= spec.vars[j].count;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s SPECFILE [THREADS]\n", argv[0]);
+        return 1;
+    }
+
+    spec_t spec;
+
+    if (!parseSpec(argv[1], spec)) {
+        return 1;
+    }
+
+    unsigned threadCount = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+    if (threadCount < 1) threadCount = 1;
+
+    uint64_t totalRuns = (uint64_t)spec.gridPoints * spec.runs;
+
+    printf("run");
+    for (uint8_t j=0; j<VAR_COUNT; ++j) {
+        printf(",%s", VAR_NAMES[j]);
+    }
+    printf(",rms_error,final_error,max_tilt,crashed\n");
+
+    nextRun = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned k=0; k<threadCount; ++k) {
+        threads.push_back(std::thread(work, std::cref(spec), totalRuns));
+    }
+
+    for (std::thread & thread : threads) {
+        thread.join();
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "%llu runs of %.1f sec on %u threads in %.2f sec (%.0f runs/sec)\n",
+            (unsigned long long)totalRuns, spec.duration, threadCount, elapsed, totalRuns / elapsed);
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+   C interface to VecEnv, for building a shared library that Python (or any
+   language with a C foreign-function interface) can load
+
+   The buffer functions return pointers into the environment's own arrays, so
+   callers can wrap them once (e.g. as numpy arrays) and read and write them in
+   place from then on, with no copying per step.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+ */
+
+#include <VecEnv.hpp>
+
+#include <string.h>
+
+#ifdef _WIN32
+#define EXPORT extern "C" __declspec(dllexport)
+#else
+#define EXPORT extern "C"
+#endif
+
+/**
+ * Creates an environment; returns NULL for an unknown frame.
+ *
+ * @param frame "quadxap", "octoxap" or "thrustvector"
+ * @param count number of vehicles
+ * @param params b, d, m, l, Ix, Iy, Iz, Jr, maxrpm
+ * @param dt seconds per physics step
+ * @param actionRepeat physics steps per call to vecenv_step()
+ * @param maxSteps calls to vecenv_step() per episode
+ * @param startAltitude m
+ * @param targetAltitude m
+ * @param initialTilt largest initial roll and pitch, radians
+ * @param maxTilt roll or pitch past which an episode ends, radians
+ * @param tiltPenalty reward per radian squared of tilt
+ * @param seed for initial attitudes
+ */
+EXPORT VecEnv * vecenv_create(const char * frame, uint32_t count, const double * params, double dt,
+        uint32_t actionRepeat, uint32_t maxSteps, double startAltitude, double targetAltitude,
+        double initialTilt, double maxTilt, double tiltPenalty, uint64_t seed)
+{
+    VehicleConfig::frame_t type = VehicleConfig::FRAME_QUADXAP;
+
+    if (!VehicleConfig::parseFrame(frame, type)) return NULL;
+
+    VecEnv::config_t config;
+    config.dt = dt;
+    config.actionRepeat = actionRepeat;
+    config.maxSteps = maxSteps;
+    config.startAltitude = startAltitude;
+    config.targetAltitude = targetAltitude;
+    config.initialTilt = initialTilt;
+    config.maxTilt = maxTilt;
+    config.tiltPenalty = tiltPenalty;
+    config.seed = seed;
+
+    Dynamics::Parameters p(params[0], params[1], params[2], params[3], params[4], params[5], params[6], params[7],
+            (uint16_t)params[8]);
+
+    return new VecEnv(type, count, p, config);
+}
+
+EXPORT void vecenv_free(VecEnv * env)
+{
+    delete env;
+}
+
+// Resets vehicles whose mask byte is nonzero, or all of them for a NULL mask
+EXPORT void vecenv_reset(VecEnv * env, const uint8_t * mask)
+{
+    env->reset(mask);
+}
+
+EXPORT void vecenv_step(VecEnv * env)
+{
+    env->step();
+}
+
+// Changes one vehicle's parameters (b, d, m, l, Ix, Iy, Iz, Jr, maxrpm)
+EXPORT void vecenv_set_parameters(VecEnv * env, uint32_t index, const double * params)
+{
+    Dynamics::Parameters p(params[0], params[1], params[2], params[3], params[4], params[5], params[6], params[7],
+            (uint16_t)params[8]);
+
+    env->setParameters(index, p);
+}
+
+EXPORT uint32_t vecenv_count(VecEnv * env)
+{
+    return env->getCount();
+}
+
+EXPORT uint32_t vecenv_motor_count(VecEnv * env)
+{
+    return env->getMotorCount();
+}
+
+EXPORT uint32_t vecenv_obs_size(VecEnv * env)
+{
+    return VecEnv::OBS_SIZE;
+}
+
+EXPORT double * vecenv_actions(VecEnv * env)
+{
+    return env->getActions();
+}
+
+EXPORT double * vecenv_obs(VecEnv * env)
+{
+    return env->getObs();
+}
+
+EXPORT double * vecenv_reward(VecEnv * env)
+{
+    return env->getReward();
+}
+
+EXPORT uint8_t * vecenv_done(VecEnv * env)
+{
+    return env->getDone();
+}
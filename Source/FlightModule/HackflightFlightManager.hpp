@@ -51,6 +51,13 @@ class FHackflightFlightManager : public FFlightManager {
         // Pos-hold (via simulated optical flow)
         hf::FlowHoldPid flowhold = hf::FlowHoldPid(0.05, 0.05);
 
+        // Sensor error models, used with -SensorNoise=<seed>
+        //                                          noise   biasWalk  bias       scale            misalignment          quantum
+        const SensorNoise::params_t gyroNoise     = {0.005,  1.0e-4,  {0,0,0},  {.002,.002,.002}, {.001,.001,.001},  0.0011};
+        const SensorNoise::params_t attitudeNoise = {0.002,  0,       {0,0,0},  {0,0,0},          {0,0,0},           0};
+        const SensorNoise::params_t locationNoise = {0.01,   0.001,   {0,0,0},  {0,0,0},          {0,0,0},           0};
+        const SensorNoise::params_t velocityNoise = {0.02,   0,       {0,0,0},  {0,0,0},          {0,0,0},           0};
+
         // Main firmware
         hf::Hackflight _hackflight;
 
@@ -67,26 +74,39 @@ class FHackflightFlightManager : public FFlightManager {
         SimSensors * _sensors = NULL;
 
         // "Motors" just store their current value
-        SimMotor * _motors = NULL;
+        SimMotor _motors;
         uint8_t    _nmotors = 0;
 
     public:
 
-        // Constructor
-        FHackflightFlightManager(hf::Mixer * mixer, Dynamics * dynamics) 
-            : FFlightManager(dynamics) 
+        /**
+         * @param mixer motor mixer
+         * @param dynamics vehicle dynamics
+         * @param joystick stick device for this vehicle, as for -Joystick=; NULL or empty for the default
+         */
+        FHackflightFlightManager(hf::Mixer * mixer, Dynamics * dynamics, const char * joystick=NULL) 
+            : FFlightManager(dynamics), _receiver(joystick), _motors(dynamics->motorCount())
         {
-            // Create simulated motors
             _nmotors = dynamics->motorCount();
-            _motors = new SimMotor(_nmotors);
 
             // Start Hackflight firmware, indicating already armed
-            _hackflight.init(&_board, &_imu, &_receiver, mixer, (hf::Motor *)_motors, true);
+            _hackflight.init(&_board, &_imu, &_receiver, mixer, (hf::Motor *)&_motors, true);
 
             // Add simulated sensor suite
             _sensors = new SimSensors(_dynamics);
             _hackflight.addSensor(_sensors);
 
+            if (_receiver.getMessage()[0]) {
+                error("STICKS: %s", _receiver.getMessage());
+            }
+
+            // Sensors report ground truth unless asked for errors
+            uint64 seed = 0;
+            if (FParse::Value(FCommandLine::Get(), TEXT("SensorNoise="), seed)) {
+                _imu.setNoise(gyroNoise, attitudeNoise, seed);
+                _sensors->setNoise(locationNoise, velocityNoise, seed);
+            }
+
 			// Add altitude-hold and position-hold PID controllers in switch position 1 or greater
 			_hackflight.addPidController(&althold, 1);
 			_hackflight.addPidController(&flowhold, 1);
@@ -96,14 +116,9 @@ class FHackflightFlightManager : public FFlightManager {
 			_hackflight.addPidController(&ratePid);
 		}
 
-        virtual ~FHackflightFlightManager(void)
-        {
-            delete _motors;
-        }
-
         virtual void getMotors(const double time, const Dynamics::state_t & state, double * motorvals) override
         {
-            uint16_t joystickError = _receiver.update();
+            uint16_t joystickError = _receiver.update(time);
 
             switch (joystickError) {
 
@@ -113,17 +128,17 @@ class FHackflightFlightManager : public FFlightManager {
 
                     _board.set(time);
 
-                    _imu.set(state.quaternion, state.angularVel);
+                    _imu.set(state.quaternion, state.angularVel, time);
 
                     // Get motor values
                     for (uint8_t i=0; i < _nmotors; ++i) {
-                        motorvals[i] = _motors->getValue(i);
+                        motorvals[i] = _motors.getValue(i);
                     }
 
                     break;
 
                 case 1:
-                    debug("*** NO JOYSTICK DETECTED ***");
+                    debug("*** NO STICK INPUT ***");
                     break;
 
                 default:
@@ -133,4 +148,9 @@ class FHackflightFlightManager : public FFlightManager {
             }
         }
 
+        virtual void getInputs(double inputs[FlightRecorder::INPUT_COUNT]) override
+        {
+            _receiver.getInputs(inputs);
+        }
+
 }; // HackflightFlightManager
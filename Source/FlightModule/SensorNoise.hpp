@@ -0,0 +1,193 @@
+/*
+   Sensor-error model for simulated sensors
+
+   Turns a ground-truth three-axis reading into what a real sensor would
+   report: misaligned axes, scale-factor error, a bias that wanders as a
+   random walk, white noise, and quantization to the sensor's resolution.
+
+   Random numbers come from Philox4x32-10, a counter-based generator: each
+   sample's numbers are a pure function of the seed, the sensor's stream
+   number and the sample count, so runs are reproducible from the seed alone
+   and no generator state has to be carried between samples.  One Philox block
+   gives four uniforms, which Box-Muller turns into four normals, so a sample's
+   three noise values take one block, and its three bias steps another.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+   */
+
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+
+class SensorNoise {
+
+    public:
+
+        typedef struct {
+
+            double noise;               // white-noise standard deviation, per sample
+            double biasWalk;            // bias random-walk standard deviation, per square-root second
+            double bias[3];             // initial bias
+            double scale[3];            // scale-factor error; zero for none
+            double misalignment[3];     // small-angle axis misalignment about x, y, z, in radians
+            double quantum;             // resolution; zero for none
+
+        } params_t;
+
+    private:
+
+        // Philox4x32-10 constants
+        static const uint32_t M0 = 0xD2511F53;
+        static const uint32_t M1 = 0xCD9E8D57;
+        static const uint32_t W0 = 0x9E3779B9;
+        static const uint32_t W1 = 0xBB67AE85;
+
+        params_t _params = {};
+
+        bool _enabled = false;
+
+        uint32_t _key[2] = {};
+        uint64_t _counter = 0;
+
+        double _bias[3] = {};
+        double _matrix[3][3] = {};
+        double _time = 0;
+
+        static void philox(const uint32_t key[2], uint64_t counter, uint32_t out[4])
+        {
+            uint32_t c[4] = {(uint32_t)counter, (uint32_t)(counter >> 32), 0, 0};
+            uint32_t k0 = key[0];
+            uint32_t k1 = key[1];
+
+            for (uint8_t round=0; round<10; ++round) {
+
+                uint64_t p0 = (uint64_t)M0 * c[0];
+                uint64_t p1 = (uint64_t)M1 * c[2];
+
+                uint32_t next[4] = {(uint32_t)(p1 >> 32) ^ c[1] ^ k0, (uint32_t)p1, (uint32_t)(p0 >> 32) ^ c[3] ^ k1, (uint32_t)p0};
+
+                c[0] = next[0];
+                c[1] = next[1];
+                c[2] = next[2];
+                c[3] = next[3];
+
+                k0 += W0;
+                k1 += W1;
+            }
+
+            out[0] = c[0];
+            out[1] = c[1];
+            out[2] = c[2];
+            out[3] = c[3];
+        }
+
+        // Four standard normals from one Philox block, by Box-Muller
+        void normals(double out[4])
+        {
+            uint32_t bits[4] = {};
+            philox(_key, _counter++, bits);
+
+            for (uint8_t k=0; k<4; k+=2) {
+
+                // Uniforms in (0,1), so the log is always finite
+                double u1 = (bits[k] + 0.5) * (1.0 / 4294967296.0);
+                double u2 = (bits[k+1] + 0.5) * (1.0 / 4294967296.0);
+
+                double r = sqrt(-2 * log(u1));
+                double theta = 2 * M_PI * u2;
+
+                out[k] = r * cos(theta);
+                out[k+1] = r * sin(theta);
+            }
+        }
+
+    public:
+
+        SensorNoise(void)
+        {
+        }
+
+        /**
+         * @param params error model
+         * @param seed shared by all of a vehicle's sensors
+         * @param stream distinguishes this sensor from others with the same seed
+         */
+        SensorNoise(const params_t & params, uint64_t seed, uint32_t stream)
+        {
+            _params = params;
+            _enabled = true;
+
+            _key[0] = (uint32_t)seed;
+            _key[1] = (uint32_t)(seed >> 32) ^ (stream * W1);
+
+            for (uint8_t j=0; j<3; ++j) {
+                _bias[j] = params.bias[j];
+            }
+
+            // Scale times small-angle rotation: (I + diag(scale)) (I + [misalignment]x)
+            const double * m = params.misalignment;
+            double rotation[3][3] = { {1, -m[2], m[1]}, {m[2], 1, -m[0]}, {-m[1], m[0], 1} };
+
+            for (uint8_t j=0; j<3; ++j) {
+                for (uint8_t k=0; k<3; ++k) {
+                    _matrix[j][k] = (1 + params.scale[j]) * rotation[j][k];
+                }
+            }
+        }
+
+        /**
+         * Computes one sample.  Passes truth through unchanged when the model was never set.
+         *
+         * @param truth ground-truth reading
+         * @param time current time in seconds, for the bias random walk
+         * @param out sensor reading
+         */
+        void apply(const double truth[3], double time, double out[3])
+        {
+            if (!_enabled) {
+                out[0] = truth[0];
+                out[1] = truth[1];
+                out[2] = truth[2];
+                return;
+            }
+
+            double dt = _counter ? time - _time : 0;
+            _time = time;
+
+            // Noise, then bias steps if the bias wanders
+            double n[8] = {};
+            normals(n);
+
+            if (_params.biasWalk > 0) {
+
+                normals(n+4);
+
+                double walk = _params.biasWalk * sqrt(dt > 0 ? dt : 0);
+
+                for (uint8_t j=0; j<3; ++j) {
+                    _bias[j] += walk * n[4+j];
+                }
+            }
+
+            for (uint8_t j=0; j<3; ++j) {
+
+                double value = _matrix[j][0]*truth[0] + _matrix[j][1]*truth[1] + _matrix[j][2]*truth[2] +
+                    _bias[j] + _params.noise * n[j];
+
+                if (_params.quantum > 0) {
+                    value = _params.quantum * floor(value / _params.quantum + 0.5);
+                }
+
+                out[j] = value;
+            }
+        }
+
+        bool isEnabled(void)
+        {
+            return _enabled;
+        }
+
+}; // class SensorNoise
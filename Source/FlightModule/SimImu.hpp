@@ -10,6 +10,8 @@
 
 #include <imu.hpp>
 
+#include "SensorNoise.hpp"
+
 class SimIMU : public hf::IMU {
 
     private:
@@ -21,6 +23,28 @@ class SimIMU : public hf::IMU {
 
         uint8_t _qcount = 0;
 
+        // Pass ground truth through until setNoise() is called
+        SensorNoise _gyroNoise;
+        SensorNoise _attitudeNoise;
+
+        // Rotates quaternion by a small angle, to simulate attitude-estimate error
+        static void perturb(double quat[4], const double angle[3])
+        {
+            double w = quat[0], x = quat[1], y = quat[2], z = quat[3];
+            double ex = angle[0] / 2, ey = angle[1] / 2, ez = angle[2] / 2;
+
+            double q[4] = { w - x*ex - y*ey - z*ez,
+                            x + w*ex + y*ez - z*ey,
+                            y + w*ey - x*ez + z*ex,
+                            z + w*ez + x*ey - y*ex };
+
+            double norm = sqrt(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+
+            for (uint8_t j=0; j<4; ++j) {
+                quat[j] = q[j] / norm;
+            }
+        }
+
     public:
 
         virtual bool getGyrometer(float & gx, float & gy, float & gz) override
@@ -48,17 +72,35 @@ class SimIMU : public hf::IMU {
             return true;
         }
 
-        void set(const double quat[4], const double gyro[3])
+        /**
+         * Adds sensor errors to the gyrometer and the attitude estimate.
+         *
+         * @param gyro gyrometer error model, in radians per second
+         * @param attitude attitude error model, in radians; only noise and bias apply
+         * @param seed random seed
+         */
+        void setNoise(const SensorNoise::params_t & gyro, const SensorNoise::params_t & attitude, uint64_t seed)
+        {
+            _gyroNoise = SensorNoise(gyro, seed, 0);
+            _attitudeNoise = SensorNoise(attitude, seed, 1);
+        }
+
+        void set(const double quat[4], const double gyro[3], double time)
         {
             // Copy in quaternion
             for (uint8_t j=0; j<4; ++j) {
                 _quat[j] = quat[j];
             }
 
-            // Copy in gyro
-            for (uint8_t j=0; j<3; ++j) {
-                _gyro[j] = gyro[j];
+            if (_attitudeNoise.isEnabled()) {
+                const double zero[3] = {};
+                double angle[3] = {};
+                _attitudeNoise.apply(zero, time, angle);
+                perturb(_quat, angle);
             }
+
+            // Copy in gyro, with any errors
+            _gyroNoise.apply(gyro, time, _gyro);
         }
 
 }; // class SimIMU
@@ -10,23 +10,19 @@
 
 #include <motor.hpp>
 
+#include "../MainModule/dynamics/Dynamics.hpp"
+
 class SimMotor : public hf::Motor {
 
     private:
 
-        float * _values = NULL;
+        float _values[Dynamics::MAX_MOTORS] = {};
 
     public:
 
         SimMotor(uint8_t count)
             : Motor(count)
         {
-            _values = new float[count];
-        }
-
-        virtual ~SimMotor()
-        {
-            delete _values;
         }
 
         float getValue(uint8_t index)
@@ -3,6 +3,10 @@
    device (joystick, game controller, R/C transmitter) as a "virtual receiver"
    for the firmware.
 
+   For runs with nobody at the sticks, the values can come instead from a
+   script (-StickScript=<file>), a flight recording (-StickRecording=<file>)
+   or UDP packets (-StickPort=<port>); see StickSource.hpp.
+
    Copyright(C) 2019 Simon D.Levy
 
    MIT License
@@ -12,7 +16,10 @@
 
 #include <receiver.hpp>
 
-#include "../joystick/Joystick.h"
+#include "StickSource.hpp"
+
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
 
 class SimReceiver : public hf::Receiver {
 
@@ -23,12 +30,15 @@ class SimReceiver : public hf::Receiver {
 		static constexpr uint8_t DEFAULT_CHANNEL_MAP[6] = { 0, 1, 2, 3, 4, 5 };
 		static constexpr float DEMAND_SCALE = 1.0f;
 
-		Joystick * _joystick;
+		StickSource * _sticks = NULL;
 
 		// Helps mock up periodic availability of new data frame (output data rate; ODR)
 		double _deltaT;
 		double _previousTime;
 
+		// Simulation time, so that scripted runs are the same every time
+		double _currentTime = 0;
+
     protected:
 
 		uint8_t getAux1State(void) 
@@ -43,23 +53,57 @@ class SimReceiver : public hf::Receiver {
 
     public:
 
-		SimReceiver(uint16_t updateFrequency=50)
+		/**
+		 * @param joystick this vehicle's device, overriding -Joystick=; NULL or empty for the default
+		 * @param updateFrequency new frames per second
+		 */
+		SimReceiver(const char * joystick=NULL, uint16_t updateFrequency=50)
 			: Receiver(DEFAULT_CHANNEL_MAP, DEMAND_SCALE)
 		{
-			_joystick = new Joystick();
+			FString value;
+
+			if (FParse::Value(FCommandLine::Get(), TEXT("StickScript="), value)) {
+				_sticks = new ScriptSource(TCHAR_TO_ANSI(*value));
+			}
+
+			else if (FParse::Value(FCommandLine::Get(), TEXT("StickRecording="), value)) {
+				_sticks = new RecordingSource(TCHAR_TO_ANSI(*value));
+			}
+
+			else if (FParse::Value(FCommandLine::Get(), TEXT("StickPort="), value)) {
+				_sticks = new SocketSource((short)FCString::Atoi(*value));
+			}
+
+			// Each vehicle can have its own device, so that several pilots can fly at once
+			else if (joystick && *joystick) {
+				_sticks = new JoystickSource(joystick);
+			}
+
+			// Pick a device with -Joystick=<device>, e.g. -Joystick=evdev:1 for a second pilot's controller
+			else if (FParse::Value(FCommandLine::Get(), TEXT("Joystick="), value)) {
+				_sticks = new JoystickSource(TCHAR_TO_ANSI(*value));
+			}
+
+			else {
+				_sticks = new JoystickSource();
+			}
 
 			_deltaT = 1./updateFrequency;
 			_previousTime = 0;
 		}
 
+		~SimReceiver(void)
+		{
+			delete _sticks;
+		}
+
 		void begin(void)
 		{
 		}
 
 		bool gotNewFrame(void)
 		{
-			// Get a high-fidelity current time value from the OS
-			double currentTime = FPlatformTime::Seconds();
+			double currentTime = _currentTime;
 
 			if (currentTime-_previousTime > _deltaT) {
 				_previousTime = currentTime;
@@ -74,10 +118,26 @@ class SimReceiver : public hf::Receiver {
 		{
 		}
 
-		uint16_t update(void)
+		uint16_t update(double time)
 		{
-			// Joystick::poll() returns zero (okay) or a postive value (error)
-			return _joystick->poll(rawvals);
+			_currentTime = time;
+
+			// StickSource::read() returns zero (okay) or a postive value (error)
+			return _sticks->read(time, rawvals);
+		}
+
+		// Why the stick source couldn't be opened, if it couldn't
+		const char * getMessage(void)
+		{
+			return _sticks->getMessage();
+		}
+
+		// Latest raw stick values, for the flight recorder
+		void getInputs(double inputs[6])
+		{
+			for (uint8_t k=0; k<6; ++k) {
+				inputs[k] = rawvals[k];
+			}
 		}
 
 }; // class SimReceiver
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "../MainModule/dynamics/Dynamics.hpp"
+#include "SensorNoise.hpp"
 
 #include <sensor.hpp>
 #include <datatypes.hpp>
@@ -29,6 +30,10 @@ class SimSensors : public hf::Sensor {
             body[2] = bi[2];
         }
 
+        // Pass ground truth through until setNoise() is called
+        SensorNoise _locationNoise;
+        SensorNoise _velocityNoise;
+
     protected:
 
         // We do all dynamcics => state conversion; subclasses just return sensor values
@@ -42,15 +47,18 @@ class SimSensors : public hf::Sensor {
 
         virtual void modifyState(hf::state_t & vehicleState, float time)
         {
-            (void)time;
-
             // Get vehicle state from dynamics
             Dynamics::state_t dynamicsState = _dynamics->getState();
 
+            double location[3] = {};
+            double inertialVel[3] = {};
+            _locationNoise.apply(dynamicsState.pose.location, time, location);
+            _velocityNoise.apply(dynamicsState.inertialVel, time, inertialVel);
+
             // Use vehicle state to modify Hackflight state values
             for (uint8_t k=0; k<3; ++k) {
-                vehicleState.location[k]    = dynamicsState.pose.location[k]; 
-                vehicleState.inertialVel[k] = dynamicsState.inertialVel[k];
+                vehicleState.location[k]    = location[k]; 
+                vehicleState.inertialVel[k] = inertialVel[k];
             }
 
             // Negate for NED => ENU conversion
@@ -68,4 +76,17 @@ class SimSensors : public hf::Sensor {
             _dynamics = dynamics;
         }
 
+        /**
+         * Adds sensor errors to location and inertial velocity (and thus to simulated optical flow).
+         *
+         * @param location location error model, in meters
+         * @param velocity velocity error model, in meters per second
+         * @param seed random seed
+         */
+        void setNoise(const SensorNoise::params_t & location, const SensorNoise::params_t & velocity, uint64_t seed)
+        {
+            _locationNoise = SensorNoise(location, seed, 2);
+            _velocityNoise = SensorNoise(velocity, seed, 3);
+        }
+
 }; // class SimSensor
@@ -0,0 +1,367 @@
+/*
+   Sources of stick values for SimReceiver
+
+   A joystick is one source.  For runs with nobody at the sticks there are
+   three more, all returning the same six values and status codes as
+   Joystick::poll():
+
+   ScriptSource      piecewise-linear stick trajectories in simulation time,
+                     from a text file
+   RecordingSource   the stick values saved by the flight recorder during an
+                     earlier session, played back at their recorded times
+   SocketSource      STICKS packets (see WireProtocol.hpp) from another
+                     program; the latest packet wins
+
+   Scripts and recordings are read into memory when the source is created.
+   Each lookup resumes from where the last one left off, so while time moves
+   forward, reading the sticks takes constant time per step.
+
+   Copyright(C) 2020 Simon D.Levy
+
+   MIT License
+   */
+
+#pragma once
+
+#include "joystick/Joystick.h"
+
+#include "../MainModule/FlightRecorder.hpp"
+#include "../../Extras/sockets/StickReceiver.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+class StickSource {
+
+    protected:
+
+        char _message[200] = {};
+
+    public:
+
+        static const uint8_t STICK_COUNT = 6; // throttle, roll, pitch, yaw, aux1, aux2
+
+        virtual ~StickSource(void)
+        {
+        }
+
+        /**
+         * @param time simulation time in seconds
+         * @param sticks stick values (output)
+         * @return 0 for okay, 1 for no input yet, otherwise a source-specific error
+         */
+        virtual uint16_t read(double time, float sticks[STICK_COUNT]) = 0;
+
+        // Why the source couldn't be opened, if it couldn't
+        const char * getMessage(void)
+        {
+            return _message;
+        }
+
+}; // class StickSource
+
+class JoystickSource : public StickSource {
+
+    private:
+
+        Joystick _joystick;
+
+    public:
+
+        JoystickSource(const char * devname="/dev/input/js0")
+            : _joystick(devname)
+        {
+        }
+
+        virtual uint16_t read(double time, float sticks[STICK_COUNT]) override
+        {
+            return _joystick.poll(sticks);
+        }
+
+}; // class JoystickSource
+
+// Stick values at increasing times, held in memory
+class TimelineSource : public StickSource {
+
+    protected:
+
+        std::vector<double> _times;
+        std::vector<float> _values; // STICK_COUNT per time
+
+        size_t _cursor = 0;
+
+        // Index of the last time no later than the given one, or zero if there is none
+        size_t seek(double time)
+        {
+            // Time went backwards (a restart); search again from the beginning
+            if (time < _times[_cursor]) {
+                _cursor = 0;
+            }
+
+            while (_cursor + 1 < _times.size() && _times[_cursor + 1] <= time) {
+                _cursor++;
+            }
+
+            return _cursor;
+        }
+
+    public:
+
+        bool isOpen(void)
+        {
+            return !_times.empty();
+        }
+
+}; // class TimelineSource
+
+class ScriptSource : public TimelineSource {
+
+    public:
+
+        /**
+         * Reads a script: one keyframe per line, giving a time in seconds then
+         * throttle, roll, pitch and yaw, and optionally aux1 and aux2, separated
+         * by spaces or commas.  Sticks move in straight lines between keyframes;
+         * aux switches flip at them, and keep their last values when left out
+         * (starting low).  Everything after a # is a comment.
+         *
+         * @param path script file
+         */
+        ScriptSource(const char * path)
+        {
+            FILE * fp = fopen(path, "r");
+
+            if (!fp) {
+                snprintf(_message, sizeof(_message), "fopen(%s) failed", path);
+                return;
+            }
+
+            float aux[2] = {-1, -1};
+
+            char line[256] = {};
+
+            for (uint32_t lineno=1; fgets(line, sizeof(line), fp); ++lineno) {
+
+                char * comment = strchr(line, '#');
+                if (comment) {
+                    *comment = 0;
+                }
+
+                for (char * c=line; *c; ++c) {
+                    if (*c == ',') *c = ' ';
+                }
+
+                double time = 0;
+                float v[STICK_COUNT] = {};
+
+                int count = sscanf(line, "%lf %f %f %f %f %f %f", &time, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+
+                // Blank line
+                if (count <= 0) continue;
+
+                if (count < 5) {
+                    snprintf(_message, sizeof(_message), "%.150s line %u: need a time and four sticks", path, lineno);
+                    break;
+                }
+
+                if (!_times.empty() && time < _times.back()) {
+                    snprintf(_message, sizeof(_message), "%.150s line %u: time goes backwards", path, lineno);
+                    break;
+                }
+
+                // Missing aux values keep the ones before
+                for (uint8_t k=0; k<2; ++k) {
+                    if (count > 5 + k) {
+                        aux[k] = v[4+k];
+                    }
+                    v[4+k] = aux[k];
+                }
+
+                _times.push_back(time);
+                _values.insert(_values.end(), v, v + STICK_COUNT);
+            }
+
+            fclose(fp);
+
+            if (_message[0]) {
+                _times.clear();
+                _values.clear();
+            }
+
+            else if (_times.empty()) {
+                snprintf(_message, sizeof(_message), "%.150s has no keyframes", path);
+            }
+        }
+
+        virtual uint16_t read(double time, float sticks[STICK_COUNT]) override
+        {
+            if (_times.empty()) return 1;
+
+            size_t k = seek(time);
+
+            const float * a = &_values[k * STICK_COUNT];
+
+            // Before the first keyframe or after the last, hold still
+            if (time <= _times[k] || k + 1 == _times.size()) {
+                memcpy(sticks, a, STICK_COUNT * sizeof(float));
+                return 0;
+            }
+
+            const float * b = &_values[(k+1) * STICK_COUNT];
+
+            float t = (float)((time - _times[k]) / (_times[k+1] - _times[k]));
+
+            for (uint8_t j=0; j<4; ++j) {
+                sticks[j] = a[j] + t * (b[j] - a[j]);
+            }
+
+            sticks[4] = a[4];
+            sticks[5] = a[5];
+
+            return 0;
+        }
+
+}; // class ScriptSource
+
+class RecordingSource : public TimelineSource {
+
+    private:
+
+        typedef struct {
+
+            uint64_t record;
+            double time;
+            float sticks[STICK_COUNT];
+
+        } entry_t;
+
+    public:
+
+        /**
+         * Reads the stick values from a flight-recorder file (-FlightRecorder=<file>).
+         * Works on files left behind by a crash too, since it goes by the
+         * records themselves rather than the footers.
+         *
+         * @param path recording file
+         */
+        RecordingSource(const char * path)
+        {
+            FILE * fp = fopen(path, "rb");
+
+            if (!fp) {
+                snprintf(_message, sizeof(_message), "fopen(%s) failed", path);
+                return;
+            }
+
+            FlightRecorder::header_t header = {};
+
+            if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != FlightRecorder::MAGIC ||
+                    header.version != FlightRecorder::VERSION || header.inputCount < STICK_COUNT ||
+                    fseek(fp, FlightRecorder::HEADER_SIZE, SEEK_SET) != 0) {
+                snprintf(_message, sizeof(_message), "%.150s is not a flight recording", path);
+                fclose(fp);
+                return;
+            }
+
+            uint32_t inputOffset = (uint32_t)(sizeof(uint64_t) + (1 + header.stateSize + header.motorCount) * sizeof(double));
+
+            std::vector<uint8_t> buffer(header.recordSize);
+
+            std::vector<entry_t> entries;
+
+            // Slots never written are zeros, which no record's stamp is
+            for (uint32_t slot=0; slot<header.capacity && fread(&buffer[0], header.recordSize, 1, fp) == 1; ++slot) {
+
+                entry_t entry = {};
+
+                uint64_t stamp = 0;
+                memcpy(&stamp, &buffer[0], sizeof(uint64_t));
+                memcpy(&entry.time, &buffer[sizeof(uint64_t)], sizeof(double));
+
+                if (stamp == 0) continue;
+
+                entry.record = stamp - 1;
+
+                if ((entry.record & (header.capacity - 1)) != slot) continue;
+
+                for (uint8_t k=0; k<STICK_COUNT; ++k) {
+                    double value = 0;
+                    memcpy(&value, &buffer[inputOffset + k*sizeof(double)], sizeof(double));
+                    entry.sticks[k] = (float)value;
+                }
+
+                entries.push_back(entry);
+            }
+
+            fclose(fp);
+
+            // Once the ring has wrapped, the oldest record is the one after the newest
+            std::rotate(entries.begin(), std::min_element(entries.begin(), entries.end(),
+                        [](const entry_t & a, const entry_t & b) { return a.record < b.record; }), entries.end());
+
+            _times.reserve(entries.size());
+            _values.reserve(entries.size() * STICK_COUNT);
+
+            for (size_t k=0; k<entries.size(); ++k) {
+                _times.push_back(entries[k].time);
+                _values.insert(_values.end(), entries[k].sticks, entries[k].sticks + STICK_COUNT);
+            }
+
+            if (_times.empty()) {
+                snprintf(_message, sizeof(_message), "%.150s has no records", path);
+            }
+        }
+
+        // The controller saw each recorded value until the next, so that's how they play back
+        virtual uint16_t read(double time, float sticks[STICK_COUNT]) override
+        {
+            if (_times.empty()) return 1;
+
+            memcpy(sticks, &_values[seek(time) * STICK_COUNT], STICK_COUNT * sizeof(float));
+
+            return 0;
+        }
+
+}; // class RecordingSource
+
+class SocketSource : public StickSource {
+
+    private:
+
+        StickReceiver _receiver;
+
+    public:
+
+        /**
+         * @param port port on which to receive STICKS packets
+         */
+        SocketSource(const short port)
+            : _receiver(port)
+        {
+            if (!_receiver.isOpen()) {
+                snprintf(_message, sizeof(_message), "port %d: %.150s", port, _receiver.getMessage());
+            }
+        }
+
+        virtual uint16_t read(double time, float sticks[STICK_COUNT]) override
+        {
+            double values[STICK_COUNT] = {};
+
+            if (!_receiver.poll(values)) return 1;
+
+            for (uint8_t k=0; k<STICK_COUNT; ++k) {
+                sticks[k] = (float)values[k];
+            }
+
+            return 0;
+        }
+
+        bool isOpen(void)
+        {
+            return _receiver.isOpen();
+        }
+
+}; // class SocketSource
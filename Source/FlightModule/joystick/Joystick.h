@@ -12,6 +12,11 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#ifdef __linux__
+#include <atomic>
+#include <thread>
+#endif
+
 class Joystick {
 
 private:
@@ -38,6 +43,75 @@ private:
 
 	bool _isGameController = false;
 
+	// Kernel timestamp of the newest input behind the last poll()
+	double _eventTime = 0;
+
+	// Aux switch state for game controllers, toggled by buttons
+	float _aux1 = 0;
+	float _aux2 = -1;
+	bool _down = false;
+
+#ifdef __linux__
+
+	// Latest device state, as published by the input thread
+	typedef struct {
+
+		float axes[6];
+		uint8_t buttons;        // bit per button held down
+		uint16_t status;        // as returned by pollProduct()
+		uint16_t productId;     // can change as devices come and go
+		bool isGameController;
+		double eventTime;       // CLOCK_MONOTONIC seconds
+
+	} snapshot_t;
+
+	// Triple buffer: the input thread fills the back slot and swaps it with the
+	// middle one; the flight loop swaps the middle slot for its front one when
+	// the FRESH bit says there is something new.  Neither side ever waits.
+	static const uint8_t FRESH = 0x04;
+
+	snapshot_t _snapshots[3] = {};
+	std::atomic<uint8_t> _middle;
+	uint8_t _back = 1;
+	uint8_t _front = 2;
+
+	std::thread * _thread = NULL;
+	std::atomic<bool> _running;
+
+	char _productName[128] = {};
+
+	// Device axis number => AX_ value
+	const uint8_t * _axisMap = NULL;
+
+	// With evdev, which joystick to use: a device path, or the index of a joystick among all of them
+	bool _evdev = false;
+	char _evdevPath[64] = {};
+	int _evdevIndex = 0;
+
+	// Sets product ID, axis map and game-controller flag from vendor and product IDs, or failing those, the name
+	static void identify(uint16_t vendor, uint16_t product, const char * name,
+			uint16_t & productId, const uint8_t * & axisMap, bool & isGameController);
+
+	void run(void);
+
+	void runEvdev(void);
+
+	void publish(const snapshot_t & snapshot)
+	{
+		_snapshots[_back] = snapshot;
+		_back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & 0x03;
+	}
+
+	const snapshot_t & latest(void)
+	{
+		if (_middle.load(std::memory_order_relaxed) & FRESH) {
+			_front = _middle.exchange(_front, std::memory_order_acq_rel) & 0x03;
+		}
+		return _snapshots[_front];
+	}
+
+#endif
+
 protected:
 
     enum {
@@ -53,11 +127,6 @@ protected:
 
     void buttonsToAxes(uint8_t buttons, uint8_t top, uint8_t rgt, uint8_t bot, uint8_t lft, float * axes)
     {
-        static float _aux1 = 0;
-        static float _aux2 = -1;
-
-        static bool _down;
-
         if (buttons) {
 
             if (!_down) {
@@ -89,7 +158,19 @@ protected:
 
 public:
 
-    Joystick(const char * devname = "/dev/input/js0"); // ignored by Windows
+    /**
+     * @param devname ignored by Windows.  On Linux, a joystick device (/dev/input/js0), an evdev device
+     * (/dev/input/event5), or evdev:N for the Nth joystick of any plugged in, picked up whenever it appears
+     */
+    Joystick(const char * devname = "/dev/input/js0");
+
+    ~Joystick(void);
+
+    // CLOCK_MONOTONIC time in seconds of the newest input behind the last poll(), for measuring latency (Linux)
+    double getEventTime(void)
+    {
+        return _eventTime;
+    }
 
     uint16_t poll(float axes[6])
     {
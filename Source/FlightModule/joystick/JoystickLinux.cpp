@@ -1,6 +1,17 @@
 /*
  * JoystickLinux.cpp: Linux implementation of joystick/gamepad support for MulticopterSim
  *
+ * A thread per joystick blocks until the device has events, drains all of
+ * them, and publishes the resulting axes and buttons; pollProduct() just
+ * picks up the latest, with no system calls.
+ *
+ * Two backends: the joystick API (/dev/input/jsN), and evdev
+ * (/dev/input/eventN), which identifies devices by vendor and product ID,
+ * timestamps events with the monotonic clock, and watches /dev/input with
+ * inotify so that devices can come and go.  Evdev axes and buttons are
+ * numbered the way the joystick driver numbers them, so one set of axis maps
+ * serves both.
+ *
  * Copyright (C) 2018 Simon D. Levy
  *
  * MIT License
@@ -12,9 +23,17 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/ioctl.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <linux/joystick.h>
+#include <linux/input.h>
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <stdio.h>
 
@@ -22,50 +41,138 @@
 #define debug printf
 #endif
 
-static char _productName[128];
+// How often the input thread wakes with no events, to see whether it should stop
+static const int POLL_TIMEOUT_MSEC = 100;
+
+void Joystick::identify(uint16_t vendor, uint16_t product, const char * name,
+        uint16_t & productId, const uint8_t * & axisMap, bool & isGameController)
+{
+    // ------------------------------- 0       1       2       3       4       5       6       7 -----
+    static const uint8_t F310_MAP[8]      = {AX_YAW, AX_THR, AX_ROL, AX_PIT, AX_NIL, AX_NIL, AX_NIL, AX_NIL};
+    static const uint8_t SPEKTRUM_MAP[8]  = {AX_YAW, AX_THR, AX_ROL, AX_PIT, AX_AU2, AX_NIL, AX_AU1, AX_NIL};
+    static const uint8_t XBOX360_MAP[8]   = {AX_YAW, AX_THR, AX_NIL, AX_ROL, AX_PIT, AX_NIL, AX_NIL, AX_NIL};
+    static const uint8_t INTERLINK_MAP[8] = {AX_ROL, AX_PIT, AX_THR, AX_NIL, AX_YAW, AX_AU1, AX_NIL, AX_NIL};
+    static const uint8_t PS4_MAP[8]       = {AX_YAW, AX_THR, AX_ROL, AX_NIL, AX_NIL, AX_PIT, AX_NIL, AX_NIL};
+
+    typedef struct {
+
+        uint16_t vendor;        // zero for any
+        uint16_t product;       // zero to match by name only
+        const char * name;      // for the joystick API, which doesn't give IDs
+        uint16_t productId;
+        const uint8_t * axisMap;
+        bool isGameController;
+
+    } device_t;
+
+    static const device_t DEVICES[] = {
+
+        {0x0483, PRODUCT_TARANIS_X9D,      "Taranis",                       PRODUCT_TARANIS_X9D,      NULL,          false},
+        {0x0483, PRODUCT_TARANIS_QX7,      NULL,                            PRODUCT_TARANIS_QX7,      NULL,          false},
+        {0x0000, 0x0000,                   "DeviationTx Deviation GamePad", PRODUCT_TARANIS_X9D,      NULL,          false},
+        {0x0000, PRODUCT_SPEKTRUM,         "Horizon Hobby SPEKTRUM",        PRODUCT_SPEKTRUM,         SPEKTRUM_MAP,  false},
+        {0x0000, PRODUCT_INTERLINK,        "GREAT PLANES InterLink Elite",  PRODUCT_INTERLINK,        INTERLINK_MAP, false},
+        {0x046d, PRODUCT_EXTREMEPRO3D,     "Extreme 3D",                    PRODUCT_EXTREMEPRO3D,     NULL,          true},
+        {0x0000, PRODUCT_XBOX360_CLONE,    "Generic X-Box pad",             PRODUCT_XBOX360_CLONE,    NULL,          true},
+        {0x046d, PRODUCT_F310,             "Logitech Logitech Dual Action", PRODUCT_F310,             F310_MAP,      true},
+        {0x045e, PRODUCT_XBOX360,          "Xbox 360 Wireless Receiver",    PRODUCT_XBOX360,          XBOX360_MAP,   true},
+        {0x045e, PRODUCT_XBOX360_WIRELESS, NULL,                            PRODUCT_XBOX360_WIRELESS, XBOX360_MAP,   true},
+        {0x045e, PRODUCT_XBOX360_CLONE2,   "Microsoft X-Box 360 pad",       PRODUCT_XBOX360,          XBOX360_MAP,   true},
+        {0x045e, PRODUCT_XBOX_ONE,         NULL,                            PRODUCT_XBOX_ONE,         XBOX360_MAP,   true},
+        {0x054c, PRODUCT_PS4,              NULL,                            PRODUCT_PS4,              PS4_MAP,       true},
+    };
+
+    static const uint8_t COUNT = sizeof(DEVICES) / sizeof(device_t);
+
+    const device_t * device = NULL;
+
+    // IDs first, then names
+    for (uint8_t k=0; k<COUNT && !device && product; ++k) {
+        if (DEVICES[k].product == product && (!DEVICES[k].vendor || DEVICES[k].vendor == vendor)) {
+            device = &DEVICES[k];
+        }
+    }
+
+    for (uint8_t k=0; k<COUNT && !device; ++k) {
+        if (DEVICES[k].name && strstr(name, DEVICES[k].name)) {
+            device = &DEVICES[k];
+        }
+    }
+
+    productId = device ? device->productId : product;
+    axisMap = device ? device->axisMap : NULL;
+    isGameController = device ? device->isGameController : false;
+}
 
-Joystick::Joystick(const char * devname) 
+Joystick::Joystick(const char * devname)
 {
+    _middle = 0;
+    _running = false;
+
+    // Aux switches start low, even before the first event
+    for (uint8_t k=0; k<3; ++k) {
+        _snapshots[k].axes[AX_AU1] = -1;
+        _snapshots[k].axes[AX_AU2] = -1;
+    }
+
+    if (!strncmp(devname, "evdev", 5) || !strncmp(devname, "/dev/input/event", 16)) {
+
+        _evdev = true;
+
+        if (devname[0] == '/') {
+            strncpy(_evdevPath, devname, sizeof(_evdevPath)-1);
+        }
+        else if (devname[5] == ':') {
+            _evdevIndex = atoi(&devname[6]);
+        }
+
+        // Missing until the input thread finds it
+        for (uint8_t k=0; k<3; ++k) {
+            _snapshots[k].status = 1;
+        }
+
+        _running = true;
+
+        _thread = new std::thread(&Joystick::runEvdev, this);
+
+        return;
+    }
+
     _joystickId = open(devname, O_RDONLY);
 
     if (_joystickId <= 0) return;
 
     fcntl(_joystickId, F_SETFL, O_NONBLOCK);
 
-    *_productName = 0;
-
     if (ioctl(_joystickId, JSIOCGNAME(sizeof(_productName)), _productName) < 0) {
         return;
     }
 
-    if (strstr(_productName, "Taranis") || strstr(_productName, "DeviationTx Deviation GamePad")) {
-        _productId = PRODUCT_TARANIS;
-    }
-    else if (strstr(_productName, "Horizon Hobby SPEKTRUM")) {
-        _productId = PRODUCT_SPEKTRUM;
-    }
-    else if (strstr(_productName, "GREAT PLANES InterLink Elite")) {
-        _productId = PRODUCT_INTERLINK;
-    }
-    else if (strstr(_productName, "Extreme 3D")) {
-        _productId = PRODUCT_EXTREMEPRO3D;
-        _isGameController = true;
-    }
-    else if (strstr(_productName, "Generic X-Box pad")) {
-        _productId = PRODUCT_XBOX360_CLONE;
-        _isGameController = true;
-    }
-    else if (strstr(_productName, "Logitech Logitech Dual Action")) {
-        _productId = PRODUCT_F310;
-        _isGameController = true;
+    identify(0, 0, _productName, _productId, _axisMap, _isGameController);
+
+    // Unrecognized devices are reported by pollProduct(); nothing to read
+    if (!_axisMap) return;
+
+    for (uint8_t k=0; k<3; ++k) {
+        _snapshots[k].productId = _productId;
+        _snapshots[k].isGameController = _isGameController;
     }
-    else if (strstr(_productName, "Xbox 360 Wireless Receiver")) {
-        _productId = PRODUCT_XBOX360;
-        _isGameController = true;
+
+    _running = true;
+
+    _thread = new std::thread(&Joystick::run, this);
+}
+
+Joystick::~Joystick(void)
+{
+    if (_thread) {
+        _running = false;
+        _thread->join();
+        delete _thread;
     }
-    else if (strstr(_productName, "Microsoft X-Box 360 pad")) {
-        _productId = PRODUCT_XBOX360;
-        _isGameController = true;
+
+    if (_joystickId > 0) {
+        close(_joystickId);
     }
 }
 
@@ -89,77 +196,459 @@ static void getAuxInterlink(float * axes, uint8_t number, uint8_t value, uint8_t
     }
 }
 
-uint16_t Joystick::pollProduct(float axes[6], uint8_t & buttons)
+static double monotonicSeconds(void)
 {
-    // ------------------------------- 0       1       2       3       4       5       6       7 -----
-    static uint8_t F310_MAP[8]      = {AX_YAW, AX_THR, AX_ROL, AX_PIT, AX_NIL, AX_NIL, AX_NIL, AX_NIL};
-    static uint8_t SPEKTRUM_MAP[8]  = {AX_YAW, AX_THR, AX_ROL, AX_PIT, AX_AU2, AX_NIL, AX_AU1, AX_NIL};
-    static uint8_t XBOX360_MAP[8]   = {AX_YAW, AX_THR, AX_NIL, AX_ROL, AX_PIT, AX_NIL, AX_NIL, AX_NIL};
-    static uint8_t INTERLINK_MAP[8] = {AX_ROL, AX_PIT, AX_THR, AX_NIL, AX_YAW, AX_AU1, AX_NIL, AX_NIL};
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
 
-    if (_joystickId <= 0) return 0xFFFF;
+// Input thread: applies every pending event, then publishes the result
+void Joystick::run(void)
+{
+    snapshot_t snapshot = _snapshots[_back];
 
-    struct js_event js;
+    struct pollfd pfd = {};
+    pfd.fd = _joystickId;
+    pfd.events = POLLIN;
 
-    read(_joystickId, &js, sizeof(struct js_event));
+    while (_running) {
 
-    if (js.type & JS_EVENT_INIT) return 0;
+        if (::poll(&pfd, 1, POLL_TIMEOUT_MSEC) <= 0) continue;
 
-    uint8_t * axisMap = NULL;
+        // Unplugged
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            snapshot.status = 0xFFFF;
+            publish(snapshot);
+            break;
+        }
+
+        struct js_event events[64];
+
+        ssize_t size = 0;
+
+        while ((size = read(_joystickId, events, sizeof(events))) > 0) {
+
+            for (uint32_t k=0; k<size/sizeof(struct js_event); ++k) {
+
+                const struct js_event & js = events[k];
+
+                switch (js.type & ~JS_EVENT_INIT) {
+
+                    // Initial events give the starting stick positions
+                    case JS_EVENT_AXIS:
+                        if (js.number < 8 && _axisMap[js.number] != AX_NIL) {
+                            snapshot.axes[_axisMap[js.number]] = js.value / 32768.f;
+                        }
+                        break;
+
+                    case JS_EVENT_BUTTON:
+                        if (js.type & JS_EVENT_INIT) break;
+                        if (_productId == PRODUCT_INTERLINK)  {
+                            getAuxInterlink(snapshot.axes, js.number, js.value, AX_AU1, AX_AU2, AUX1_MID);
+                        }
+                        else if (js.number < 8) {
+                            if (js.value) {
+                                snapshot.buttons |= 1 << js.number;
+                            }
+                            else {
+                                snapshot.buttons &= ~(1 << js.number);
+                            }
+                        }
+                        break;
+                }
+            }
+        }
 
-    switch (_productId) {
+        // The joystick API's timestamps aren't on the monotonic clock; the time we read them is the next best thing
+        snapshot.eventTime = monotonicSeconds();
 
-        case PRODUCT_F310:
-            axisMap = F310_MAP;
-            break;
+        publish(snapshot);
+    }
+}
 
-        case PRODUCT_SPEKTRUM:
-            axisMap = SPEKTRUM_MAP;
-            break;
+// An open evdev device, with its axes and buttons numbered as the joystick API would number them
+typedef struct {
 
-        case PRODUCT_XBOX360:
-            axisMap = XBOX360_MAP;
-            break;
+    int fd;
 
-        case PRODUCT_INTERLINK:
-            axisMap = INTERLINK_MAP;
-            break;
+    uint16_t productId;
+    const uint8_t * axisMap;
 
-        default:
-            debug("JOYSTICK '%s' NOT RECOGNIZED\n", _productName);
-            return 0xFFFF; // dummy value
+    uint8_t absNumber[ABS_CNT];     // 0xFF for none
+    uint8_t keyNumber[KEY_CNT];
+    int32_t absMin[ABS_CNT];
+    int32_t absMax[ABS_CNT];
+
+} evdev_t;
+
+static const uint8_t NO_NUMBER = 0xFF;
+
+static bool testBit(const uint8_t * bits, uint32_t k)
+{
+    return bits[k/8] & (1 << (k%8));
+}
+
+// Same test the joystick driver uses to decide whether a device is a joystick
+static bool isJoystick(int fd)
+{
+    uint8_t evbits[(EV_CNT+7)/8] = {};
+    uint8_t absbits[(ABS_CNT+7)/8] = {};
+    uint8_t keybits[(KEY_CNT+7)/8] = {};
+
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(evbits)), evbits) < 0) return false;
+
+    if (!testBit(evbits, EV_ABS) || !testBit(evbits, EV_KEY)) return false;
+
+    ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits);
+    ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits);
+
+    // Not touchpads or tablets
+    if (testBit(keybits, BTN_TOUCH)) return false;
+
+    if (!testBit(absbits, ABS_X) && !testBit(absbits, ABS_WHEEL) && !testBit(absbits, ABS_THROTTLE)) return false;
+
+    for (uint32_t k=BTN_JOYSTICK; k<BTN_DIGI; ++k) {
+        if (testBit(keybits, k)) return true;
     }
 
-    static float _axes[6];
+    return testBit(keybits, BTN_TRIGGER_HAPPY);
+}
+
+static int eventNumber(const struct dirent * entry)
+{
+    return atoi(&entry->d_name[5]);
+}
+
+static int isEventDevice(const struct dirent * entry)
+{
+    return !strncmp(entry->d_name, "event", 5);
+}
+
+static int compareEventDevices(const struct dirent ** a, const struct dirent ** b)
+{
+    return eventNumber(*a) - eventNumber(*b);
+}
 
-    // Initalize aux switches
-    if (!_axes[AX_AU1]) {
-        _axes[AX_AU1] = -1;
-        _axes[AX_AU2] = -1;
+// Opens the device at the given path, or the index'th joystick in /dev/input; returns file descriptor or -1
+static int openEvdev(const char * path, int index)
+{
+    if (path[0]) {
+        return open(path, O_RDONLY | O_NONBLOCK);
     }
 
-    switch (js.type) {
+    struct dirent ** entries = NULL;
+    int count = scandir("/dev/input", &entries, isEventDevice, compareEventDevices);
 
-        case JS_EVENT_AXIS: 
-            _axes[axisMap[js.number]] = js.value / 32768.f;
-            break;
+    int fd = -1;
+
+    for (int k=0; k<count; ++k) {
 
-        case JS_EVENT_BUTTON:
-            if (_productId == PRODUCT_INTERLINK)  {
-                getAuxInterlink(_axes, js.number, js.value, AX_AU1, AX_AU2, AUX1_MID);
+        if (fd < 0) {
+
+            char devpath[300] = {};
+            snprintf(devpath, sizeof(devpath), "/dev/input/%s", entries[k]->d_name);
+
+            int candidate = open(devpath, O_RDONLY | O_NONBLOCK);
+
+            if (candidate >= 0 && isJoystick(candidate) && index-- == 0) {
+                fd = candidate;
             }
-            else {
-                buttons = js.value ? 1 << js.number : 0; // for Windows compatibility
+            else if (candidate >= 0) {
+                close(candidate);
             }
-            break;
+        }
+
+        free(entries[k]);
+    }
+
+    free(entries);
+
+    return fd;
+}
+
+static float normalize(const evdev_t & dev, uint16_t code, int32_t value)
+{
+    int32_t range = dev.absMax[code] - dev.absMin[code];
+
+    return range ? 2.f * (value - dev.absMin[code]) / range - 1 : 0;
+}
+
+// Reads current axis and button states, as at startup or after the kernel has dropped events
+static void syncEvdev(const evdev_t & dev, float * axes, uint8_t & buttons, bool readButtons)
+{
+    for (uint16_t code=0; code<ABS_CNT; ++code) {
+
+        uint8_t number = dev.absNumber[code];
+
+        // Map entries past the six axes are unused
+        if (number < 8 && dev.axisMap[number] < 6) {
+
+            struct input_absinfo info = {};
+
+            if (ioctl(dev.fd, EVIOCGABS(code), &info) >= 0) {
+                axes[dev.axisMap[number]] = normalize(dev, code, info.value);
+            }
+        }
+    }
+
+    if (!readButtons) return;
+
+    uint8_t keys[(KEY_CNT+7)/8] = {};
+
+    if (ioctl(dev.fd, EVIOCGKEY(sizeof(keys)), keys) < 0) return;
+
+    buttons = 0;
+
+    for (uint16_t code=0; code<KEY_CNT; ++code) {
+        if (dev.keyNumber[code] < 8 && testBit(keys, code)) {
+            buttons |= 1 << dev.keyNumber[code];
+        }
+    }
+}
+
+// Evdev input thread: finds the device, watches for it to come and go, and publishes its state
+void Joystick::runEvdev(void)
+{
+    snapshot_t snapshot = _snapshots[_back];
+
+    evdev_t dev = {};
+    dev.fd = -1;
+
+    bool dropped = false;
+
+    int watch = inotify_init1(IN_NONBLOCK);
+
+    if (watch >= 0 && inotify_add_watch(watch, "/dev/input", IN_CREATE | IN_ATTRIB | IN_DELETE) < 0) {
+        close(watch);
+        watch = -1;
     }
 
+    bool rescan = true;
+
+    while (_running) {
+
+        // Without inotify, look for the device whenever we wake up
+        if (dev.fd < 0 && (rescan || watch < 0)) {
+
+            rescan = false;
+
+            dev.fd = openEvdev(_evdevPath, _evdevIndex);
+
+            snapshot.status = 1;
+
+            if (dev.fd >= 0) {
+
+                struct input_id id = {};
+                char name[128] = {};
+                ioctl(dev.fd, EVIOCGID, &id);
+                ioctl(dev.fd, EVIOCGNAME(sizeof(name)), name);
+
+                identify(id.vendor, id.product, name, dev.productId, dev.axisMap, snapshot.isGameController);
+
+                snapshot.productId = dev.productId;
+
+                if (!dev.axisMap) {
+                    debug("JOYSTICK '%s' NOT RECOGNIZED\n", name);
+                    snapshot.status = 0xFFFF;
+                    close(dev.fd);
+                    dev.fd = -1;
+                }
+
+                else {
+
+                    // Event timestamps on the monotonic clock, like our own, rather than wall-clock time
+                    int clock = CLOCK_MONOTONIC;
+                    ioctl(dev.fd, EVIOCSCLOCKID, &clock);
+
+                    uint8_t absbits[(ABS_CNT+7)/8] = {};
+                    uint8_t keybits[(KEY_CNT+7)/8] = {};
+                    ioctl(dev.fd, EVIOCGBIT(EV_ABS, sizeof(absbits)), absbits);
+                    ioctl(dev.fd, EVIOCGBIT(EV_KEY, sizeof(keybits)), keybits);
+
+                    memset(dev.absNumber, NO_NUMBER, sizeof(dev.absNumber));
+                    memset(dev.keyNumber, NO_NUMBER, sizeof(dev.keyNumber));
+
+                    uint8_t count = 0;
+
+                    for (uint16_t code=0; code<ABS_CNT; ++code) {
+
+                        if (testBit(absbits, code)) {
+
+                            struct input_absinfo info = {};
+                            ioctl(dev.fd, EVIOCGABS(code), &info);
+
+                            dev.absNumber[code] = count++;
+                            dev.absMin[code] = info.minimum;
+                            dev.absMax[code] = info.maximum;
+                        }
+                    }
+
+                    // Joystick buttons first, then the miscellaneous ones below them
+                    count = 0;
+
+                    for (uint16_t code=BTN_JOYSTICK; code<KEY_CNT && count<NO_NUMBER; ++code) {
+                        if (testBit(keybits, code)) {
+                            dev.keyNumber[code] = count++;
+                        }
+                    }
+
+                    for (uint16_t code=BTN_MISC; code<BTN_JOYSTICK && count<NO_NUMBER; ++code) {
+                        if (testBit(keybits, code)) {
+                            dev.keyNumber[code] = count++;
+                        }
+                    }
+
+                    snapshot.buttons = 0;
+
+                    syncEvdev(dev, snapshot.axes, snapshot.buttons, dev.productId != PRODUCT_INTERLINK);
+
+                    snapshot.eventTime = monotonicSeconds();
+                    snapshot.status = 0;
+
+                    dropped = false;
+                }
+            }
+
+            publish(snapshot);
+        }
+
+        struct pollfd pfds[2] = {};
+        pfds[0].fd = dev.fd;
+        pfds[0].events = POLLIN;
+        pfds[1].fd = watch;
+        pfds[1].events = POLLIN;
+
+        if (::poll(pfds, 2, POLL_TIMEOUT_MSEC) <= 0) continue;
+
+        // Something in /dev/input changed; we only care when we're looking for a device
+        if (pfds[1].revents & POLLIN) {
+            char buf[4096];
+            while (read(watch, buf, sizeof(buf)) > 0)
+                ;
+            rescan = true;
+        }
+
+        if (dev.fd < 0) continue;
+
+        bool unplugged = pfds[0].revents & (POLLERR | POLLHUP | POLLNVAL);
+
+        if (!unplugged && (pfds[0].revents & POLLIN)) {
+
+            struct input_event events[64];
+
+            ssize_t size = 0;
+
+            while ((size = read(dev.fd, events, sizeof(events))) > 0) {
+
+                for (uint32_t k=0; k<size/sizeof(struct input_event); ++k) {
+
+                    const struct input_event & ev = events[k];
+
+                    // After a buffer overrun, skip to the end of the report and then read the state afresh
+                    if (ev.type == EV_SYN) {
+
+                        if (ev.code == SYN_DROPPED) {
+                            dropped = true;
+                        }
+
+                        else if (ev.code == SYN_REPORT) {
+
+                            if (dropped) {
+                                syncEvdev(dev, snapshot.axes, snapshot.buttons, dev.productId != PRODUCT_INTERLINK);
+                                dropped = false;
+                            }
+
+                            snapshot.eventTime = ev.time.tv_sec + ev.time.tv_usec / 1e6;
+                        }
+                    }
+
+                    else if (dropped) {
+                        continue;
+                    }
+
+                    else if (ev.type == EV_ABS && ev.code < ABS_CNT) {
+
+                        uint8_t number = dev.absNumber[ev.code];
+
+                        if (number < 8 && dev.axisMap[number] != AX_NIL) {
+                            snapshot.axes[dev.axisMap[number]] = normalize(dev, ev.code, ev.value);
+                        }
+                    }
+
+                    // Value 2 is autorepeat
+                    else if (ev.type == EV_KEY && ev.code < KEY_CNT && ev.value < 2) {
+
+                        uint8_t number = dev.keyNumber[ev.code];
+
+                        if (number == NO_NUMBER) continue;
+
+                        if (dev.productId == PRODUCT_INTERLINK) {
+                            getAuxInterlink(snapshot.axes, number, ev.value, AX_AU1, AX_AU2, AUX1_MID);
+                        }
+                        else if (number < 8) {
+                            if (ev.value) {
+                                snapshot.buttons |= 1 << number;
+                            }
+                            else {
+                                snapshot.buttons &= ~(1 << number);
+                            }
+                        }
+                    }
+                }
+            }
+
+            unplugged = size < 0 && errno == ENODEV;
+
+            publish(snapshot);
+        }
+
+        if (unplugged) {
+            close(dev.fd);
+            dev.fd = -1;
+            snapshot.status = 1;
+            publish(snapshot);
+            rescan = true;
+        }
+    }
+
+    if (dev.fd >= 0) {
+        close(dev.fd);
+    }
+
+    if (watch >= 0) {
+        close(watch);
+    }
+}
+
+uint16_t Joystick::pollProduct(float axes[6], uint8_t & buttons)
+{
+    if (!_evdev) {
+
+        if (_joystickId <= 0) return 0xFFFF;
+
+        if (!_thread) {
+            debug("JOYSTICK '%s' NOT RECOGNIZED\n", _productName);
+            return 0xFFFF; // dummy value
+        }
+    }
+
+    const snapshot_t & snapshot = latest();
+
     for (uint8_t k=0; k<6; ++k) {
-        axes[k] = _axes[k];
+        axes[k] = snapshot.axes[k];
     }
 
-    return 0x0000; // no error
-}  
+    buttons = snapshot.buttons;
+
+    // Evdev devices can be swapped for others while we run
+    _productId = snapshot.productId;
+    _isGameController = snapshot.isGameController;
+
+    _eventTime = snapshot.eventTime;
+
+    return snapshot.status;
+}
 
 
 #endif
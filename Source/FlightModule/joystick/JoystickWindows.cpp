@@ -73,6 +73,10 @@ Joystick::Joystick(const char * devname)
     }
 }
 
+Joystick::~Joystick(void)
+{
+}
+
 // Convert InterLink aux switches to unique gamepad buttons
 static void getAuxInterlink(float * axes, uint8_t buttons, uint8_t aux1, uint8_t aux2, float auxMid)
 {
@@ -25,7 +25,7 @@ void AHackflightPhantomPawn::BeginPlay()
 {
     //_phantom.BeginPlay(new FHackflightFlightManager(&_mixer, &_phantom.dynamics));
     
-    _phantom.BeginPlay(new FHackflightFlightManager(new hf::MixerQuadXAP(), &_phantom.dynamics));
+    _phantom.BeginPlay(new FHackflightFlightManager(new hf::MixerQuadXAP(), &_phantom.dynamics, TCHAR_TO_ANSI(*Joystick)));
 
     Super::BeginPlay();
 }
@@ -45,6 +45,10 @@ class FLIGHTMODULE_API AHackflightRocketPawn : public APawn {
 
     public:	
 
+        // Stick device for this vehicle, e.g. evdev:1; empty for -Joystick= or the default
+        UPROPERTY(EditAnywhere, Category=Sticks)
+        FString Joystick;
+
         AHackflightRocketPawn();
 
 }; // AHackflightRocketPawn
@@ -0,0 +1,152 @@
+/*
+* Class implementation for swarm actor in MulticopterSim
+*
+* Copyright (C) 2020 Simon D. Levy
+*
+* MIT License
+*/
+
+#include "SwarmActor.h"
+
+#include "UObject/ConstructorHelpers.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+
+ASwarmActor::ASwarmActor()
+{
+    static ConstructorHelpers::FObjectFinder<UStaticMesh> frameMesh(TEXT("/Game/Flying/Meshes/Phantom/Frame.Frame"));
+    static ConstructorHelpers::FObjectFinder<UStaticMesh> propMesh(TEXT("/Game/Flying/Meshes/Phantom/Prop.Prop"));
+
+    FrameMesh = frameMesh.Object;
+    PropMesh = propMesh.Object;
+
+    RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("SwarmRoot"));
+
+    // Nothing collides: the swarm's physics is all on its own thread
+    _frames = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("SwarmFrames"));
+    _frames->SetupAttachment(RootComponent);
+    _frames->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+    _props = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("SwarmProps"));
+    _props->SetupAttachment(RootComponent);
+    _props->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+    PrimaryActorTick.bCanEverTick = true;
+}
+
+// Called when the game starts or when spawned
+void ASwarmActor::BeginPlay()
+{
+    Super::BeginPlay();
+
+    FString path = ConfigPath;
+    FParse::Value(FCommandLine::Get(), TEXT("Swarm="), path);
+
+    if (path.IsEmpty()) {
+        error("SWARM: NO CONFIG FILE");
+        return;
+    }
+
+    Swarm::config_t config;
+    char message[200] = {};
+
+    if (!Swarm::readConfig(TCHAR_TO_ANSI(*path), config, message, sizeof(message))) {
+        error("SWARM: %s", message);
+        return;
+    }
+
+    VehicleConfig::config_t & vehicle = config.vehicle;
+
+    // Phantom propellers unless the config says otherwise
+    if (!vehicle.propCount && vehicle.frame == VehicleConfig::FRAME_QUADXAP) {
+        double props[4][2] = {{+.12, +.12}, {-.12, -.12}, {+.12, -.12}, {-.12, +.12}};
+        memcpy(vehicle.props, props, sizeof(props));
+        vehicle.propCount = 4;
+    }
+
+    _swarmManager = new FSwarmManager(config);
+
+    _frames->SetStaticMesh(FrameMesh);
+    _props->SetStaticMesh(PropMesh);
+
+    uint8_t motorCount = _swarmManager->motorCount();
+    uint8_t propCount = FMath::Min(vehicle.propCount, motorCount);
+
+    for (uint8_t j=0; j<propCount; ++j) {
+        _propOffsets.Add(FVector(vehicle.props[j][0], vehicle.props[j][1], 0) * 100 + FVector(0, 0, PropHeight)); // m => cm
+    }
+
+    _frameCount = _swarmManager->count();
+
+    for (uint32_t k=0; k<_frameCount; ++k) {
+
+        const Swarm::spot_t & spot = config.spots[k];
+
+        _spotLocations.Add(FVector(spot.x, spot.y, 0) * 100);
+
+        FTransform transform(FRotator(0, FMath::RadiansToDegrees(spot.yaw), 0), _spotLocations[k]);
+
+        _frames->AddInstance(transform);
+
+        for (uint8_t j=0; j<propCount; ++j) {
+            _props->AddInstance(FTransform(_propOffsets[j]) * transform);
+            _propPhases.Add(FMath::FRand() * 360);
+        }
+    }
+
+    _frameTransforms.SetNum(_frameCount);
+    _propTransforms.SetNum(_frameCount * propCount);
+}
+
+void ASwarmActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    FThreadedManager::stopThread((FThreadedManager **)&_swarmManager);
+
+    Super::EndPlay(EndPlayReason);
+}
+
+// Called automatically on main thread
+void ASwarmActor::Tick(float DeltaSeconds)
+{
+    Super::Tick(DeltaSeconds);
+
+    if (!_swarmManager) return;
+
+    const Dynamics::pose_t * poses = NULL;
+    const double * motors = NULL;
+    _swarmManager->getLatest(poses, motors);
+
+    uint8_t motorCount = _swarmManager->motorCount();
+    uint8_t propCount = _propOffsets.Num();
+
+    for (uint32_t k=0; k<_frameCount; ++k) {
+
+        const Dynamics::pose_t & pose = poses[k];
+
+        // Same conversion as Vehicle: NED meters to UE centimeters, radians to degrees
+        FVector location = _spotLocations[k] + FVector(pose.location[0], pose.location[1], -pose.location[2]) * 100;
+        FRotator rotation = FMath::RadiansToDegrees(FRotator(pose.rotation[1], pose.rotation[2], pose.rotation[0]));
+
+        _frameTransforms[k] = FTransform(rotation, location);
+
+        double motorsum = 0;
+        for (uint8_t j=0; j<motorCount; ++j) {
+            motorsum += motors[k*motorCount + j];
+        }
+
+        for (uint8_t j=0; j<propCount; ++j) {
+
+            uint32_t index = k*propCount + j;
+
+            if (motorsum > 0) {
+                _propPhases[index] = FMath::Fmod(_propPhases[index] + PROP_SPIN * _swarmManager->motorDirection(j), 360);
+            }
+
+            _propTransforms[index] = FTransform(FRotator(0, _propPhases[index], 0), _propOffsets[j]) * _frameTransforms[k];
+        }
+    }
+
+    // Transforms are relative to the actor, which stays at the swarm's origin
+    _frames->BatchUpdateInstancesTransforms(0, _frameTransforms, false, true, true);
+    _props->BatchUpdateInstancesTransforms(0, _propTransforms, false, true, true);
+}
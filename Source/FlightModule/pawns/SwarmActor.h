@@ -0,0 +1,82 @@
+/*
+* Class declaration for an actor showing a whole swarm of vehicles
+*
+* One thread flies every vehicle (see SwarmManager.hpp); the vehicles are
+* drawn as two instanced meshes, one for the frames and one for the
+* propellers, so a swarm of hundreds costs about as much to render as one.
+*
+* The vehicles come from the file given by -Swarm=<file>, or else by
+* ConfigPath; see Swarm.hpp for its format.
+*
+* Copyright (C) 2020 Simon D. Levy
+*
+* MIT License
+*/
+
+#pragma once
+
+#include "../../MainModule/SwarmManager.hpp"
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Components/InstancedStaticMeshComponent.h"
+
+#include "SwarmActor.generated.h"
+
+UCLASS(Config=Game)
+class FLIGHTMODULE_API ASwarmActor : public AActor {
+
+    private:
+
+        GENERATED_BODY()
+
+        // Degrees per frame for spinning propellers, as for single vehicles
+        static constexpr float PROP_SPIN = 200;
+
+        FSwarmManager * _swarmManager = NULL;
+
+        UInstancedStaticMeshComponent * _frames = NULL;
+        UInstancedStaticMeshComponent * _props = NULL;
+
+        // Propeller locations on the frame, in cm
+        TArray<FVector> _propOffsets;
+
+        // Starting angle of each propeller, so the vehicles don't all spin in step
+        TArray<float> _propPhases;
+
+        // Where each vehicle's pose is measured from, in cm
+        TArray<FVector> _spotLocations;
+
+        TArray<FTransform> _frameTransforms;
+        TArray<FTransform> _propTransforms;
+
+        uint32_t _frameCount = 0;
+
+    protected:
+
+        // AActor overrides
+
+        virtual void BeginPlay() override;
+
+        virtual void Tick(float DeltaSeconds) override;
+
+        virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+    public:
+
+        UPROPERTY(EditAnywhere, Category=Swarm)
+        FString ConfigPath;
+
+        UPROPERTY(EditAnywhere, Category=Swarm)
+        UStaticMesh * FrameMesh;
+
+        UPROPERTY(EditAnywhere, Category=Swarm)
+        UStaticMesh * PropMesh;
+
+        // Height of the propellers above the frame's origin, in cm
+        UPROPERTY(EditAnywhere, Category=Swarm)
+        float PropHeight = 0;
+
+        ASwarmActor();
+
+}; // ASwarmActor
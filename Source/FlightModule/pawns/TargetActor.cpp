@@ -0,0 +1,64 @@
+/*
+* Class implementation for target actor in MulticopterSim
+*
+* Copyright (C) 2020 Simon D. Levy
+*
+* MIT License
+*/
+
+#include "TargetActor.h"
+
+ATargetActor::ATargetActor()
+{
+    RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("TargetRoot"));
+
+    _mesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("TargetMesh"));
+    _mesh->SetupAttachment(RootComponent);
+
+    PrimaryActorTick.bCanEverTick = true;
+}
+
+// Called when the game starts or when spawned
+void ATargetActor::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (TargetMesh) {
+        _mesh->SetStaticMesh(TargetMesh);
+    }
+
+    _trajectory = new WaypointTrajectory(Smooth, Loop);
+
+    FVector start = GetActorLocation();
+    FRotator rotation = GetActorRotation();
+
+    for (int32 k=0; k<Waypoints.Num(); ++k) {
+        _trajectory->add(k * LegTime, start + Waypoints[k], rotation);
+    }
+
+    _startTime = GetWorld()->GetTimeSeconds();
+}
+
+void ATargetActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    delete _trajectory;
+    _trajectory = NULL;
+
+    Super::EndPlay(EndPlayReason);
+}
+
+// Called automatically on main thread
+void ATargetActor::Tick(float DeltaSeconds)
+{
+    Super::Tick(DeltaSeconds);
+
+    if (!_trajectory || !Waypoints.Num()) return;
+
+    FVector location = GetActorLocation();
+    FRotator rotation = GetActorRotation();
+
+    // World time stops while the game is paused, so the target waits with everything else
+    _trajectory->getPose(GetWorld()->GetTimeSeconds() - _startTime, location, rotation);
+
+    SetActorLocationAndRotation(location, rotation);
+}
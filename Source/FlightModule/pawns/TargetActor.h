@@ -0,0 +1,70 @@
+/*
+* Class declaration for an actor that moves along a target trajectory
+*
+* Flies a mesh through timed waypoints (see WaypointTrajectory in
+* TargetManager.hpp), asking for its pose at the current simulation time
+* on every tick, for vehicles and cameras to chase or track.
+*
+* Copyright (C) 2020 Simon D. Levy
+*
+* MIT License
+*/
+
+#pragma once
+
+#include "../../MainModule/TargetManager.hpp"
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Components/StaticMeshComponent.h"
+
+#include "TargetActor.generated.h"
+
+UCLASS(Config=Game)
+class FLIGHTMODULE_API ATargetActor : public AActor {
+
+    private:
+
+        GENERATED_BODY()
+
+        WaypointTrajectory * _trajectory = NULL;
+
+        UStaticMeshComponent * _mesh = NULL;
+
+        // Simulation time when play began
+        double _startTime = 0;
+
+    protected:
+
+        // AActor overrides
+
+        virtual void BeginPlay() override;
+
+        virtual void Tick(float DeltaSeconds) override;
+
+        virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+    public:
+
+        UPROPERTY(EditAnywhere, Category=Target)
+        UStaticMesh * TargetMesh;
+
+        // Waypoints relative to where the actor starts, in cm
+        UPROPERTY(EditAnywhere, Category=Target)
+        TArray<FVector> Waypoints;
+
+        // Seconds from one waypoint to the next
+        UPROPERTY(EditAnywhere, Category=Target)
+        float LegTime = 5;
+
+        // Curve through the waypoints rather than straight lines
+        UPROPERTY(EditAnywhere, Category=Target)
+        bool Smooth = true;
+
+        // Head back to the first waypoint after the last, and go around again
+        UPROPERTY(EditAnywhere, Category=Target)
+        bool Loop = true;
+
+        ATargetActor();
+
+}; // ATargetActor
@@ -9,6 +9,9 @@
 #pragma once
 
 #include "Utils.hpp"
+#include "RenderTargetPool.hpp"
+
+#include "Components/SceneCaptureComponent2D.h"
 
 class Camera {
 
@@ -16,9 +19,6 @@ class Camera {
 
     public:
 
-        // Arbitrary array limits supporting statically declared assets
-        static const uint8_t MAX_CAMERAS = 10; 
-
         // Supported resolutions
         typedef enum {
 
@@ -36,11 +36,27 @@ class Camera {
         static constexpr float CAMERA_Y =   0;
         static constexpr float CAMERA_Z = +30;
 
-        Resolution_t _res;
-
         // Byte array for RGBA image
         uint8_t * _imageBytes = NULL;
 
+        // Pixels read back from render target, reused across frames
+        TArray<FColor> _renderTargetPixels;
+
+        // Pooled render target, acquired on first grabImage()
+        UTextureRenderTarget2D * _textureRenderTarget2D = NULL;
+
+        void acquireRenderTarget(void)
+        {
+            _textureRenderTarget2D = RenderTargetPool::acquire(_cols, _rows);
+
+            if (_captureComponent) {
+                _captureComponent->TextureTarget = _textureRenderTarget2D;
+            }
+
+            // Get the render target resource for copying the image pixels
+            _renderTarget = _textureRenderTarget2D->GameThread_GetRenderTargetResource();
+        }
+
     protected:
 
         // Image size and field of view, set in constructor
@@ -55,14 +71,10 @@ class Camera {
         UCameraComponent         * _cameraComponent = NULL;
         FRenderTarget            * _renderTarget = NULL;
  
-        Camera(float fov, Resolution_t resolution) 
+        Camera(float fov, uint16_t cols, uint16_t rows) 
         {
-            uint16_t rowss[3] = {480, 720, 1080};
-            uint16_t colss[3] = {640, 1280, 1920};
-
-            _rows = rowss[resolution];
-            _cols = colss[resolution];
-            _res  = resolution;
+            _rows = rows;
+            _cols = cols;
             _fov = fov;
 
             // Create a byte array sufficient to hold the RGBA image
@@ -74,71 +86,37 @@ class Camera {
             _renderTarget = NULL;
         }
 
+        Camera(float fov, Resolution_t resolution) 
+            : Camera(fov, resolutionCols(resolution), resolutionRows(resolution))
+        {
+        }
+
+        static uint16_t resolutionRows(Resolution_t resolution)
+        {
+            const uint16_t rows[RES_COUNT] = {480, 720, 1080};
+            return rows[resolution];
+        }
+
+        static uint16_t resolutionCols(Resolution_t resolution)
+        {
+            const uint16_t cols[RES_COUNT] = {640, 1280, 1920};
+            return cols[resolution];
+        }
+
         // Called by Vehicle::addCamera()
         virtual void addToVehicle(APawn * pawn, USpringArmComponent * springArm, uint8_t id)
         {
-            // Get static assets for all render targets.  This provides less
-            // flexibility than creating it dynamically, but acquiring the
-            // pixels seems to run twice as fast.
-            static ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>
-                cameraTextureObjects[RES_COUNT][MAX_CAMERAS] =
-            { 
-                {
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_1")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_2")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_3")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_4")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_5")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_6")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_7")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_8")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_9")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_640x480_10")) 
-                },
-                {
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_1")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_2")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_3")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_4")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_5")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_6")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_7")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_8")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_9")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1280x720_10")) 
-                },
-                {
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_1")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_2")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_3")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_4")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_5")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_6")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_7")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_8")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_9")),
-                    ConstructorHelpers::FObjectFinder<UTextureRenderTarget2D>(TEXT("/Game/Flying/RenderTargets/renderTarget_1920x1080_10")) 
-                }
-            };
-
-            UTextureRenderTarget2D * textureRenderTarget2D = cameraTextureObjects[_res][id].Object;
-
             _cameraComponent = pawn->CreateDefaultSubobject<UCameraComponent >(makeName("Camera", id));
             _cameraComponent->SetWorldScale3D(FVector(0.1,0.1,0.1));
             _cameraComponent->SetupAttachment(springArm, USpringArmComponent::SocketName);
             _cameraComponent->SetRelativeLocation(FVector(CAMERA_X, CAMERA_Y, CAMERA_Z));
-            //_cameraComponent->TextureTarget = textureRenderTarget2D;
 
-            // Create a scene-capture component and set its target to the render target
-            //_captureComponent = pawn->CreateDefaultSubobject<USceneCaptureComponent2D >(makeName("Capture", id));
-            //_captureComponent->SetWorldScale3D(FVector(0.1,0.1,0.1));
-            //_captureComponent->SetupAttachment(springArm, USpringArmComponent::SocketName);
-            //_captureComponent->SetRelativeLocation(FVector(CAMERA_X, CAMERA_Y, CAMERA_Z));
-            //_captureComponent->TextureTarget = textureRenderTarget2D;
+            // Create a scene-capture component; its render target is attached on first grabImage()
+            _captureComponent = pawn->CreateDefaultSubobject<USceneCaptureComponent2D >(makeName("Capture", id));
+            _captureComponent->SetWorldScale3D(FVector(0.1,0.1,0.1));
+            _captureComponent->SetupAttachment(springArm, USpringArmComponent::SocketName);
+            _captureComponent->SetRelativeLocation(FVector(CAMERA_X, CAMERA_Y, CAMERA_Z));
 
-            // Get the render target resource for copying the image pixels
-            _renderTarget = textureRenderTarget2D->GameThread_GetRenderTargetResource();
-            
             // Set the initial FOV
             setFov(_fov);
         }
@@ -149,7 +127,9 @@ class Camera {
         // Sets current FOV
         void setFov(float fov)
         {
-            //_captureComponent->FOVAngle = fov;
+            if (_captureComponent) {
+                _captureComponent->FOVAngle = fov;
+            }
         }
 
     public:
@@ -157,12 +137,15 @@ class Camera {
         // Called on main thread
         void grabImage(void)
         {
+            if (!_renderTarget) {
+                acquireRenderTarget();
+            }
+
             // Read the pixels from the RenderTarget
-            TArray<FColor> renderTargetPixels;
-            _renderTarget->ReadPixels(renderTargetPixels);
+            _renderTarget->ReadPixels(_renderTargetPixels);
 
             // Copy the RBGA pixels to the private image
-            FMemory::Memcpy(_imageBytes, renderTargetPixels.GetData(), _rows*_cols*4);
+            FMemory::Memcpy(_imageBytes, _renderTargetPixels.GetData(), _rows*_cols*4);
 
             // Virtual method implemented in subclass
             processImageBytes(_imageBytes);
@@ -170,7 +153,10 @@ class Camera {
 
         virtual ~Camera()
         {
-            delete _imageBytes;
+            // Make render target available to the next camera of this size
+            RenderTargetPool::release(_textureRenderTarget2D);
+
+            delete[] _imageBytes;
         }
 
 }; // Class Camera
@@ -0,0 +1,127 @@
+/*
+ * Fixed-delay line for MulticopterSim
+ *
+ * Delays a stream of fixed-width samples (a vehicle state, a set of motor
+ * values) by a number of steps or by a time, to model sensor latency and
+ * transport delay.  Samples live in a power-of-two ring allocated once, so
+ * pushing a sample is a copy and an index update, with no allocation.
+ *
+ * Until a full delay's worth of samples has arrived, the output is the
+ * oldest sample seen.  A delay in seconds needs the ring to hold every sample
+ * pushed within the delay; if samples arrive faster than that, the oldest are
+ * overwritten and the delay comes out shorter than requested.
+ *
+ * This file has no Unreal Engine dependencies.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+class DelayLine {
+
+    private:
+
+        uint32_t _width = 0;    // doubles per sample
+        uint32_t _mask = 0;
+
+        uint32_t _steps = 0;
+        double _seconds = 0;
+
+        double * _samples = NULL;
+        double * _times = NULL;
+
+        // Samples ever pushed, and the one currently coming out
+        uint64_t _head = 0;
+        uint64_t _tail = 0;
+
+        void allocate(uint32_t capacity)
+        {
+            uint32_t size = 1;
+            while (size < capacity && size < 0x80000000u) {
+                size <<= 1;
+            }
+
+            _mask = size - 1;
+
+            _samples = new double [(uint64_t)size * _width]();
+            _times = new double [size]();
+        }
+
+    public:
+
+        /**
+         * Creates a delay measured in steps.
+         *
+         * @param width doubles per sample
+         * @param steps delay in steps
+         */
+        DelayLine(uint32_t width, uint32_t steps)
+        {
+            _width = width;
+            _steps = steps;
+
+            allocate(steps + 1);
+        }
+
+        /**
+         * Creates a delay measured in seconds.
+         *
+         * @param width doubles per sample
+         * @param seconds delay in seconds
+         * @param capacity most samples that will arrive within the delay
+         */
+        DelayLine(uint32_t width, double seconds, uint32_t capacity)
+        {
+            _width = width;
+            _seconds = seconds;
+
+            allocate(capacity + 1);
+        }
+
+        ~DelayLine(void)
+        {
+            delete[] _samples;
+            delete[] _times;
+        }
+
+        /**
+         * Adds a sample and gets the delayed one.
+         *
+         * @param time current time in seconds
+         * @param in newest sample
+         * @param out delayed sample; may be the same array as in
+         */
+        void push(double time, const double * in, double * out)
+        {
+            memcpy(&_samples[(_head & _mask) * _width], in, _width * sizeof(double));
+            _times[_head & _mask] = time;
+
+            _head++;
+
+            // Don't read samples that have been overwritten
+            if (_head - _tail > _mask + 1) {
+                _tail = _head - (_mask + 1);
+            }
+
+            if (_seconds > 0) {
+
+                // Time only moves forward, so the output only moves forward
+                while (_tail + 1 < _head && _times[(_tail + 1) & _mask] <= time - _seconds) {
+                    _tail++;
+                }
+            }
+
+            else if (_head > _steps) {
+                _tail = _head - 1 - _steps;
+            }
+
+            memcpy(out, &_samples[(_tail & _mask) * _width], _width * sizeof(double));
+        }
+
+}; // class DelayLine
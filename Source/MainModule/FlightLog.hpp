@@ -0,0 +1,796 @@
+/*
+ * Columnar flight-log format for MulticopterSim
+ *
+ * Stores time, the fields of Dynamics::state_t and the motor values as
+ * columns, in chunks of up to CHUNK_SIZE samples.  An index at the end of the
+ * file gives each chunk's offset along with the minimum and maximum of every
+ * column, so a reader can find any simulation time with a binary search and
+ * can skip chunks that can't hold the values it is looking for.  A log that
+ * was never closed (after a crash, say) has no index; the reader rebuilds one
+ * by walking the chunks, each of which starts with a small header.
+ *
+ * File layout (all values little-endian):
+ *
+ *   header_t
+ *   chunks       chunkHeader_t, then for each column: uint32_t byte count and the column's bytes
+ *   chunk_t[]    index, one entry per chunk
+ *   trailer_t
+ *
+ * Columns are either raw doubles or, with ENCODING_DELTA, each double's bit
+ * pattern minus its linear prediction from the two before it, zigzag- and
+ * varint-coded.  Smooth signals sampled at a high rate predict well, so this
+ * is lossless yet typically a fraction of the raw size.
+ *
+ * This file has no Unreal Engine dependencies, so tools outside the
+ * simulator can read and write logs too.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "dynamics/Dynamics.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#ifdef PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#else
+#include <windows.h>
+#endif
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class FlightLog {
+
+    public:
+
+        static const uint32_t MAGIC         = 0x474c434d; // "MCLG"
+        static const uint32_t CHUNK_MAGIC   = 0x434c434d; // "MCLC"
+        static const uint32_t TRAILER_MAGIC = 0x584c434d; // "MCLX"
+        static const uint32_t VERSION       = 1;
+
+        static const uint32_t CHUNK_SIZE = 4096;
+
+        static const uint8_t MAX_MOTORS = Dynamics::MAX_MOTORS;
+
+        // Column offsets
+        enum {
+            COL_TIME,
+            COL_ANGULAR_VEL,
+            COL_BODY_ACCEL   = COL_ANGULAR_VEL + 3,
+            COL_INERTIAL_VEL = COL_BODY_ACCEL + 3,
+            COL_QUATERNION   = COL_INERTIAL_VEL + 3,
+            COL_LOCATION     = COL_QUATERNION + 4,
+            COL_ROTATION     = COL_LOCATION + 3,
+            COL_MOTORS       = COL_ROTATION + 3,
+            MAX_COLUMNS      = COL_MOTORS + MAX_MOTORS
+        };
+
+        enum {
+            ENCODING_RAW,
+            ENCODING_DELTA
+        };
+
+        typedef struct {
+
+            uint32_t magic;
+            uint32_t version;
+            uint8_t  motorCount;
+            uint8_t  columnCount;
+            uint8_t  encoding;
+            uint8_t  reserved;
+            uint32_t chunkSize;
+
+        } header_t;
+
+        typedef struct {
+
+            uint32_t magic;
+            uint32_t count;         // samples
+            uint64_t firstSample;
+
+        } chunkHeader_t;
+
+        typedef struct {
+
+            uint64_t offset;        // bytes from start of file
+            uint64_t firstSample;
+            uint32_t count;         // samples
+            uint32_t size;          // bytes
+            double   minimum[MAX_COLUMNS];
+            double   maximum[MAX_COLUMNS];
+
+        } chunk_t;
+
+        typedef struct {
+
+            uint64_t indexOffset;
+            uint64_t sampleCount;
+            uint32_t chunkCount;
+            uint32_t magic;
+
+        } trailer_t;
+
+        // Flattens one sample into column order
+        static void toRow(double time, const Dynamics::state_t & state, const double * motors, uint8_t motorCount,
+                double row[MAX_COLUMNS])
+        {
+            row[COL_TIME] = time;
+            memcpy(&row[COL_ANGULAR_VEL], state.angularVel, 3*sizeof(double));
+            memcpy(&row[COL_BODY_ACCEL], state.bodyAccel, 3*sizeof(double));
+            memcpy(&row[COL_INERTIAL_VEL], state.inertialVel, 3*sizeof(double));
+            memcpy(&row[COL_QUATERNION], state.quaternion, 4*sizeof(double));
+            memcpy(&row[COL_LOCATION], state.pose.location, 3*sizeof(double));
+            memcpy(&row[COL_ROTATION], state.pose.rotation, 3*sizeof(double));
+            memcpy(&row[COL_MOTORS], motors, motorCount*sizeof(double));
+        }
+
+        static void fromRow(const double row[MAX_COLUMNS], uint8_t motorCount,
+                double & time, Dynamics::state_t & state, double * motors)
+        {
+            time = row[COL_TIME];
+            memcpy(state.angularVel, &row[COL_ANGULAR_VEL], 3*sizeof(double));
+            memcpy(state.bodyAccel, &row[COL_BODY_ACCEL], 3*sizeof(double));
+            memcpy(state.inertialVel, &row[COL_INERTIAL_VEL], 3*sizeof(double));
+            memcpy(state.quaternion, &row[COL_QUATERNION], 4*sizeof(double));
+            memcpy(state.pose.location, &row[COL_LOCATION], 3*sizeof(double));
+            memcpy(state.pose.rotation, &row[COL_ROTATION], 3*sizeof(double));
+            if (motors) {
+                memcpy(motors, &row[COL_MOTORS], motorCount*sizeof(double));
+            }
+        }
+
+        /**
+         * Encodes a column.
+         *
+         * @param values column values
+         * @param count number of values
+         * @param encoding ENCODING_RAW or ENCODING_DELTA
+         * @param out output buffer, with room for maxEncodedSize(count) bytes
+         * @return number of bytes written
+         */
+        static uint32_t encodeColumn(const double * values, uint32_t count, uint8_t encoding, uint8_t * out)
+        {
+            if (encoding == ENCODING_RAW) {
+                memcpy(out, values, count*sizeof(double));
+                return count*sizeof(double);
+            }
+
+            uint8_t * start = out;
+
+            uint64_t previous = 0;
+            uint64_t delta = 0;
+
+            for (uint32_t k=0; k<count; ++k) {
+
+                uint64_t bits = 0;
+                memcpy(&bits, &values[k], sizeof(bits));
+
+                // Residual from linear prediction, in wraparound arithmetic
+                int64_t residual = (int64_t)(bits - previous - delta);
+
+                delta = bits - previous;
+                previous = bits;
+
+                // Zigzag keeps small negative residuals small
+                uint64_t zigzag = ((uint64_t)residual << 1) ^ (uint64_t)(residual >> 63);
+
+                while (zigzag >= 0x80) {
+                    *out++ = (uint8_t)(zigzag | 0x80);
+                    zigzag >>= 7;
+                }
+                *out++ = (uint8_t)zigzag;
+            }
+
+            return (uint32_t)(out - start);
+        }
+
+        /**
+         * Decodes a column.
+         *
+         * @return false if the input is malformed
+         */
+        static bool decodeColumn(const uint8_t * in, uint32_t size, uint32_t count, uint8_t encoding, double * values)
+        {
+            if (encoding == ENCODING_RAW) {
+                if (size != count*sizeof(double)) return false;
+                memcpy(values, in, size);
+                return true;
+            }
+
+            const uint8_t * end = in + size;
+
+            uint64_t previous = 0;
+            uint64_t delta = 0;
+
+            for (uint32_t k=0; k<count; ++k) {
+
+                uint64_t zigzag = 0;
+
+                for (uint8_t shift=0; ; shift+=7) {
+                    if (in == end || shift > 63) return false;
+                    uint8_t byte = *in++;
+                    zigzag |= (uint64_t)(byte & 0x7f) << shift;
+                    if (!(byte & 0x80)) break;
+                }
+
+                uint64_t residual = (zigzag >> 1) ^ (0 - (zigzag & 1));
+
+                uint64_t bits = previous + delta + residual;
+
+                delta = bits - previous;
+                previous = bits;
+
+                memcpy(&values[k], &bits, sizeof(double));
+            }
+
+            return in == end;
+        }
+
+        static void columnRange(const double * values, uint32_t count, double & minimum, double & maximum)
+        {
+            minimum = maximum = values[0];
+
+            for (uint32_t k=1; k<count; ++k) {
+                if (values[k] < minimum) minimum = values[k];
+                if (values[k] > maximum) maximum = values[k];
+            }
+        }
+
+        // Varints take at most ten bytes
+        static uint32_t maxEncodedSize(uint32_t count)
+        {
+            return 10 * count;
+        }
+
+}; // class FlightLog
+
+class FlightLogWriter {
+
+    private:
+
+        FILE * _fp = NULL;
+
+        FlightLog::header_t _header = {};
+
+        // Current chunk, column by column
+        double * _columns = NULL;
+        uint32_t _count = 0;
+
+        uint8_t * _encoded = NULL;
+
+        std::vector<FlightLog::chunk_t> _index;
+
+        uint64_t _sampleCount = 0;
+        uint64_t _offset = 0;
+
+        char _message[200] = {};
+
+        void writeChunk(void)
+        {
+            if (_count == 0) return;
+
+            FlightLog::chunk_t chunk = {};
+            chunk.offset = _offset;
+            chunk.firstSample = _sampleCount - _count;
+            chunk.count = _count;
+
+            FlightLog::chunkHeader_t chunkHeader = {};
+            chunkHeader.magic = FlightLog::CHUNK_MAGIC;
+            chunkHeader.count = _count;
+            chunkHeader.firstSample = chunk.firstSample;
+
+            fwrite(&chunkHeader, sizeof(chunkHeader), 1, _fp);
+            chunk.size = sizeof(chunkHeader);
+
+            for (uint8_t c=0; c<_header.columnCount; ++c) {
+
+                const double * column = &_columns[c*FlightLog::CHUNK_SIZE];
+
+                FlightLog::columnRange(column, _count, chunk.minimum[c], chunk.maximum[c]);
+
+                uint32_t size = FlightLog::encodeColumn(column, _count, _header.encoding, _encoded);
+
+                fwrite(&size, sizeof(size), 1, _fp);
+                fwrite(_encoded, 1, size, _fp);
+
+                chunk.size += sizeof(size) + size;
+            }
+
+            // Whole chunks reach the file as they fill, so a crash loses at most one
+            fflush(_fp);
+
+            _offset += chunk.size;
+            _index.push_back(chunk);
+
+            _count = 0;
+        }
+
+    public:
+
+        /**
+         * Creates (or overwrites) a log file.
+         *
+         * @param path file to write
+         * @param motorCount number of motor values per sample
+         * @param encoding FlightLog::ENCODING_DELTA or FlightLog::ENCODING_RAW
+         */
+        FlightLogWriter(const char * path, uint8_t motorCount, uint8_t encoding=FlightLog::ENCODING_DELTA)
+        {
+            if (motorCount > FlightLog::MAX_MOTORS) {
+                snprintf(_message, sizeof(_message), "too many motors (%d)", motorCount);
+                return;
+            }
+
+            _fp = fopen(path, "wb");
+            if (!_fp) {
+                snprintf(_message, sizeof(_message), "fopen(%s) failed", path);
+                return;
+            }
+
+            _header.magic = FlightLog::MAGIC;
+            _header.version = FlightLog::VERSION;
+            _header.motorCount = motorCount;
+            _header.columnCount = FlightLog::COL_MOTORS + motorCount;
+            _header.encoding = encoding;
+            _header.chunkSize = FlightLog::CHUNK_SIZE;
+
+            fwrite(&_header, sizeof(_header), 1, _fp);
+            _offset = sizeof(_header);
+
+            _columns = new double [FlightLog::MAX_COLUMNS * FlightLog::CHUNK_SIZE];
+            _encoded = new uint8_t [FlightLog::maxEncodedSize(FlightLog::CHUNK_SIZE)];
+        }
+
+        ~FlightLogWriter(void)
+        {
+            close();
+
+            delete[] _columns;
+            delete[] _encoded;
+        }
+
+        // Appends one sample; samples should come in time order
+        void append(double time, const Dynamics::state_t & state, const double * motors)
+        {
+            if (!_fp) return;
+
+            double row[FlightLog::MAX_COLUMNS] = {};
+            FlightLog::toRow(time, state, motors, _header.motorCount, row);
+
+            for (uint8_t c=0; c<_header.columnCount; ++c) {
+                _columns[c*FlightLog::CHUNK_SIZE + _count] = row[c];
+            }
+
+            _count++;
+            _sampleCount++;
+
+            if (_count == FlightLog::CHUNK_SIZE) {
+                writeChunk();
+            }
+        }
+
+        // Writes the last chunk and the index; the log can't be read until this is done
+        void close(void)
+        {
+            if (!_fp) return;
+
+            writeChunk();
+
+            // Readers use the index in place, so align it
+            static const uint8_t zeros[8] = {};
+            fwrite(zeros, 1, (size_t)((8 - _offset % 8) % 8), _fp);
+            _offset = (_offset + 7) / 8 * 8;
+
+            FlightLog::trailer_t trailer = {};
+            trailer.indexOffset = _offset;
+            trailer.sampleCount = _sampleCount;
+            trailer.chunkCount = (uint32_t)_index.size();
+            trailer.magic = FlightLog::TRAILER_MAGIC;
+
+            if (!_index.empty()) {
+                fwrite(&_index[0], sizeof(FlightLog::chunk_t), _index.size(), _fp);
+            }
+            fwrite(&trailer, sizeof(trailer), 1, _fp);
+
+            fclose(_fp);
+            _fp = NULL;
+        }
+
+        bool isOpen(void)
+        {
+            return _fp != NULL;
+        }
+
+        uint64_t getSampleCount(void)
+        {
+            return _sampleCount;
+        }
+
+        const char * getMessage(void)
+        {
+            return _message;
+        }
+
+}; // class FlightLogWriter
+
+class FlightLogReader {
+
+    private:
+
+        const uint8_t * _map = NULL;
+        uint64_t _mapSize = 0;
+
+        FlightLog::header_t _header = {};
+        FlightLog::trailer_t _trailer = {};
+        const FlightLog::chunk_t * _index = NULL;
+
+        // Index rebuilt from the chunks, for logs that weren't closed
+        std::vector<FlightLog::chunk_t> _recovered;
+        bool _wasRecovered = false;
+
+        bool _open = false;
+
+        // Most recently decoded chunk, column by column
+        double * _columns = NULL;
+        int64_t _decodedChunk = -1;
+
+        char _message[200] = {};
+
+#ifdef _WIN32
+        HANDLE _file = INVALID_HANDLE_VALUE;
+        HANDLE _mapping = NULL;
+#endif
+
+        bool mapFile(const char * path)
+        {
+#ifdef _WIN32
+            _file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (_file == INVALID_HANDLE_VALUE) {
+                sprintf_s(_message, "CreateFile(%s) failed", path);
+                return false;
+            }
+
+            LARGE_INTEGER size = {};
+            GetFileSizeEx(_file, &size);
+            _mapSize = (uint64_t)size.QuadPart;
+
+            _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (!_mapping) {
+                sprintf_s(_message, "CreateFileMapping() failed");
+                return false;
+            }
+
+            _map = (const uint8_t *)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+            if (!_map) {
+                sprintf_s(_message, "MapViewOfFile() failed");
+                return false;
+            }
+#else
+            int fd = open(path, O_RDONLY);
+            if (fd < 0) {
+                snprintf(_message, sizeof(_message), "open(%s) failed", path);
+                return false;
+            }
+
+            struct stat st = {};
+            fstat(fd, &st);
+            _mapSize = (uint64_t)st.st_size;
+
+            void * map = _mapSize ? mmap(NULL, (size_t)_mapSize, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+
+            // The mapping stays valid after the descriptor is closed
+            ::close(fd);
+
+            if (map == MAP_FAILED) {
+                snprintf(_message, sizeof(_message), "mmap() failed");
+                return false;
+            }
+
+            _map = (const uint8_t *)map;
+#endif
+            return true;
+        }
+
+        void unmap(void)
+        {
+#ifdef _WIN32
+            if (_map) UnmapViewOfFile(_map);
+            if (_mapping) CloseHandle(_mapping);
+            if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+            _mapping = NULL;
+            _file = INVALID_HANDLE_VALUE;
+#else
+            if (_map) munmap((void *)_map, (size_t)_mapSize);
+#endif
+            _map = NULL;
+            _index = NULL;
+            _open = false;
+        }
+
+        /**
+         * Decodes the chunk at an offset into _columns.
+         *
+         * @return the chunk's size in bytes, or zero if it is corrupt or runs past limit
+         */
+        uint64_t decodeAt(uint64_t offset, uint64_t limit, uint32_t & count)
+        {
+            FlightLog::chunkHeader_t chunkHeader = {};
+
+            if (limit < offset + sizeof(chunkHeader)) return 0;
+
+            memcpy(&chunkHeader, _map + offset, sizeof(chunkHeader));
+
+            if (chunkHeader.magic != FlightLog::CHUNK_MAGIC || chunkHeader.count == 0 ||
+                    chunkHeader.count > FlightLog::CHUNK_SIZE) {
+                return 0;
+            }
+
+            const uint8_t * in = _map + offset + sizeof(chunkHeader);
+            const uint8_t * end = _map + limit;
+
+            for (uint8_t c=0; c<_header.columnCount; ++c) {
+
+                uint32_t size = 0;
+                if (end - in < (int64_t)sizeof(size)) return 0;
+                memcpy(&size, in, sizeof(size));
+                in += sizeof(size);
+
+                if ((uint64_t)(end - in) < size ||
+                        !FlightLog::decodeColumn(in, size, chunkHeader.count, _header.encoding,
+                            &_columns[c*FlightLog::CHUNK_SIZE])) {
+                    return 0;
+                }
+
+                in += size;
+            }
+
+            count = chunkHeader.count;
+
+            return (uint64_t)(in - (_map + offset));
+        }
+
+        // Rebuilds the index by walking the chunks, stopping at the first incomplete one
+        void recover(void)
+        {
+            uint64_t offset = sizeof(FlightLog::header_t);
+            uint64_t samples = 0;
+
+            while (true) {
+
+                FlightLog::chunk_t chunk = {};
+
+                uint64_t size = decodeAt(offset, _mapSize, chunk.count);
+                if (size == 0) break;
+
+                chunk.offset = offset;
+                chunk.size = (uint32_t)size;
+                chunk.firstSample = samples;
+
+                for (uint8_t c=0; c<_header.columnCount; ++c) {
+                    FlightLog::columnRange(&_columns[c*FlightLog::CHUNK_SIZE], chunk.count, chunk.minimum[c], chunk.maximum[c]);
+                }
+
+                _recovered.push_back(chunk);
+
+                offset += size;
+                samples += chunk.count;
+            }
+
+            _trailer.indexOffset = offset;
+            _trailer.sampleCount = samples;
+            _trailer.chunkCount = (uint32_t)_recovered.size();
+
+            _index = _recovered.empty() ? NULL : &_recovered[0];
+            _wasRecovered = true;
+        }
+
+        bool validate(void)
+        {
+            if (_mapSize < sizeof(FlightLog::header_t)) {
+                snprintf(_message, sizeof(_message), "file too short");
+                return false;
+            }
+
+            memcpy(&_header, _map, sizeof(_header));
+
+            if (_header.magic != FlightLog::MAGIC || _header.version != FlightLog::VERSION ||
+                    _header.motorCount > FlightLog::MAX_MOTORS || _header.chunkSize != FlightLog::CHUNK_SIZE) {
+                snprintf(_message, sizeof(_message), "not a version %d flight log", FlightLog::VERSION);
+                return false;
+            }
+
+            _columns = new double [FlightLog::MAX_COLUMNS * FlightLog::CHUNK_SIZE];
+
+            if (_mapSize >= sizeof(_header) + sizeof(_trailer)) {
+                memcpy(&_trailer, _map + _mapSize - sizeof(_trailer), sizeof(_trailer));
+            }
+
+            if (_trailer.magic == FlightLog::TRAILER_MAGIC && _trailer.indexOffset % 8 == 0 &&
+                    _trailer.indexOffset + (uint64_t)_trailer.chunkCount * sizeof(FlightLog::chunk_t) + sizeof(_trailer) == _mapSize) {
+                _index = (const FlightLog::chunk_t *)(_map + _trailer.indexOffset);
+            }
+            else {
+                recover();
+            }
+
+            return true;
+        }
+
+    public:
+
+        FlightLogReader(const char * path)
+        {
+            if (!mapFile(path) || !validate()) {
+                unmap();
+                return;
+            }
+
+            _open = true;
+        }
+
+        ~FlightLogReader(void)
+        {
+            unmap();
+
+            delete[] _columns;
+        }
+
+        bool isOpen(void)
+        {
+            return _open;
+        }
+
+        // True if the log wasn't closed, so its index had to be rebuilt
+        bool wasRecovered(void)
+        {
+            return _wasRecovered;
+        }
+
+        const char * getMessage(void)
+        {
+            return _message;
+        }
+
+        uint8_t getMotorCount(void)
+        {
+            return _header.motorCount;
+        }
+
+        uint8_t getColumnCount(void)
+        {
+            return _header.columnCount;
+        }
+
+        uint8_t getEncoding(void)
+        {
+            return _header.encoding;
+        }
+
+        uint64_t getSampleCount(void)
+        {
+            return _trailer.sampleCount;
+        }
+
+        uint32_t getChunkCount(void)
+        {
+            return _trailer.chunkCount;
+        }
+
+        // Chunk offset, size and per-column minimum and maximum, for skipping chunks without decoding them
+        const FlightLog::chunk_t & getChunk(uint32_t index)
+        {
+            return _index[index];
+        }
+
+        double getStartTime(void)
+        {
+            return _trailer.chunkCount ? _index[0].minimum[FlightLog::COL_TIME] : 0;
+        }
+
+        double getEndTime(void)
+        {
+            return _trailer.chunkCount ? _index[_trailer.chunkCount-1].maximum[FlightLog::COL_TIME] : 0;
+        }
+
+        /**
+         * Decodes a chunk, unless it is the one decoded last.
+         *
+         * @return the chunk's columns, CHUNK_SIZE values apart, or NULL if the chunk is corrupt
+         */
+        const double * decodeChunk(uint32_t index)
+        {
+            if (index >= _trailer.chunkCount) return NULL;
+
+            if (_decodedChunk == index) return _columns;
+
+            _decodedChunk = -1;
+
+            const FlightLog::chunk_t & chunk = _index[index];
+
+            if (chunk.offset + chunk.size > _mapSize) return NULL;
+
+            uint32_t count = 0;
+            if (decodeAt(chunk.offset, chunk.offset + chunk.size, count) != chunk.size || count != chunk.count) {
+                return NULL;
+            }
+
+            _decodedChunk = index;
+
+            return _columns;
+        }
+
+        /**
+         * Finds the last sample at or before a time (or the first sample, for earlier times).
+         * Binary-searches the index, then the time column of one chunk.
+         *
+         * @return sample number
+         */
+        uint64_t seek(double time)
+        {
+            if (_trailer.chunkCount == 0) return 0;
+
+            // Last chunk starting at or before time
+            uint32_t lo = 0, hi = _trailer.chunkCount;
+            while (hi - lo > 1) {
+                uint32_t mid = (lo + hi) / 2;
+                if (_index[mid].minimum[FlightLog::COL_TIME] <= time) lo = mid; else hi = mid;
+            }
+
+            const double * columns = decodeChunk(lo);
+            if (!columns) return _index[lo].firstSample;
+
+            const double * times = &columns[FlightLog::COL_TIME*FlightLog::CHUNK_SIZE];
+
+            uint32_t first = 0, last = _index[lo].count;
+            while (last - first > 1) {
+                uint32_t mid = (first + last) / 2;
+                if (times[mid] <= time) first = mid; else last = mid;
+            }
+
+            return _index[lo].firstSample + first;
+        }
+
+        /**
+         * Reads one sample.
+         *
+         * @param sample sample number
+         * @param time sample time (output)
+         * @param state vehicle state (output)
+         * @param motors motor values, or NULL (output)
+         * @return false if sample is out of range or its chunk is corrupt
+         */
+        bool read(uint64_t sample, double & time, Dynamics::state_t & state, double * motors)
+        {
+            if (sample >= _trailer.sampleCount) return false;
+
+            // Chunks are full except perhaps the last
+            uint32_t index = (uint32_t)(sample / FlightLog::CHUNK_SIZE);
+            uint32_t offset = (uint32_t)(sample % FlightLog::CHUNK_SIZE);
+
+            const double * columns = decodeChunk(index);
+            if (!columns) return false;
+
+            double row[FlightLog::MAX_COLUMNS] = {};
+            for (uint8_t c=0; c<_header.columnCount; ++c) {
+                row[c] = columns[c*FlightLog::CHUNK_SIZE + offset];
+            }
+
+            FlightLog::fromRow(row, _header.motorCount, time, state, motors);
+
+            return true;
+        }
+
+}; // class FlightLogReader
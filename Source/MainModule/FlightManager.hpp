@@ -10,19 +10,51 @@
 
 #include "dynamics/Dynamics.hpp"
 #include "ThreadedManager.hpp"
+#include "FlightRecorder.hpp"
+#include "DelayLine.hpp"
+
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
 
 class FFlightManager : public FThreadedManager {
 
     private:
 
         // Current motor values from PID controller
-        double * _motorvals = NULL; 
+        double _motorvals[Dynamics::MAX_MOTORS] = {};
+
+        // Motor values reaching the dynamics, after any motor delay
+        double _appliedMotorvals[Dynamics::MAX_MOTORS] = {};
         
         // For computing deltaT
         double   _previousTime = 0;
 
         bool _running = false;
 
+        // Records every step when running with -FlightRecorder=<file> and/or -FlightLog=<file>
+        FlightRecorder * _recorder = NULL;
+
+        // Sensor-to-controller and controller-to-motor delays, with -SensorDelay=<delay> and -MotorDelay=<delay>
+        DelayLine * _sensorDelay = NULL;
+        DelayLine * _motorDelay = NULL;
+
+        // Parses a delay given in steps (e.g. 4) or seconds (e.g. 0.002s or 2ms)
+        DelayLine * parseDelay(const TCHAR * option, uint32_t width)
+        {
+            FString value;
+            if (!FParse::Value(FCommandLine::Get(), option, value)) return NULL;
+
+            if (value.EndsWith(TEXT("ms"))) {
+                return new DelayLine(width, FCString::Atod(*value.LeftChop(2)) / 1000, DELAY_CAPACITY);
+            }
+
+            if (value.EndsWith(TEXT("s"))) {
+                return new DelayLine(width, FCString::Atod(*value.LeftChop(1)), DELAY_CAPACITY);
+            }
+
+            return new DelayLine(width, (uint32_t)FCString::Atoi(*value));
+        }
+
         /**
          * Flight-control method running repeatedly on its own thread.  
          * Override this method to implement your own flight controller.
@@ -33,6 +65,15 @@ class FFlightManager : public FThreadedManager {
          *
          */
         virtual void getMotors(const double time, const Dynamics::state_t & state, double * motorvals)  = 0;
+
+        /**
+         * Override this method to have the flight recorder log your controller's inputs.
+         *
+         * @param inputs throttle, roll, pitch, yaw, aux1, aux2 (output)
+         */
+        virtual void getInputs(double inputs[FlightRecorder::INPUT_COUNT])
+        {
+        }
         
     protected:
 
@@ -46,9 +87,6 @@ class FFlightManager : public FThreadedManager {
         FFlightManager(Dynamics * dynamics) 
             : FThreadedManager()
         {
-            // Allocate array for motor values
-            _motorvals = new double[dynamics->motorCount()]();
-
             // Store dynamics for performTask()
             _dynamics = dynamics;
 
@@ -59,6 +97,26 @@ class FFlightManager : public FThreadedManager {
             _previousTime = 0;
 
             _running = true;
+
+            FString recordPath, logPath;
+            bool haveRecordPath = FParse::Value(FCommandLine::Get(), TEXT("FlightRecorder="), recordPath);
+            bool haveLogPath = FParse::Value(FCommandLine::Get(), TEXT("FlightLog="), logPath);
+
+            // The columnar log is written from the recorder, which needs a file of its own; without
+            // -FlightRecorder=, that ring only has to hold the records between flushes
+            uint32_t capacity = FlightRecorder::DEFAULT_CAPACITY;
+
+            if (haveLogPath && !haveRecordPath) {
+                recordPath = logPath + TEXT(".rec");
+                capacity = FlightRecorder::LOG_CAPACITY;
+            }
+
+            if (haveRecordPath || haveLogPath) {
+                startRecording(TCHAR_TO_ANSI(*recordPath), haveLogPath ? TCHAR_TO_ANSI(*logPath) : NULL, capacity);
+            }
+
+            _sensorDelay = parseDelay(TEXT("SensorDelay="), sizeof(Dynamics::state_t) / sizeof(double));
+            _motorDelay = parseDelay(TEXT("MotorDelay="), _motorCount);
         }
 
         // Called repeatedly on worker thread to compute dynamics and run flight controller (PID)
@@ -70,7 +128,7 @@ class FFlightManager : public FThreadedManager {
 			double dt = currentTime - _previousTime;
 
             // Send current motor values and time delay to dynamics
-            _dynamics->setMotors(_motorvals, dt);
+            _dynamics->setMotors(_appliedMotorvals, dt);
 
             // Update dynamics
             _dynamics->update(dt);
@@ -78,14 +136,52 @@ class FFlightManager : public FThreadedManager {
             // Get new vehicle state
             _state = _dynamics->getState();
 
+            // The controller sees the state as delayed by its sensors
+            Dynamics::state_t sensedState = _state;
+            if (_sensorDelay) {
+                _sensorDelay->push(currentTime, (double *)&_state, (double *)&sensedState);
+            }
+
             // PID controller: update the flight manager (e.g., HackflightManager) with
             // the dynamics state, getting back the motor values
-            this->getMotors(currentTime, _state, _motorvals);
+            this->getMotors(currentTime, sensedState, _motorvals);
+
+            // The motors see the controller's values as delayed by the ESCs; either way, they take effect next step
+            if (_motorDelay) {
+                _motorDelay->push(currentTime, _motorvals, _appliedMotorvals);
+            }
+            else {
+                memcpy(_appliedMotorvals, _motorvals, _motorCount * sizeof(double));
+            }
+
+            // Log this step; just a copy into the recorder's memory-mapped file
+            if (_recorder) {
+                double inputs[FlightRecorder::INPUT_COUNT] = {};
+                this->getInputs(inputs);
+                _recorder->record(currentTime, _state, _motorvals, inputs);
+            }
 
             // Track previous time for deltaT
             _previousTime = currentTime;
         }
 
+        // Starts recording every step to a file; call from a subclass constructor, before flight begins
+        void startRecording(const char * path, const char * logPath=NULL, uint32_t capacity=FlightRecorder::DEFAULT_CAPACITY)
+        {
+            if (_recorder) return;
+
+            _recorder = new FlightRecorder(path, _motorCount, capacity, logPath);
+
+            if (_recorder->getMessage()[0]) {
+                error("FLIGHT RECORDER: %s", _recorder->getMessage());
+            }
+
+            if (!_recorder->isOpen()) {
+                delete _recorder;
+                _recorder = NULL;
+            }
+        }
+
         // Supports subclasses that might need direct access to dynamics state vector
         double * getVehicleStateVector(void)
         {
@@ -94,10 +190,18 @@ class FFlightManager : public FThreadedManager {
 
     public:
 
-        static const uint8_t MAX_MOTORS = 16;
+        static const uint8_t MAX_MOTORS = Dynamics::MAX_MOTORS;
+
+        // Most physics steps a delay given in seconds can span
+        static const uint32_t DELAY_CAPACITY = 1 << 14;
 
         ~FFlightManager(void)
         {
+            // Writes the final footer
+            delete _recorder;
+
+            delete _sensorDelay;
+            delete _motorDelay;
         }
 
         // Called by VehiclePawn::Tick() method to propeller animation/sound (motorvals)
@@ -105,7 +209,7 @@ class FFlightManager : public FThreadedManager {
         {
             // Get motor values for propeller animation / motor sound
             for (uint8_t j=0; j<_motorCount; ++j) {
-                motorvals[j] = _motorvals[j];
+                motorvals[j] = _appliedMotorvals[j];
             }
         }
 
@@ -0,0 +1,526 @@
+/*
+ * Flight recorder for MulticopterSim
+ *
+ * Appends every physics step (time, vehicle state, motor values and
+ * controller inputs) to a preallocated, memory-mapped ring file.  Recording
+ * from the flight thread is just a copy into the mapping: no system calls, no
+ * allocation and no locks.  A background thread flushes newly written pages
+ * to disk and maintains a footer holding the record count and a coarse time
+ * index, so a reader can find its way around a file left behind by a crash.
+ * Given a log path, the flush thread also copies each record's state and
+ * motors into a compact, columnar FlightLog for analysis and replay.
+ *
+ * File layout (all values little-endian):
+ *
+ *   header_t                        at offset 0, padded to HEADER_SIZE
+ *   capacity records                ring of fixed-size records
+ *   two footer_t + index_t arrays   at header.footerOffset, footerSize apart
+ *
+ * A record is a uint64_t stamp, its record number plus one, followed by
+ * doubles: time, the fields of Dynamics::state_t, motor values and controller
+ * inputs.  Stamps are never zero, so a slot never written matches no record.  Once the ring
+ * fills, new records overwrite the oldest.  Footers are written alternately,
+ * so one of them is always intact; readers should take the valid footer with
+ * the larger generation.  Index entry k gives the record number and time of
+ * the record in ring slot k * indexStride.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "Runnable.h"
+#include "FlightLog.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef _WIN32
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class FlightRecorder : public FRunnable {
+
+    public:
+
+        static const uint32_t MAGIC        = 0x5246534d; // "MSFR"
+        static const uint32_t FOOTER_MAGIC = 0x5846534d; // "MSFX"
+        static const uint32_t VERSION      = 3;
+
+        static const uint8_t STATE_SIZE  = sizeof(Dynamics::state_t) / sizeof(double);
+        static const uint8_t INPUT_COUNT = 6;   // throttle, roll, pitch, yaw, aux1, aux2
+
+        static const uint32_t HEADER_SIZE  = 4096;
+        static const uint32_t INDEX_STRIDE = 1024;
+
+        // About two minutes at 8 kHz, or a quarter hour at 1 kHz
+        static const uint32_t DEFAULT_CAPACITY = 1 << 20;
+
+        // For a ring that only feeds a FlightLog: a few of its chunks, several flush periods even at 8 kHz
+        static const uint32_t LOG_CAPACITY = 8 * FlightLog::CHUNK_SIZE;
+
+        typedef struct {
+
+            uint32_t magic;
+            uint32_t version;
+            uint32_t recordSize;    // bytes
+            uint32_t capacity;      // records; a power of two
+            uint8_t  stateSize;
+            uint8_t  motorCount;
+            uint8_t  inputCount;
+            uint8_t  reserved;
+            uint32_t indexStride;
+            uint64_t footerOffset;  // bytes from start of file
+            uint64_t footerSize;    // bytes per footer, including its index
+
+        } header_t;
+
+        typedef struct {
+
+            uint32_t magic;
+            uint32_t checksum;      // of everything after this field, through the end of the index
+            uint64_t generation;
+            uint64_t recordCount;   // records ever written; the ring holds the last min(recordCount, capacity)
+            double   firstTime;     // time of oldest record still in the ring
+            double   lastTime;      // time of newest record
+            uint32_t indexCount;    // valid index entries
+            uint32_t reserved;
+
+        } footer_t;
+
+        typedef struct {
+
+            uint64_t record;
+            double   time;
+
+        } index_t;
+
+    private:
+
+        static constexpr double FLUSH_PERIOD = 0.1; // seconds
+
+        header_t _header = {};
+
+        uint8_t * _map = NULL;
+        uint64_t  _mapSize = 0;
+        uint8_t * _records = NULL;
+
+        uint32_t _mask = 0;
+
+        // Written only by the flight thread; read by the flush thread
+        std::atomic<uint64_t> _recordCount;
+
+        // Owned by the flush thread
+        uint64_t _flushedCount = 0;
+        uint64_t _generation = 0;
+        index_t * _index = NULL;
+        FlightLogWriter * _log = NULL;
+
+        FRunnableThread * _thread = NULL;
+        std::atomic<bool> _running;
+
+        char _message[200] = {};
+
+#ifdef _WIN32
+        HANDLE _file = INVALID_HANDLE_VALUE;
+        HANDLE _mapping = NULL;
+#else
+        int _fd = -1;
+#endif
+
+        static uint64_t roundUp(uint64_t size, uint64_t alignment)
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        // FNV-1a is plenty to spot a footer torn by a crash
+        static uint32_t checksum(const uint8_t * data, uint64_t size)
+        {
+            uint32_t hash = 2166136261u;
+
+            for (uint64_t k=0; k<size; ++k) {
+                hash = (hash ^ data[k]) * 16777619u;
+            }
+
+            return hash;
+        }
+
+        // What the first field of a record holds
+        static uint64_t stamp(uint64_t record)
+        {
+            return record + 1;
+        }
+
+        uint8_t * slot(uint64_t record)
+        {
+            return _records + (record & _mask) * _header.recordSize;
+        }
+
+        // Reads a record's time, returning false if the flight thread has started overwriting the record
+        bool recordTime(uint64_t record, double & time)
+        {
+            const uint8_t * src = slot(record);
+
+            memcpy(&time, src + sizeof(uint64_t), sizeof(double));
+
+            // The flight thread writes the stamp before the rest, so check it afterward
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            uint64_t number = 0;
+            memcpy(&number, src, sizeof(uint64_t));
+
+            return number == stamp(record);
+        }
+
+        bool mapFile(const char * path)
+        {
+#ifdef _WIN32
+            _file = CreateFileA(path, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                    FILE_ATTRIBUTE_NORMAL, NULL);
+            if (_file == INVALID_HANDLE_VALUE) {
+                sprintf_s(_message, "CreateFile(%s) failed", path);
+                return false;
+            }
+
+            // Sizing the mapping sizes (and allocates) the file
+            _mapping = CreateFileMappingA(_file, NULL, PAGE_READWRITE, (DWORD)(_mapSize >> 32), (DWORD)_mapSize, NULL);
+            if (!_mapping) {
+                sprintf_s(_message, "CreateFileMapping() failed");
+                return false;
+            }
+
+            _map = (uint8_t *)MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)_mapSize);
+            if (!_map) {
+                sprintf_s(_message, "MapViewOfFile() failed");
+                return false;
+            }
+
+            // Fault every page in now rather than on the flight thread
+            for (uint64_t offset=0; offset<_mapSize; offset+=4096) {
+                _map[offset] = 0;
+            }
+#else
+            _fd = open(path, O_RDWR|O_CREAT|O_TRUNC, 0644);
+            if (_fd < 0) {
+                snprintf(_message, sizeof(_message), "open(%s) failed", path);
+                return false;
+            }
+
+            // Reserve the disk space now, so a full disk can't fault a write into the mapping later
+            if (posix_fallocate(_fd, 0, (off_t)_mapSize) != 0) {
+                snprintf(_message, sizeof(_message), "posix_fallocate() failed");
+                return false;
+            }
+
+            int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+            // Fault every page in now rather than on the flight thread
+            flags |= MAP_POPULATE;
+#endif
+            void * map = mmap(NULL, (size_t)_mapSize, PROT_READ|PROT_WRITE, flags, _fd, 0);
+            if (map == MAP_FAILED) {
+                snprintf(_message, sizeof(_message), "mmap() failed");
+                return false;
+            }
+
+            _map = (uint8_t *)map;
+#endif
+            return true;
+        }
+
+        // Writes a range of the mapping through to disk
+        void sync(uint64_t offset, uint64_t size)
+        {
+            if (size == 0) return;
+
+            // Both platforms want a page-aligned start
+            uint64_t start = offset / 4096 * 4096;
+            size += offset - start;
+
+#ifdef _WIN32
+            FlushViewOfFile(_map + start, (SIZE_T)size);
+#else
+            msync(_map + start, (size_t)size, MS_SYNC);
+#endif
+        }
+
+        // Syncs the records written since the last flush, then updates the index and writes a footer
+        void flush(void)
+        {
+            uint64_t count = _recordCount.load(std::memory_order_acquire);
+
+            if (count == _flushedCount) return;
+
+            uint64_t capacity = _header.capacity;
+
+            // Records overwritten before we got to them are gone anyway
+            uint64_t first = (count - _flushedCount > capacity) ? count - capacity : _flushedCount;
+
+            uint64_t begin = first & _mask;
+            uint64_t end = begin + (count - first);
+
+            if (end <= capacity) {
+                sync(HEADER_SIZE + begin * _header.recordSize, (end - begin) * _header.recordSize);
+            }
+            else {
+                sync(HEADER_SIZE + begin * _header.recordSize, (capacity - begin) * _header.recordSize);
+                sync(HEADER_SIZE, (end - capacity) * _header.recordSize);
+            }
+
+            if (_log) {
+                appendToLog(first, count);
+            }
+
+            // Index the chunks that started since the last flush
+            uint64_t chunk = (first + INDEX_STRIDE - 1) / INDEX_STRIDE * INDEX_STRIDE;
+            for (; chunk < count; chunk += INDEX_STRIDE) {
+                index_t & entry = _index[(chunk & _mask) / INDEX_STRIDE];
+                entry.record = chunk;
+                recordTime(chunk, entry.time);
+            }
+
+            // When the ring is full the flight thread may be overwriting the oldest records as we
+            // read, so the first time comes from the oldest record it hasn't reached yet
+            footer_t footer = {};
+
+            for (uint64_t oldest = count > capacity ? count - capacity : 0; oldest < count; ++oldest) {
+                if (recordTime(oldest, footer.firstTime)) break;
+            }
+
+            recordTime(count - 1, footer.lastTime);
+
+            footer.magic = FOOTER_MAGIC;
+            footer.generation = ++_generation;
+            footer.recordCount = count;
+            footer.indexCount = (uint32_t)((count < capacity ? count + INDEX_STRIDE - 1 : capacity) / INDEX_STRIDE);
+
+            // Alternate footers, so a crash part-way through leaves the other one intact
+            uint64_t offset = _header.footerOffset + (_generation & 1) * _header.footerSize;
+            uint8_t * dst = _map + offset;
+
+            uint32_t indexBytes = (_header.capacity / INDEX_STRIDE) * sizeof(index_t);
+            memcpy(dst + sizeof(footer_t), _index, indexBytes);
+            memcpy(dst, &footer, sizeof(footer_t));
+
+            footer.checksum = checksum(dst + 2*sizeof(uint32_t), sizeof(footer_t) - 2*sizeof(uint32_t) + indexBytes);
+            memcpy(dst, &footer, sizeof(footer_t));
+
+            sync(offset, _header.footerSize);
+
+            _flushedCount = count;
+        }
+
+        // Copies records into the columnar log, skipping any the flight thread has already overwritten
+        void appendToLog(uint64_t first, uint64_t count)
+        {
+            for (uint64_t record=first; record<count; ++record) {
+
+                const uint8_t * src = slot(record);
+
+                double values[1 + STATE_SIZE + FlightLog::MAX_MOTORS] = {};
+                memcpy(values, src + sizeof(uint64_t), (1 + STATE_SIZE + _header.motorCount) * sizeof(double));
+
+                // As in recordTime(), the stamp is checked after the values
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+                uint64_t number = 0;
+                memcpy(&number, src, sizeof(uint64_t));
+                if (number != stamp(record)) continue;
+
+                Dynamics::state_t state = {};
+                memcpy(&state, &values[1], sizeof(state));
+
+                _log->append(values[0], state, &values[1 + STATE_SIZE]);
+            }
+        }
+
+        void unmap(void)
+        {
+#ifdef _WIN32
+            if (_map) UnmapViewOfFile(_map);
+            if (_mapping) CloseHandle(_mapping);
+            if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+            _mapping = NULL;
+            _file = INVALID_HANDLE_VALUE;
+#else
+            if (_map) munmap(_map, (size_t)_mapSize);
+            if (_fd >= 0) ::close(_fd);
+            _fd = -1;
+#endif
+            _map = NULL;
+            _records = NULL;
+        }
+
+    public:
+
+        /**
+         * Creates (or overwrites) a recording file, and starts its flush thread.
+         *
+         * @param path file to record to
+         * @param motorCount number of motor values per record
+         * @param capacity records to keep; rounded up to a power of two, and at least INDEX_STRIDE
+         * @param logPath columnar log to write as well, or NULL
+         */
+        FlightRecorder(const char * path, uint8_t motorCount, uint32_t capacity=DEFAULT_CAPACITY, const char * logPath=NULL)
+        {
+            _recordCount = 0;
+            _running = false;
+
+            uint32_t size = INDEX_STRIDE;
+            while (size < capacity && size < 0x80000000u) {
+                size <<= 1;
+            }
+
+            _mask = size - 1;
+
+            _header.magic = MAGIC;
+            _header.version = VERSION;
+            _header.recordSize = (uint32_t)(sizeof(uint64_t) + (1 + STATE_SIZE + motorCount + INPUT_COUNT) * sizeof(double));
+            _header.capacity = size;
+            _header.stateSize = STATE_SIZE;
+            _header.motorCount = motorCount;
+            _header.inputCount = INPUT_COUNT;
+            _header.indexStride = INDEX_STRIDE;
+            _header.footerOffset = roundUp(HEADER_SIZE + (uint64_t)size * _header.recordSize, 4096);
+            _header.footerSize = roundUp(sizeof(footer_t) + (size / INDEX_STRIDE) * sizeof(index_t), 4096);
+
+            _mapSize = _header.footerOffset + 2 * _header.footerSize;
+
+            if (!mapFile(path)) {
+                unmap();
+                return;
+            }
+
+            memcpy(_map, &_header, sizeof(header_t));
+            sync(0, HEADER_SIZE);
+
+            _records = _map + HEADER_SIZE;
+
+            _index = new index_t [size / INDEX_STRIDE]();
+
+            if (logPath) {
+                _log = new FlightLogWriter(logPath, motorCount);
+                if (!_log->isOpen()) {
+                    snprintf(_message, sizeof(_message), "FlightLog: %.180s", _log->getMessage());
+                    delete _log;
+                    _log = NULL;
+                }
+            }
+
+            _running = true;
+
+            _thread = FRunnableThread::Create(this, TEXT("FlightRecorder"), 0, TPri_Lowest);
+        }
+
+        ~FlightRecorder(void)
+        {
+            close();
+
+            delete[] _index;
+            delete _log;
+        }
+
+        /**
+         * Appends one record.  Call from one thread only (the flight thread).
+         *
+         * @param time simulation time in seconds
+         * @param state vehicle state
+         * @param motors motor values (motorCount values)
+         * @param inputs controller inputs (INPUT_COUNT values)
+         */
+        void record(double time, const Dynamics::state_t & state, const double * motors, const double * inputs)
+        {
+            if (!_records) return;
+
+            uint64_t count = _recordCount.load(std::memory_order_relaxed);
+
+            uint8_t * dst = slot(count);
+
+            uint64_t number = stamp(count);
+            memcpy(dst, &number, sizeof(uint64_t));
+            dst += sizeof(uint64_t);
+
+            // The stamp lands before the rest, so the flush thread can tell a record being overwritten
+            std::atomic_thread_fence(std::memory_order_release);
+
+            memcpy(dst, &time, sizeof(double));
+            dst += sizeof(double);
+
+            memcpy(dst, &state, STATE_SIZE*sizeof(double));
+            dst += STATE_SIZE*sizeof(double);
+
+            memcpy(dst, motors, _header.motorCount*sizeof(double));
+            dst += _header.motorCount*sizeof(double);
+
+            memcpy(dst, inputs, INPUT_COUNT*sizeof(double));
+
+            // Publish the record to the flush thread
+            _recordCount.store(count + 1, std::memory_order_release);
+        }
+
+        // Stops the flush thread, writes a final footer, and closes the file
+        void close(void)
+        {
+            if (_thread) {
+                _running = false;
+                _thread->WaitForCompletion();
+                delete _thread;
+                _thread = NULL;
+            }
+
+            if (_records) {
+                flush();
+            }
+
+            if (_log) {
+                _log->close();
+            }
+
+            unmap();
+        }
+
+        bool isOpen(void)
+        {
+            return _records != NULL;
+        }
+
+        uint64_t getRecordCount(void)
+        {
+            return _recordCount.load(std::memory_order_relaxed);
+        }
+
+        const char * getMessage(void)
+        {
+            return _message;
+        }
+
+        // FRunnable interface.
+
+        virtual uint32_t Run() override
+        {
+            while (_running) {
+
+                FPlatformProcess::Sleep(FLUSH_PERIOD);
+
+                flush();
+            }
+
+            return 0;
+        }
+
+        virtual void Stop() override
+        {
+            _running = false;
+        }
+
+}; // class FlightRecorder
@@ -0,0 +1,153 @@
+/*
+ * Simple hover controller for vehicles flown without a flight manager
+ *
+ * Altitude PID, position PD over the spot where the vehicle started, and
+ * attitude PD, inverted through the frame's mixer to get motor values.  One
+ * controller serves any number of vehicles of the same frame and parameters;
+ * each vehicle keeps its own altitude integral.
+ *
+ * This file has no Unreal Engine dependencies.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "dynamics/Dynamics.hpp"
+
+#include <math.h>
+
+class HoverController {
+
+    public:
+
+        typedef struct {
+
+            double altP = 2.0;
+            double altI = 0.5;
+            double altD = 2.5;
+            double posP = 0.2;      // zero to leave position free
+            double posD = 0.5;
+            double attP = 25.0;
+            double attD = 8.0;
+            double yawD = 2.0;
+
+            double maxTilt = 0.3;   // radians, for holding position
+
+        } gains_t;
+
+    private:
+
+        static constexpr double GRAVITY = 9.80665;
+
+        gains_t _gains;
+
+        const Dynamics::Parameters * _params = NULL;
+
+        uint8_t _motorCount = 0;
+
+        double _mixer[Dynamics::MAX_MOTORS][3] = {};
+        double _mixerNorm[3] = {};
+
+        static double clip(double value, double limit)
+        {
+            return value < -limit ? -limit : value > limit ? limit : value;
+        }
+
+    public:
+
+        HoverController(void)
+        {
+        }
+
+        /**
+         * @param gains controller gains
+         * @param dynamics any vehicle of the frame to be flown, for its mixer
+         * @param params vehicle parameters, read on each call to control() so they can change between flights
+         */
+        HoverController(const gains_t & gains, Dynamics * dynamics, const Dynamics::Parameters * params)
+        {
+            _gains = gains;
+            _params = params;
+            _motorCount = dynamics->motorCount();
+
+            const double * mixer = dynamics->getMixer();
+
+            for (uint8_t k=0; k<_motorCount; ++k) {
+                for (uint8_t j=0; j<3; ++j) {
+                    _mixer[k][j] = mixer[3*k+j];
+                    _mixerNorm[j] += _mixer[k][j] * _mixer[k][j];
+                }
+            }
+        }
+
+        /**
+         * Computes motor values.
+         *
+         * @param state vehicle state, with location relative to the spot to hold
+         * @param altitude height above ground, m
+         * @param target altitude to hold, m
+         * @param altIntegral vehicle's altitude-error integral, zero at the start of a flight (updated)
+         * @param dt seconds since the last call
+         * @param motorvals output, in [0,1]
+         */
+        void control(const Dynamics::state_t & state, double altitude, double target, double & altIntegral,
+                double dt, double * motorvals)
+        {
+            const gains_t & g = _gains;
+            const Dynamics::Parameters & p = *_params;
+
+            double phi = state.pose.rotation[0];
+            double theta = state.pose.rotation[1];
+            double psi = state.pose.rotation[2];
+
+            double climb = -state.inertialVel[2];
+            double error = target - altitude;
+
+            altIntegral += error * dt;
+
+            double accel = g.altP*error - g.altD*climb + g.altI*altIntegral;
+
+            double tilt = cos(phi) * cos(theta);
+            double U1 = p.m * (GRAVITY + accel) / (tilt > 0.5 ? tilt : 0.5);
+
+            // Hold the starting spot once clear of the ground: desired acceleration north and east,
+            // rotated into the vehicle's heading and turned into pitch and roll
+            double phiTarget = 0;
+            double thetaTarget = 0;
+
+            if (altitude > 0.1) {
+
+                double north = -g.posP*state.pose.location[0] - g.posD*state.inertialVel[0];
+                double east = -g.posP*state.pose.location[1] - g.posD*state.inertialVel[1];
+
+                double forward = cos(psi)*north + sin(psi)*east;
+                double right = -sin(psi)*north + cos(psi)*east;
+
+                thetaTarget = clip(-forward / GRAVITY, g.maxTilt);
+                phiTarget = clip(right / GRAVITY, g.maxTilt);
+            }
+
+            // theta'' carries a minus sign in Dynamics::computeStateDerivative
+            double U2 = p.Ix * (g.attP*(phiTarget - phi) - g.attD*state.angularVel[0]);
+            double U3 = -p.Iy * (g.attP*(thetaTarget - theta) - g.attD*state.angularVel[1]);
+            double U4 = p.Iz * (-g.yawD*state.angularVel[2]);
+
+            double omegaMax = p.maxrpm * 3.14159 / 30;
+
+            for (uint8_t k=0; k<_motorCount; ++k) {
+
+                double omega2 = U1 / (_motorCount * p.b) +
+                    _mixer[k][0] * U2 / (p.l * p.b * _mixerNorm[0]) +
+                    _mixer[k][1] * U3 / (p.l * p.b * _mixerNorm[1]) +
+                    _mixer[k][2] * U4 / (p.d * _mixerNorm[2]);
+
+                double motor = omega2 > 0 ? sqrt(omega2) / omegaMax : 0;
+
+                motorvals[k] = motor < 1 ? motor : 1;
+            }
+        }
+
+}; // class HoverController
@@ -0,0 +1,79 @@
+/*
+ * Pool of camera render targets for MulticopterSim
+ *
+ * Render targets are created at runtime on first use, for any resolution,
+ * and returned to the pool when their camera goes away, so that respawned
+ * pawns reuse them instead of allocating new GPU memory.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "Engine/TextureRenderTarget2D.h"
+
+class RenderTargetPool {
+
+    private:
+
+        // Idle render targets, keyed by resolution
+        static TMap<uint32, TArray<UTextureRenderTarget2D *>> & idle(void)
+        {
+            static TMap<uint32, TArray<UTextureRenderTarget2D *>> _idle;
+            return _idle;
+        }
+
+        static uint32 key(uint16_t cols, uint16_t rows)
+        {
+            return ((uint32)cols << 16) | rows;
+        }
+
+    public:
+
+        /**
+         * Gets an idle render target of the requested size, creating one if none is available.
+         * Must be called on game thread.
+         */
+        static UTextureRenderTarget2D * acquire(uint16_t cols, uint16_t rows)
+        {
+            TArray<UTextureRenderTarget2D *> * available = idle().Find(key(cols, rows));
+
+            if (available && available->Num() > 0) {
+                return available->Pop();
+            }
+
+            UTextureRenderTarget2D * target = NewObject<UTextureRenderTarget2D>(GetTransientPackage());
+
+            // BGRA matches the FColor layout returned by ReadPixels()
+            target->InitCustomFormat(cols, rows, PF_B8G8R8A8, false);
+            target->UpdateResourceImmediate(true);
+
+            // Keep it alive across level changes and pawn respawns
+            target->AddToRoot();
+
+            return target;
+        }
+
+        // Returns a render target to the pool for reuse
+        static void release(UTextureRenderTarget2D * target)
+        {
+            if (target) {
+                idle().FindOrAdd(key(target->SizeX, target->SizeY)).Push(target);
+            }
+        }
+
+        // Frees all idle render targets
+        static void purge(void)
+        {
+            for (auto & entry : idle()) {
+                for (UTextureRenderTarget2D * target : entry.Value) {
+                    target->RemoveFromRoot();
+                }
+            }
+
+            idle().Empty();
+        }
+
+}; // class RenderTargetPool
@@ -0,0 +1,255 @@
+/*
+ * Camera subclass that compresses frames and streams them to network consumers
+ *
+ * Compression runs on a small pool of encoder threads, so the game thread
+ * only copies the frame into an idle encoder's buffer.  If every encoder is
+ * still busy with an earlier frame, the new frame is dropped rather than
+ * making the game thread wait.
+ *
+ * Use Extras/camstream/camreceiver as a reference receiver.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "Camera.hpp"
+#include "Runnable.h"
+
+#include "../../Extras/camstream/FrameStream.hpp"
+
+class StreamingCamera : public Camera {
+
+    private:
+
+        static const uint8_t MAX_ENCODERS = 8;
+
+        // Worker thread that encodes one frame at a time
+        class FEncoder : public FRunnable {
+
+            private:
+
+                StreamingCamera * _camera = NULL;
+
+                FRunnableThread * _thread = NULL;
+
+                FEvent * _wake = NULL;
+
+                volatile bool _running = false;
+
+                FrameCodec _codec;
+
+                // Latest raw frame, and the previous one for DELTA encoding
+                uint8_t * _pixels = NULL;
+                uint8_t * _reference = NULL;
+                uint32_t  _referenceId = 0;
+                bool      _haveReference = false;
+
+                uint8_t * _encoded = NULL;
+
+                void encodeAndSend(void)
+                {
+                    FrameCodec::codec_t codec = _camera->_codec;
+
+                    FrameStream::chunk_header_t header = {};
+                    header.frameId = frameId;
+                    header.refFrameId = frameId;
+                    header.cols = _camera->_cols;
+                    header.rows = _camera->_rows;
+                    header.flags = FrameStream::FLAG_KEYFRAME;
+
+                    // DELTA streams send a lossless keyframe periodically so receivers can recover from loss
+                    if (codec == FrameCodec::CODEC_DELTA) {
+                        if (_haveReference && (frameId % _camera->_keyframeInterval)) {
+                            header.refFrameId = _referenceId;
+                            header.flags = 0;
+                        }
+                        else {
+                            codec = FrameCodec::CODEC_QOI;
+                        }
+                    }
+
+                    header.codec = codec;
+                    header.frameBytes = _codec.encode(codec, _pixels, _reference,
+                            _camera->_cols, _camera->_rows, _encoded, _camera->_quality);
+
+                    if (header.frameBytes) {
+                        _camera->send(header, _encoded);
+                    }
+
+                    // Current frame becomes reference for the next one
+                    if (_camera->_codec == FrameCodec::CODEC_DELTA) {
+                        uint8_t * tmp = _reference;
+                        _reference = _pixels;
+                        _pixels = tmp;
+                        _referenceId = frameId;
+                        _haveReference = true;
+                    }
+                }
+
+            public:
+
+                FThreadSafeBool busy = false;
+
+                uint32_t frameId = 0;
+
+                FEncoder(StreamingCamera * camera, uint8_t index)
+                {
+                    _camera = camera;
+
+                    uint32_t nbytes = camera->_rows * camera->_cols * 4;
+                    _pixels = new uint8_t [nbytes];
+                    _reference = new uint8_t [nbytes];
+                    _encoded = new uint8_t [FrameCodec::maxEncodedSize(camera->_cols, camera->_rows)];
+
+                    _wake = FPlatformProcess::GetSynchEventFromPool(false);
+
+                    _running = true;
+
+                    _thread = FRunnableThread::Create(this, *FString::Printf(TEXT("FrameEncoder%d"), index), 0, TPri_BelowNormal);
+                }
+
+                ~FEncoder(void)
+                {
+                    _running = false;
+                    _wake->Trigger();
+                    _thread->WaitForCompletion();
+                    delete _thread;
+
+                    FPlatformProcess::ReturnSynchEventToPool(_wake);
+
+                    delete[] _pixels;
+                    delete[] _reference;
+                    delete[] _encoded;
+                }
+
+                // Called on game thread, only when !busy
+                void submit(const uint8_t * bytes, uint32_t id)
+                {
+                    busy = true;
+                    frameId = id;
+                    FMemory::Memcpy(_pixels, bytes, _camera->_rows * _camera->_cols * 4);
+                    _wake->Trigger();
+                }
+
+                virtual uint32_t Run() override
+                {
+                    while (true) {
+
+                        _wake->Wait();
+
+                        if (!_running) break;
+
+                        encodeAndSend();
+
+                        busy = false;
+                    }
+
+                    return 0;
+                }
+
+        }; // class FEncoder
+
+        // Stream parameters, set in constructor
+        char _host[200] = {};
+        short _port = 0;
+        FrameStream::transport_t _transport = FrameStream::TRANSPORT_UDP;
+        FrameCodec::codec_t _codec = FrameCodec::CODEC_QOI;
+        uint8_t _quality = 0;
+        uint32_t _keyframeInterval = 0;
+
+        // Encoders and sender are created on first frame, so that default (CDO) objects don't spawn threads
+        FEncoder * _encoders[MAX_ENCODERS] = {};
+        uint8_t _encoderCount = 0;
+        uint8_t _nextEncoder = 0;
+
+        FrameSender * _sender = NULL;
+        FCriticalSection _sendLock;
+
+        uint32_t _frameId = 0;
+
+        void send(const FrameStream::chunk_header_t & header, const uint8_t * payload)
+        {
+            FScopeLock lock(&_sendLock);
+            _sender->send(header, payload);
+        }
+
+        void start(void)
+        {
+            _sender = new FrameSender(_host, _port, _transport);
+
+            for (uint8_t k=0; k<_encoderCount; ++k) {
+                _encoders[k] = new FEncoder(this, k);
+            }
+        }
+
+    protected:
+
+        /**
+         * @param fov field of view
+         * @param resolution image resolution
+         * @param host address of receiver
+         * @param port port of receiver
+         * @param codec compression scheme
+         * @param transport UDP (chunked datagrams) or TCP
+         * @param encoderCount size of encoder-thread pool; DELTA always uses one, because each frame depends on the last
+         * @param quality JPEG quality in [1,100]
+         * @param keyframeInterval frames between lossless keyframes in a DELTA stream
+         */
+        StreamingCamera(float fov, Resolution_t resolution, const char * host, const short port,
+                FrameCodec::codec_t codec=FrameCodec::CODEC_QOI,
+                FrameStream::transport_t transport=FrameStream::TRANSPORT_UDP,
+                uint8_t encoderCount=2, uint8_t quality=80, uint32_t keyframeInterval=30)
+            : Camera(fov, resolution)
+        {
+            SPRINTF(_host, "%s", host);
+            _port = port;
+            _transport = transport;
+            _codec = FrameCodec::supported(codec) ? codec : FrameCodec::CODEC_QOI;
+            _quality = quality;
+            _keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+
+            _encoderCount = _codec == FrameCodec::CODEC_DELTA ? 1 : FMath::Clamp<uint8_t>(encoderCount, 1, MAX_ENCODERS);
+        }
+
+        // Called on game thread by Camera::grabImage()
+        virtual void processImageBytes(uint8_t * bytes) override
+        {
+            if (!_sender) {
+                start();
+            }
+
+            _frameId++;
+
+            // Hand frame to the next idle encoder, round-robin; drop it if none is idle
+            for (uint8_t k=0; k<_encoderCount; ++k) {
+
+                FEncoder * encoder = _encoders[(_nextEncoder + k) % _encoderCount];
+
+                if (!encoder->busy) {
+                    encoder->submit(bytes, _frameId);
+                    _nextEncoder = (_nextEncoder + k + 1) % _encoderCount;
+                    return;
+                }
+            }
+
+            framesDropped++;
+        }
+
+    public:
+
+        // Frames skipped because all encoders were busy
+        uint32_t framesDropped = 0;
+
+        virtual ~StreamingCamera()
+        {
+            for (uint8_t k=0; k<_encoderCount; ++k) {
+                delete _encoders[k];
+            }
+
+            delete _sender;
+        }
+
+}; // Class StreamingCamera
@@ -0,0 +1,283 @@
+/*
+ * Swarm of vehicles stepped together, for MulticopterSim
+ *
+ * Holds any number of vehicles of one frame type.  Each is flown by a simple
+ * controller that takes off and holds the altitude given for it, over the spot
+ * where it started.  One call to step() advances them all.  Poses and motor
+ * values come out in contiguous arrays, ready for instanced rendering.
+ *
+ * Vehicles come from a config file, one setting per line, # for comments.
+ * Besides the frame, params and prop settings of a vehicle definition (see
+ * VehicleConfig.hpp), with the Phantom's parameters by default, it can have:
+ *
+ *   dt SECONDS                             physics step; 0.001 by default
+ *   vehicle X Y ALTITUDE [YAW]             a vehicle starting X m north and Y m east of the
+ *                                          swarm's origin, yaw in degrees
+ *   grid ROWS COLUMNS SPACING ALTITUDE     a block of vehicles, SPACING m apart; at most
+ *                                          MAX_GRID rows and columns
+ *
+ * The ground is taken to be flat, at the origin's height.
+ *
+ * This file has no Unreal Engine dependencies.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "VehicleConfig.hpp"
+#include "HoverController.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+class Swarm {
+
+    public:
+
+        static const uint8_t MAX_MOTORS = Dynamics::MAX_MOTORS;
+
+        static const uint32_t MAX_GRID = 1000;
+
+        typedef struct {
+
+            double x;           // m north of the swarm's origin
+            double y;           // m east
+            double altitude;    // m to hold
+            double yaw;         // radians
+
+        } spot_t;
+
+        typedef struct {
+
+            // Frame, parameters and propeller locations, shared by every vehicle
+            VehicleConfig::config_t vehicle;
+
+            double dt = 0.001;
+
+            std::vector<spot_t> spots;
+
+        } config_t;
+
+    private:
+
+        typedef struct {
+
+            Dynamics * dynamics;
+            double altitude;
+            double altIntegral;
+
+        } vehicle_t;
+
+        config_t _config;
+
+        Dynamics::Parameters _params = Dynamics::Parameters(0, 0, 0, 0, 0, 0, 0, 0, 0);
+
+        uint32_t _count = 0;
+        uint8_t _motorCount = 0;
+
+        vehicle_t * _vehicles = NULL;
+
+        Dynamics::pose_t * _poses = NULL;
+        double * _motors = NULL;
+
+        // Shared by all vehicles, since they have the same frame
+        HoverController _controller;
+
+        double _time = 0;
+
+    public:
+
+        /**
+         * Reads a config file.
+         *
+         * @param path config file
+         * @param config output
+         * @param message why the file couldn't be read (output)
+         * @param size size of message
+         * @return true on success
+         */
+        static bool readConfig(const char * path, config_t & config, char * message, size_t size)
+        {
+            FILE * fp = fopen(path, "r");
+
+            if (!fp) {
+                snprintf(message, size, "fopen(%s) failed", path);
+                return false;
+            }
+
+            bool ok = true;
+
+            char line[256] = {};
+
+            for (uint32_t lineno=1; ok && fgets(line, sizeof(line), fp); ++lineno) {
+
+                char * hash = strchr(line, '#');
+                if (hash) *hash = 0;
+
+                int8_t parsed = VehicleConfig::parseLine(line, config.vehicle);
+
+                char name[64] = {};
+                double v[4] = {};
+
+                int n = sscanf(line, "%63s %lf %lf %lf %lf", name, &v[0], &v[1], &v[2], &v[3]);
+
+                if (n <= 0) continue;
+
+                // Frame, params or prop
+                if (parsed) {
+                    ok = parsed > 0;
+                }
+
+                else if (!strcmp(name, "dt") && n == 2 && v[0] > 0) {
+                    config.dt = v[0];
+                }
+
+                else if (!strcmp(name, "vehicle") && n >= 4) {
+                    spot_t spot = {v[0], v[1], v[2], v[3] * M_PI / 180};
+                    config.spots.push_back(spot);
+                }
+
+                else if (!strcmp(name, "grid") && n == 5 &&
+                        v[0] >= 1 && v[0] <= MAX_GRID && v[1] >= 1 && v[1] <= MAX_GRID && v[2] > 0) {
+                    for (uint32_t r=0; r<(uint32_t)v[0]; ++r) {
+                        for (uint32_t c=0; c<(uint32_t)v[1]; ++c) {
+                            spot_t spot = {r * v[2], c * v[2], v[3], 0};
+                            config.spots.push_back(spot);
+                        }
+                    }
+                }
+
+                else {
+                    ok = false;
+                }
+
+                if (!ok) {
+                    snprintf(message, size, "%.150s line %u: bad setting", path, lineno);
+                }
+            }
+
+            fclose(fp);
+
+            if (ok && config.spots.empty()) {
+                snprintf(message, size, "%.150s has no vehicles", path);
+                ok = false;
+            }
+
+            return ok;
+        }
+
+        Swarm(const config_t & config)
+        {
+            _config = config;
+
+            const double * p = config.vehicle.params;
+            _params = Dynamics::Parameters(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], (uint16_t)p[8]);
+
+            _count = (uint32_t)config.spots.size();
+
+            _vehicles = new vehicle_t [_count]();
+
+            for (uint32_t k=0; k<_count; ++k) {
+
+                vehicle_t & vehicle = _vehicles[k];
+
+                vehicle.dynamics = VehicleConfig::createDynamics(config.vehicle.frame, &_params);
+                vehicle.altitude = config.spots[k].altitude;
+
+                double rotation[3] = {0, 0, config.spots[k].yaw};
+                vehicle.dynamics->init(rotation);
+            }
+
+            _motorCount = _count ? _vehicles[0].dynamics->motorCount() : 0;
+
+            if (_count) {
+                _controller = HoverController(HoverController::gains_t(), _vehicles[0].dynamics, &_params);
+            }
+
+            _poses = new Dynamics::pose_t [_count]();
+            _motors = new double [_count * _motorCount]();
+
+            for (uint32_t k=0; k<_count; ++k) {
+                _poses[k] = _vehicles[k].dynamics->getPose();
+            }
+        }
+
+        ~Swarm(void)
+        {
+            for (uint32_t k=0; k<_count; ++k) {
+                delete _vehicles[k].dynamics;
+            }
+
+            delete[] _vehicles;
+            delete[] _poses;
+            delete[] _motors;
+        }
+
+        // Advances every vehicle by one physics step
+        void step(void)
+        {
+            for (uint32_t k=0; k<_count; ++k) {
+
+                vehicle_t & vehicle = _vehicles[k];
+
+                double * motorvals = &_motors[k * _motorCount];
+
+                double altitude = -vehicle.dynamics->getStateVector()[Dynamics::STATE_Z];
+
+                _controller.control(vehicle.dynamics->getState(), altitude, vehicle.altitude, vehicle.altIntegral,
+                        _config.dt, motorvals);
+
+                vehicle.dynamics->setAgl(altitude);
+                vehicle.dynamics->setMotors(motorvals, _config.dt);
+                vehicle.dynamics->update(_config.dt);
+
+                _poses[k] = vehicle.dynamics->getPose();
+            }
+
+            _time += _config.dt;
+        }
+
+        // Simulation time in seconds
+        double getTime(void)
+        {
+            return _time;
+        }
+
+        uint32_t count(void)
+        {
+            return _count;
+        }
+
+        uint8_t motorCount(void)
+        {
+            return _motorCount;
+        }
+
+        int8_t motorDirection(uint8_t index)
+        {
+            return _count ? _vehicles[0].dynamics->motorDirection(index) : 0;
+        }
+
+        // Pose of each vehicle relative to its spot, NED
+        const Dynamics::pose_t * getPoses(void)
+        {
+            return _poses;
+        }
+
+        // Motor values, motorCount() per vehicle
+        const double * getMotors(void)
+        {
+            return _motors;
+        }
+
+        const config_t & getConfig(void)
+        {
+            return _config;
+        }
+
+}; // class Swarm
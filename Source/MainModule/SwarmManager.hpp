@@ -0,0 +1,137 @@
+/*
+ * Threaded manager for MulticopterSim swarms
+ *
+ * One thread steps every vehicle in the swarm, in fixed increments, to keep
+ * up with real time.  After each batch of steps it publishes the vehicles'
+ * poses and motor values through a triple buffer, so that the game thread
+ * always gets a complete set from a single step, and neither thread ever
+ * waits for the other.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "ThreadedManager.hpp"
+#include "Swarm.hpp"
+
+#include <atomic>
+
+class FSwarmManager : public FThreadedManager {
+
+    private:
+
+        // Most steps per task; a swarm too big for real time runs slow rather than never publishing
+        static const uint32_t MAX_STEPS = 10;
+
+        static const uint8_t FRESH = 0x04;
+
+        Swarm * _swarm = NULL;
+
+        uint32_t _count = 0;
+        uint8_t _motorCount = 0;
+
+        // Triple buffer: this thread fills the back slot and swaps it with the middle one; the
+        // game thread swaps the middle slot for its front one when the FRESH bit says it's new
+        Dynamics::pose_t * _poses[3] = {};
+        double * _motors[3] = {};
+        std::atomic<uint8_t> _middle;
+        uint8_t _back = 1;
+        uint8_t _front = 2;
+
+        bool _running = false;
+
+    protected:
+
+        // Called repeatedly on worker thread
+        void performTask(double currentTime)
+        {
+            if (!_running) return;
+
+            double dt = _swarm->getConfig().dt;
+
+            uint32_t steps = 0;
+
+            while (_swarm->getTime() + dt <= currentTime && steps < MAX_STEPS) {
+                _swarm->step();
+                steps++;
+            }
+
+            if (!steps) return;
+
+            memcpy(_poses[_back], _swarm->getPoses(), _count * sizeof(Dynamics::pose_t));
+            memcpy(_motors[_back], _swarm->getMotors(), _count * _motorCount * sizeof(double));
+
+            _back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & 0x03;
+        }
+
+    public:
+
+        FSwarmManager(const Swarm::config_t & config)
+            : FThreadedManager()
+        {
+            _swarm = new Swarm(config);
+
+            _count = _swarm->count();
+            _motorCount = _swarm->motorCount();
+
+            for (uint8_t k=0; k<3; ++k) {
+                _poses[k] = new Dynamics::pose_t [_count]();
+                _motors[k] = new double [_count * _motorCount]();
+                memcpy(_poses[k], _swarm->getPoses(), _count * sizeof(Dynamics::pose_t));
+            }
+
+            _middle = 0;
+
+            _running = true;
+        }
+
+        ~FSwarmManager(void)
+        {
+            for (uint8_t k=0; k<3; ++k) {
+                delete[] _poses[k];
+                delete[] _motors[k];
+            }
+
+            delete _swarm;
+        }
+
+        /**
+         * Gets the latest poses and motor values; call from the game thread only.
+         *
+         * @param poses each vehicle's pose relative to its spot, NED (output)
+         * @param motors motorCount() values per vehicle (output)
+         */
+        void getLatest(const Dynamics::pose_t * & poses, const double * & motors)
+        {
+            if (_middle.load(std::memory_order_relaxed) & FRESH) {
+                _front = _middle.exchange(_front, std::memory_order_acq_rel) & 0x03;
+            }
+
+            poses = _poses[_front];
+            motors = _motors[_front];
+        }
+
+        uint32_t count(void)
+        {
+            return _count;
+        }
+
+        uint8_t motorCount(void)
+        {
+            return _motorCount;
+        }
+
+        int8_t motorDirection(uint8_t index)
+        {
+            return _swarm->motorDirection(index);
+        }
+
+        void stop(void)
+        {
+            _running = false;
+        }
+
+}; // class FSwarmManager
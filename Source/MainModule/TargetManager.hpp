@@ -1,36 +1,292 @@
+/*
+ * Moving targets for MulticopterSim
+ *
+ * A target's motion is a trajectory: its pose as a function of simulation
+ * time.  Trajectories are evaluated when the game thread asks for the pose,
+ * so a target costs nothing between frames.  One too heavy to evaluate on the
+ * game thread can subclass FTargetManager instead, which computes poses on a
+ * worker thread at a fixed rate.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
 #pragma once
 
 #include "../MainModule/ThreadedManager.hpp"
 
-class FTargetManager : public FThreadedManager {
+#include "Components/SplineComponent.h"
 
-protected:
+#include <atomic>
 
-	FVector _location;
-	FRotator _rotation;
-	
-	virtual void performTask(double currentTime) override
+class TargetTrajectory {
+
+public:
+
+	virtual ~TargetTrajectory(void)
+	{
+	}
+
+	/**
+	 * @param time simulation time in seconds
+	 * @param location where the target is, in cm (output)
+	 * @param rotation how it's turned (output)
+	 */
+	virtual void getPose(double time, FVector & location, FRotator & rotation) = 0;
+};
+
+// Timed waypoints, joined by straight lines or a smooth curve, optionally repeating
+class WaypointTrajectory : public TargetTrajectory {
+
+private:
+
+	typedef struct {
+
+		double time;
+		FVector location;
+		FQuat rotation;
+
+	} waypoint_t;
+
+	TArray<waypoint_t> _waypoints;
+
+	bool _smooth = false;
+	bool _loop = false;
+
+	// Segment found by the last lookup, where the next one starts looking
+	int32 _cursor = 0;
+
+	int32 seek(double time)
+	{
+		// Time went backwards (a restart or a new lap); search again from the beginning
+		if (time < _waypoints[_cursor].time) {
+			_cursor = 0;
+		}
+
+		while (_cursor + 1 < _waypoints.Num() && _waypoints[_cursor + 1].time <= time) {
+			_cursor++;
+		}
+
+		return _cursor;
+	}
+
+	// Waypoint k, wrapping around for a loop and stopping at the ends otherwise
+	const FVector & locationAt(int32 k)
+	{
+		int32 n = _waypoints.Num();
+
+		return _waypoints[_loop ? (k + n) % n : FMath::Clamp(k, 0, n - 1)].location;
+	}
+
+public:
+
+	/**
+	 * @param smooth true for a Catmull-Rom curve through the waypoints, false for straight lines
+	 * @param loop true to start again from the first waypoint after the last
+	 */
+	WaypointTrajectory(bool smooth=false, bool loop=false)
+	{
+		_smooth = smooth;
+		_loop = loop;
+	}
+
+	/**
+	 * Adds a waypoint; times must increase.  For a loop, the target heads back to
+	 * the first waypoint after the last, taking as long as the first leg did.
+	 */
+	void add(double time, const FVector & location, const FRotator & rotation=FRotator::ZeroRotator)
+	{
+		waypoint_t waypoint = {time, location, FQuat(rotation)};
+
+		_waypoints.Add(waypoint);
+	}
+
+	virtual void getPose(double time, FVector & location, FRotator & rotation) override
+	{
+		int32 n = _waypoints.Num();
+
+		if (!n) return;
+
+		double start = _waypoints[0].time;
+
+		// A loop's period covers the leg from the last waypoint back to the first
+		double legBack = n > 1 ? _waypoints[1].time - start : 0;
+		double period = _waypoints[n-1].time + legBack - start;
+
+		// A single waypoint, or waypoints all at one time, leave no lap to go around
+		if (_loop && period <= 0) {
+			location = _waypoints[n-1].location;
+			rotation = _waypoints[n-1].rotation.Rotator();
+			return;
+		}
+
+		if (_loop) {
+			time = start + fmod(FMath::Max(time - start, 0.), period);
+		}
+
+		int32 k = seek(time);
+
+		const waypoint_t & a = _waypoints[k];
+
+		// Before the first waypoint, or past the last when not looping
+		if (time <= a.time || (k + 1 == n && !_loop)) {
+			location = a.location;
+			rotation = a.rotation.Rotator();
+			return;
+		}
+
+		const waypoint_t & b = _waypoints[(k + 1) % n];
+
+		double bTime = k + 1 < n ? b.time : a.time + legBack;
+
+		float u = (float)((time - a.time) / (bTime - a.time));
+
+		if (_smooth) {
+
+			const FVector & p0 = locationAt(k - 1);
+			const FVector & p1 = a.location;
+			const FVector & p2 = b.location;
+			const FVector & p3 = locationAt(k + 2);
+
+			float u2 = u * u;
+			float u3 = u2 * u;
+
+			location = 0.5f * (2*p1 + (p2 - p0)*u + (2*p0 - 5*p1 + 4*p2 - p3)*u2 + (3*p1 - p0 - 3*p2 + p3)*u3);
+		}
+
+		else {
+			location = FMath::Lerp(a.location, b.location, u);
+		}
+
+		rotation = FQuat::Slerp(a.rotation, b.rotation, u).Rotator();
+	}
+};
+
+// A spline laid out in the editor, traversed in the spline's Duration seconds
+class SplineTrajectory : public TargetTrajectory {
+
+private:
+
+	USplineComponent * _spline = NULL;
+
+	bool _loop = false;
+
+public:
+
+	/**
+	 * @param spline the spline; its Duration sets how long the trip takes
+	 * @param loop true to start again at the beginning after reaching the end
+	 */
+	SplineTrajectory(USplineComponent * spline, bool loop=false)
 	{
-		computePose(currentTime);
+		_spline = spline;
+		_loop = loop;
 	}
 
-	FTargetManager() : FThreadedManager()
+	// Call from the game thread only, since it reads the spline component
+	virtual void getPose(double time, FVector & location, FRotator & rotation) override
 	{
-		_location = FVector(0, 10, 0);
-		_rotation = FRotator(0, 0, 0);
+		float duration = _spline->Duration;
+
+		float t = _loop && duration > 0 ? FMath::Fmod((float)time, duration) : FMath::Min((float)time, duration);
+
+		location = _spline->GetLocationAtTime(t, ESplineCoordinateSpace::World, true);
+		rotation = _spline->GetRotationAtTime(t, ESplineCoordinateSpace::World, true);
 	}
+};
+
+// Any function of time, for example a circle:
+//
+//   FunctionTrajectory([](double t, FVector & location, FRotator & rotation) {
+//       location = FVector(cos(t), sin(t), 1) * 500;
+//       rotation = FRotator(0, FMath::RadiansToDegrees(t) + 90, 0);
+//   });
+class FunctionTrajectory : public TargetTrajectory {
 
-	virtual void computePose(double currentTime) = 0;
+private:
+
+	TFunction<void(double, FVector &, FRotator &)> _function;
 
 public:
 
-	const FVector & getLocation(void)
+	FunctionTrajectory(TFunction<void(double, FVector &, FRotator &)> function)
 	{
-		return _location;
+		_function = function;
 	}
-	
-	const FRotator & getRotation(void)
+
+	virtual void getPose(double time, FVector & location, FRotator & rotation) override
 	{
-		return _rotation;
+		_function(time, location, rotation);
+	}
+};
+
+// For motion too heavy to compute on the game thread: a worker runs computePose() at a fixed
+// rate and publishes each result through a triple buffer, so the game thread always gets a
+// complete pose without either thread waiting.  getPose() returns the latest, whatever the time.
+class FTargetManager : public FThreadedManager, public TargetTrajectory {
+
+private:
+
+	static const uint8_t FRESH = 0x04;
+
+	typedef struct {
+
+		FVector location;
+		FRotator rotation;
+
+	} pose_t;
+
+	pose_t _poses[3];
+	std::atomic<uint8_t> _middle;
+	uint8_t _back = 1;
+	uint8_t _front = 2;
+
+protected:
+
+	virtual void performTask(double currentTime) override
+	{
+		pose_t & pose = _poses[_back];
+
+		computePose(currentTime, pose.location, pose.rotation);
+
+		_back = _middle.exchange(_back | FRESH, std::memory_order_acq_rel) & 0x03;
+	}
+
+	/**
+	 * @param rate poses per second
+	 */
+	FTargetManager(double rate=100) : FThreadedManager()
+	{
+		for (uint8_t k=0; k<3; ++k) {
+			_poses[k].location = FVector::ZeroVector;
+			_poses[k].rotation = FRotator::ZeroRotator;
+		}
+
+		_middle = 0;
+
+		_period = 1 / rate;
+	}
+
+	/**
+	 * Called on the worker thread.
+	 *
+	 * @param currentTime seconds since the worker started
+	 * @param location where the target is, in cm (output)
+	 * @param rotation how it's turned (output)
+	 */
+	virtual void computePose(double currentTime, FVector & location, FRotator & rotation) = 0;
+
+public:
+
+	// Call from the game thread only
+	virtual void getPose(double time, FVector & location, FRotator & rotation) override
+	{
+		if (_middle.load(std::memory_order_relaxed) & FRESH) {
+			_front = _middle.exchange(_front, std::memory_order_acq_rel) & 0x03;
+		}
+
+		location = _poses[_front].location;
+		rotation = _poses[_front].rotation;
 	}
 };
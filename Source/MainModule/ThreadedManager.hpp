@@ -27,6 +27,9 @@ class FThreadedManager : public FRunnable {
 
     protected:
 
+        // Seconds from the start of one task to the start of the next; zero runs them back to back
+        double _period = 0;
+
         // Implemented differently by each subclass
         virtual void performTask(double currentTime) = 0;
 
@@ -93,6 +96,14 @@ class FThreadedManager : public FRunnable {
 
                 // Increment count for FPS reporting
                 _count++;
+
+                // Give the core back until the next task is due
+                if (_period > 0) {
+                    double wait = currentTime + _period - (FPlatformTime::Seconds() - _startTime);
+                    if (wait > 0) {
+                        FPlatformProcess::Sleep(wait);
+                    }
+                }
             }
 
 			return 0;
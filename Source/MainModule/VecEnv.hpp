@@ -0,0 +1,255 @@
+/*
+ * Vectorized environment for training controllers on many vehicles at once
+ *
+ * Owns N vehicles of one frame type and steps them all with one call, over
+ * contiguous buffers that the caller reads and writes in place:
+ *
+ *   actions  N x motorCount motor values in [0,1], written by the caller
+ *   obs      N x OBS_SIZE observations: the fields of Dynamics::state_t
+ *   reward   N rewards for the last step
+ *   done     N flags, set when a vehicle crashes, tips over or runs out of time
+ *
+ * The task is to hold a target altitude: the reward is minus the squared
+ * altitude error, less a small penalty for tilt.  Vehicles that are done stay
+ * put, with zero reward, until reset() is called for them.
+ *
+ * This file has no Unreal Engine dependencies, so it can be built into
+ * training libraries outside the simulator.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "VehicleConfig.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <random>
+
+class VecEnv {
+
+    public:
+
+        static const uint8_t OBS_SIZE = sizeof(Dynamics::state_t) / sizeof(double);
+
+        typedef struct {
+
+            double dt = 0.001;              // seconds per physics step
+            uint32_t actionRepeat = 10;     // physics steps per call to step()
+            uint32_t maxSteps = 1000;       // calls to step() per episode
+            double startAltitude = 1;       // m
+            double targetAltitude = 1;      // m
+            double initialTilt = 0.1;       // largest initial roll and pitch, radians
+            double maxTilt = 1.0;           // roll or pitch past which an episode ends, radians
+            double tiltPenalty = 0.1;       // reward per radian squared of tilt
+            uint64_t seed = 0;
+
+        } config_t;
+
+    private:
+
+        typedef struct {
+
+            Dynamics::Parameters * params;
+            Dynamics * dynamics;
+            uint32_t steps;
+
+        } vehicle_t;
+
+        config_t _config;
+
+        uint32_t _count = 0;
+        uint8_t _motorCount = 0;
+
+        vehicle_t * _vehicles = NULL;
+
+        double * _actions = NULL;
+        double * _obs = NULL;
+        double * _reward = NULL;
+        uint8_t * _done = NULL;
+
+        std::mt19937_64 _random;
+
+        void resetVehicle(uint32_t index)
+        {
+            vehicle_t & vehicle = _vehicles[index];
+
+            std::uniform_real_distribution<double> tilt(-_config.initialTilt, _config.initialTilt);
+            std::uniform_real_distribution<double> heading(-M_PI, M_PI);
+
+            double rotation[3] = {};
+            rotation[0] = tilt(_random);
+            rotation[1] = tilt(_random);
+            rotation[2] = heading(_random);
+
+            vehicle.dynamics->init(rotation, _config.startAltitude > 0);
+
+            vehicle.steps = 0;
+
+            observe(index);
+
+            _reward[index] = 0;
+            _done[index] = 0;
+        }
+
+        void observe(uint32_t index)
+        {
+            Dynamics::state_t state = _vehicles[index].dynamics->getState();
+            memcpy(&_obs[index * OBS_SIZE], &state, sizeof(state));
+        }
+
+    public:
+
+        /**
+         * @param frame vehicle frame type
+         * @param count number of vehicles
+         * @param params vehicle parameters, copied for each vehicle
+         * @param config episode settings
+         */
+        VecEnv(VehicleConfig::frame_t frame, uint32_t count, const Dynamics::Parameters & params, const config_t & config)
+        {
+            _config = config;
+            _count = count;
+
+            _random.seed(config.seed);
+
+            _vehicles = new vehicle_t [count]();
+
+            for (uint32_t k=0; k<count; ++k) {
+                _vehicles[k].params = new Dynamics::Parameters(params);
+                _vehicles[k].dynamics = VehicleConfig::createDynamics(frame, _vehicles[k].params);
+            }
+
+            _motorCount = count ? _vehicles[0].dynamics->motorCount() : 0;
+
+            _actions = new double [count * _motorCount]();
+            _obs = new double [count * OBS_SIZE]();
+            _reward = new double [count]();
+            _done = new uint8_t [count]();
+
+            for (uint32_t k=0; k<count; ++k) {
+                resetVehicle(k);
+            }
+        }
+
+        ~VecEnv(void)
+        {
+            for (uint32_t k=0; k<_count; ++k) {
+                delete _vehicles[k].dynamics;
+                delete _vehicles[k].params;
+            }
+
+            delete[] _vehicles;
+            delete[] _actions;
+            delete[] _obs;
+            delete[] _reward;
+            delete[] _done;
+        }
+
+        /**
+         * Starts new episodes.
+         *
+         * @param mask nonzero for each vehicle to reset, or NULL to reset them all
+         */
+        void reset(const uint8_t * mask)
+        {
+            for (uint32_t k=0; k<_count; ++k) {
+                if (!mask || mask[k]) {
+                    resetVehicle(k);
+                }
+            }
+        }
+
+        // Applies the actions buffer to every vehicle not done, then fills obs, reward and done
+        void step(void)
+        {
+            for (uint32_t k=0; k<_count; ++k) {
+
+                if (_done[k]) {
+                    _reward[k] = 0;
+                    continue;
+                }
+
+                vehicle_t & vehicle = _vehicles[k];
+
+                double motorvals[Dynamics::MAX_MOTORS] = {};
+                for (uint8_t j=0; j<_motorCount; ++j) {
+                    double action = _actions[k * _motorCount + j];
+                    motorvals[j] = action < 0 ? 0 : action > 1 ? 1 : action;
+                }
+
+                Dynamics::state_t state = {};
+                bool crashed = false;
+
+                for (uint32_t s=0; s<_config.actionRepeat && !crashed; ++s) {
+
+                    double altitude = -vehicle.dynamics->getStateVector()[Dynamics::STATE_Z];
+
+                    vehicle.dynamics->setAgl(_config.startAltitude + altitude);
+                    vehicle.dynamics->setMotors(motorvals, _config.dt);
+                    vehicle.dynamics->update(_config.dt);
+
+                    state = vehicle.dynamics->getState();
+
+                    crashed = _config.startAltitude - state.pose.location[2] < 0 ||
+                        fabs(state.pose.rotation[0]) > _config.maxTilt ||
+                        fabs(state.pose.rotation[1]) > _config.maxTilt;
+                }
+
+                memcpy(&_obs[k * OBS_SIZE], &state, sizeof(state));
+
+                double error = _config.targetAltitude - (_config.startAltitude - state.pose.location[2]);
+                double phi = state.pose.rotation[0];
+                double theta = state.pose.rotation[1];
+
+                _reward[k] = -error*error - _config.tiltPenalty * (phi*phi + theta*theta);
+
+                _done[k] = crashed || ++vehicle.steps >= _config.maxSteps;
+            }
+        }
+
+        /**
+         * Changes one vehicle's parameters, for randomizing them between episodes.
+         *
+         * @param index vehicle index
+         * @param params new parameters
+         */
+        void setParameters(uint32_t index, const Dynamics::Parameters & params)
+        {
+            *_vehicles[index].params = params;
+        }
+
+        uint32_t getCount(void)
+        {
+            return _count;
+        }
+
+        uint8_t getMotorCount(void)
+        {
+            return _motorCount;
+        }
+
+        double * getActions(void)
+        {
+            return _actions;
+        }
+
+        double * getObs(void)
+        {
+            return _obs;
+        }
+
+        double * getReward(void)
+        {
+            return _reward;
+        }
+
+        uint8_t * getDone(void)
+        {
+            return _done;
+        }
+
+}; // class VecEnv
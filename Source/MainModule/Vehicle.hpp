@@ -7,6 +7,11 @@
  *
  * (2) Provides basic support for displaying vehicle kinematics
  *
+ * (3) Replays a FlightLog instead of flying, when run with -FlightReplay=<file>
+ *
+ * (4) Takes parameters, propeller layout and chase camera from a vehicle
+ *     definition, when run with -Vehicle=<file> (see VehicleConfig.hpp)
+ *
  * Copyright (C) 2019 Simon D. Levy, Daniel Katzav
  *
  * MIT License
@@ -19,6 +24,8 @@
 #include "Utils.hpp"
 #include "dynamics/Dynamics.hpp"
 #include "FlightManager.hpp"
+#include "FlightLog.hpp"
+#include "VehicleConfig.hpp"
 #include "Camera.hpp"
 #include "Landscape.h"
 
@@ -71,8 +78,7 @@ class Vehicle {
         APlayerController * _playerController = NULL;
 
         // Cameras
-        Camera* _cameras[Camera::MAX_CAMERAS];
-        uint8_t  _cameraCount;
+        TArray<Camera*> _cameras;
 
         // Have to seledct a map before flying
         bool _mapSelected = false;
@@ -86,11 +92,16 @@ class Vehicle {
         // Starting location, for kinematic offset
         FVector _startLocation = {};
 
+        // Flight log being replayed, if any, and the simulation time reached in it
+        FlightLogReader * _replay = NULL;
+        double _replayTime = 0;
+        double _replayMotors[FlightLog::MAX_MOTORS] = {};
+
         // Retrieves kinematics from dynamics computed in another thread, returning true if vehicle is airborne, false otherwise.
         void updateKinematics(void)
         {
-            // Get vehicle pose from dynamics
-            Dynamics::pose_t pose = _dynamics->getPose();
+            // Get vehicle pose from dynamics, or from the log when replaying
+            Dynamics::pose_t pose = _replay ? replayPose() : _dynamics->getPose();
 
             // Set vehicle pose in animation
             _pawn->SetActorLocation(_startLocation +
@@ -98,10 +109,40 @@ class Vehicle {
             _pawn->SetActorRotation(FMath::RadiansToDegrees(FRotator(pose.rotation[1], pose.rotation[2], pose.rotation[0])));
         }
 
+        // Looks up the logged pose and motor values for the current replay time
+        Dynamics::pose_t replayPose(void)
+        {
+            double time = 0;
+            Dynamics::state_t state = {};
+
+            _replay->read(_replay->seek(_replayTime), time, state, _replayMotors);
+
+            return state.pose;
+        }
+
+        void startReplay(const char * path)
+        {
+            _replay = new FlightLogReader(path);
+
+            if (!_replay->isOpen() || _replay->getMotorCount() != _dynamics->motorCount()) {
+                error("CAN'T REPLAY %s: %s", path, _replay->isOpen() ? "wrong motor count" : _replay->getMessage());
+                delete _replay;
+                _replay = NULL;
+                return;
+            }
+
+            // The log supplies the pose, so there's no need to fly
+            if (_flightManager) {
+                _flightManager->stop();
+            }
+
+            _replayTime = _replay->getStartTime();
+        }
+
         void grabImages(void)
         {
-            for (uint8_t i = 0; i < _cameraCount; ++i) {
-                _cameras[i]->grabImage();
+            for (Camera* camera : _cameras) {
+                camera->grabImage();
             }
         }
 
@@ -157,10 +198,16 @@ class Vehicle {
             if (_groundCamera) _playerController->SetViewTargetWithBlend(_groundCamera);
         }
 
+        // Why the vehicle definition couldn't be used, if it couldn't
+        char _configMessage[200] = {};
+
     protected:
 
         UAudioComponent* _audioComponent = NULL;
 
+        // Vehicle definition from -Vehicle=<file>; no settings given when there's none
+        VehicleConfig::config_t _config;
+
         // Set in constructor
         Dynamics* _dynamics = NULL;
 
@@ -186,6 +233,19 @@ class Vehicle {
         // Also set in constructor, but purely for visual effect
         int8_t _motorDirections[FFlightManager::MAX_MOTORS] = {};
 
+        // Gets motor values for animation, from the flight manager or the log being replayed
+        void getMotorValues(void)
+        {
+            if (_replay) {
+                for (uint8_t j=0; j<_dynamics->motorCount(); ++j) {
+                    _motorvals[j] = _replayMotors[j];
+                }
+            }
+            else {
+                _flightManager->getMotorValues(_motorvals);
+            }
+        }
+
         virtual void animateActuators(void) = 0;
 
     public:
@@ -208,6 +268,11 @@ class Vehicle {
         {
             build(pawn, frameMesh);
 
+            if (_config.given & VehicleConfig::GIVEN_CHASE) {
+                chaseCameraDistanceMeters = _config.chaseDistance;
+                chaseCameraElevationMeters = _config.chaseElevation;
+            }
+
             // Build the player-view cameras
             buildPlayerCameras(chaseCameraDistanceMeters, chaseCameraElevationMeters);
 
@@ -232,6 +297,49 @@ class Vehicle {
             _gimbalSpringArm->TargetArmLength = 0.f;
         }
 
+        /**
+         * Reads the vehicle definition given by -Vehicle=<file>, if any, replacing the
+         * compiled-in parameters with its own.  Call from a helper's build(), before
+         * building anything else.
+         *
+         * @param frame the frame this vehicle's dynamics are for
+         * @param params parameters used by this vehicle's dynamics
+         * @return the definition, with no settings given if there was none or it didn't fit
+         */
+        const VehicleConfig::config_t & loadConfig(VehicleConfig::frame_t frame, Dynamics::Parameters & params)
+        {
+            FString path;
+            if (!FParse::Value(FCommandLine::Get(), TEXT("Vehicle="), path)) {
+                return _config;
+            }
+
+            VehicleConfig::config_t config;
+
+            if (!VehicleConfig::read(TCHAR_TO_ANSI(*path), config, _configMessage, sizeof(_configMessage))) {
+                return _config;
+            }
+
+            if ((config.given & VehicleConfig::GIVEN_FRAME) && config.frame != frame) {
+                SPRINTF(_configMessage, "%.150s: wrong frame for this vehicle", TCHAR_TO_ANSI(*path));
+            }
+
+            else if ((config.given & VehicleConfig::GIVEN_PROPS) && config.propCount != _dynamics->motorCount()) {
+                SPRINTF(_configMessage, "%.150s: %d props for %d motors", TCHAR_TO_ANSI(*path), config.propCount, _dynamics->motorCount());
+            }
+
+            else {
+
+                _config = config;
+
+                if (config.given & VehicleConfig::GIVEN_PARAMS) {
+                    const double * p = config.params;
+                    params = Dynamics::Parameters(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], (uint16_t)p[8]);
+                }
+            }
+
+            return _config;
+        }
+
         void addMesh(UStaticMesh* mesh, const char* name, const FVector& location, const FRotator rotation, const FVector& scale)
         {
             UStaticMeshComponent* meshComponent =
@@ -256,10 +364,9 @@ class Vehicle {
         void addCamera(Camera* camera)
         {
             // Add camera to spring arm
-            camera->addToVehicle(_pawn, _gimbalSpringArm, _cameraCount);
+            camera->addToVehicle(_pawn, _gimbalSpringArm, _cameras.Num());
 
-            // Increment the camera count for next time
-            _cameras[_cameraCount++] = camera;
+            _cameras.Add(camera);
         }
 
         Vehicle(void)
@@ -281,6 +388,7 @@ class Vehicle {
 
         virtual ~Vehicle(void)
         {
+            delete _replay;
         }
 
         void BeginPlay(FFlightManager* flightManager)
@@ -301,6 +409,11 @@ class Vehicle {
             }
             _mapSelected = true;
 
+            // Reported here, since loadConfig() runs before there's anywhere to show it
+            if (_configMessage[0]) {
+                error("VEHICLE: %s", _configMessage);
+            }
+
             // Disable built-in physics
             _frameMeshComponent->SetSimulatePhysics(false);
 
@@ -339,6 +452,11 @@ class Vehicle {
             }
 
             playerCameraSetChaseView();
+
+            FString replayPath;
+            if (FParse::Value(FCommandLine::Get(), TEXT("FlightReplay="), replayPath)) {
+                startReplay(TCHAR_TO_ANSI(*replayPath));
+            }
         }
 
         void Tick(float DeltaSeconds)
@@ -354,6 +472,11 @@ class Vehicle {
                 // Use 1/2 keys to switch player-camera view
                 setPlayerCameraView();
 
+                // Replays advance at the frame rate
+                if (_replay) {
+                    _replayTime += DeltaSeconds;
+                }
+
                 updateKinematics();
 
                 grabImages();
@@ -0,0 +1,361 @@
+/*
+ * Vehicle definitions read at startup, for MulticopterSim
+ *
+ * Lets an airframe's physical parameters, propeller layout and chase camera
+ * come from a file rather than a rebuild.  One setting per line, # for
+ * comments:
+ *
+ *   frame quadxap                          quadxap, octoxap or thrustvector; must match the
+ *                                          vehicle's dynamics
+ *   params B D M L IX IY IZ JR MAXRPM      as for Dynamics::Parameters
+ *   prop X Y                               a propeller's location on the frame, in m, in
+ *                                          motor order
+ *   chase DISTANCE ELEVATION               chase camera, in m
+ *
+ * Settings left out keep the vehicle's compiled-in values.
+ *
+ * The first read of a file leaves a binary copy of the result with other
+ * temporary files ($XDG_CACHE_HOME, $TMPDIR or /tmp; %TEMP% on Windows), which
+ * later reads use for as long as the file keeps its size and modification time.
+ *
+ * This file has no Unreal Engine dependencies.
+ *
+ * Copyright (C) 2020 Simon D. Levy
+ *
+ * MIT License
+ */
+
+#pragma once
+
+#include "dynamics/QuadXAP.hpp"
+#include "dynamics/OctoXAP.hpp"
+#include "dynamics/ThrustVector.hpp"
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+class VehicleConfig {
+
+    public:
+
+        static const uint8_t PARAM_COUNT = 9;
+
+        typedef enum {
+
+            FRAME_QUADXAP,
+            FRAME_OCTOXAP,
+            FRAME_THRUSTVECTOR
+
+        } frame_t;
+
+        // Bits telling which settings a file gave
+        enum {
+
+            GIVEN_FRAME  = 0x01,
+            GIVEN_PARAMS = 0x02,
+            GIVEN_PROPS  = 0x04,
+            GIVEN_CHASE  = 0x08
+        };
+
+        // Plain data, so that the cache is a straight copy
+        typedef struct {
+
+            uint32_t given = 0;
+
+            frame_t frame = FRAME_QUADXAP;
+
+            // The Phantom's, by default
+            double params[PARAM_COUNT] = {5.E-06, 2.E-06, 1.380, 0.350, 2, 2, 3, 38E-04, 15000};
+
+            uint8_t propCount = 0;
+            double props[Dynamics::MAX_MOTORS][2] = {};
+
+            double chaseDistance = 0;
+            double chaseElevation = 0;
+
+        } config_t;
+
+    private:
+
+        static const uint32_t MAGIC = 0x47464356; // "VCFG"
+        static const uint16_t VERSION = 3;
+
+        typedef struct {
+
+            uint32_t magic;
+            uint16_t version;
+            uint16_t configSize;
+            uint64_t sourceSize;
+            int64_t sourceTime;
+            int64_t sourceTimeNsec;
+            char sourcePath[512];
+
+        } cache_header_t;
+
+        // 64-bit FNV-1a
+        static uint64_t pathHash(const char * path)
+        {
+            uint64_t hash = 14695981039346656037ull;
+
+            for (const char * c=path; *c; ++c) {
+                hash = (hash ^ (uint8_t)*c) * 1099511628211ull;
+            }
+
+            return hash;
+        }
+
+        // Absolute path, so that the same file always finds the same cache
+        static bool getFullPath(const char * path, char * fullPath, size_t size)
+        {
+#if defined(_WIN32)
+            return _fullpath(fullPath, path, size) != NULL;
+#else
+            char resolved[PATH_MAX] = {};
+
+            if (!realpath(path, resolved) || strlen(resolved) >= size) return false;
+
+            strcpy(fullPath, resolved);
+
+            return true;
+#endif
+        }
+
+        // Named for the definition's full path, so that the user's directory needn't be writable
+        static bool getCachePath(const char * fullPath, char * cachePath, size_t size)
+        {
+#if defined(_WIN32)
+            const char * dir = getenv("TEMP");
+#else
+            const char * dir = getenv("XDG_CACHE_HOME");
+            if (!dir || !*dir) dir = getenv("TMPDIR");
+            if (!dir || !*dir) dir = "/tmp";
+#endif
+            if (!dir || !*dir) return false;
+
+            int n = snprintf(cachePath, size, "%s/multicopter-vehicle-%016llx.cache", dir,
+                    (unsigned long long)pathHash(fullPath));
+
+            return n > 0 && (size_t)n < size;
+        }
+
+        // Modification time's fraction of a second, where the platform keeps one
+        static int64_t mtimeNsec(const struct stat & st)
+        {
+#if defined(_WIN32)
+            (void)st;
+            return 0;
+#elif defined(__APPLE__)
+            return (int64_t)st.st_mtimespec.tv_nsec;
+#else
+            return (int64_t)st.st_mtim.tv_nsec;
+#endif
+        }
+
+        static bool readCache(const char * cachePath, const cache_header_t & expected, config_t & config)
+        {
+            FILE * fp = fopen(cachePath, "rb");
+
+            if (!fp) return false;
+
+            cache_header_t header = {};
+
+            bool ok = fread(&header, sizeof(header), 1, fp) == 1 && !memcmp(&header, &expected, sizeof(header)) &&
+                fread(&config, sizeof(config), 1, fp) == 1;
+
+            fclose(fp);
+
+            return ok;
+        }
+
+        // Best effort: without a cache, the next read just parses the file again
+        static void writeCache(const char * cachePath, const cache_header_t & header, const config_t & config)
+        {
+            FILE * fp = fopen(cachePath, "wb");
+
+            if (!fp) return;
+
+            bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(&config, sizeof(config), 1, fp) == 1;
+
+            fclose(fp);
+
+            if (!ok) {
+                remove(cachePath);
+            }
+        }
+
+    public:
+
+        /**
+         * @param name "quadxap", "octoxap" or "thrustvector"
+         * @param frame output
+         * @return false for an unknown frame
+         */
+        static bool parseFrame(const char * name, frame_t & frame)
+        {
+            if (!strcmp(name, "quadxap")) frame = FRAME_QUADXAP;
+            else if (!strcmp(name, "octoxap")) frame = FRAME_OCTOXAP;
+            else if (!strcmp(name, "thrustvector")) frame = FRAME_THRUSTVECTOR;
+            else return false;
+
+            return true;
+        }
+
+        /**
+         * Creates dynamics for a frame, for flying vehicles outside the simulator.  The caller deletes them.
+         *
+         * @param frame frame type
+         * @param params vehicle parameters, which must outlive the dynamics
+         */
+        static Dynamics * createDynamics(frame_t frame, Dynamics::Parameters * params)
+        {
+            switch (frame) {
+                case FRAME_OCTOXAP:
+                    return new OctoXAPDynamics(params);
+                case FRAME_THRUSTVECTOR:
+                    return new ThrustVectorDynamics(params);
+                default:
+                    return new QuadXAPDynamics(params);
+            }
+        }
+
+        /**
+         * Applies one line of a vehicle definition.
+         *
+         * @param line text of the line, comment removed
+         * @param config output
+         * @return 1 if the line was a vehicle setting, 0 if it wasn't (or was blank), -1 if its values were bad
+         */
+        static int8_t parseLine(const char * line, config_t & config)
+        {
+            char name[64] = {};
+            double v[PARAM_COUNT] = {};
+
+            int n = sscanf(line, "%63s %lf %lf %lf %lf %lf %lf %lf %lf %lf",
+                    name, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8]);
+
+            if (n <= 0) return 0;
+
+            if (!strcmp(name, "frame")) {
+
+                char frame[64] = {};
+                sscanf(line, "%*s %63s", frame);
+
+                if (!parseFrame(frame, config.frame)) return -1;
+
+                config.given |= GIVEN_FRAME;
+            }
+
+            else if (!strcmp(name, "params")) {
+
+                if (n != 1 + PARAM_COUNT) return -1;
+
+                // All are physical quantities, and maxrpm must fit Dynamics::Parameters
+                for (uint8_t k=0; k<PARAM_COUNT; ++k) {
+                    if (!(v[k] > 0)) return -1;
+                }
+                if (v[PARAM_COUNT-1] > UINT16_MAX) return -1;
+
+                memcpy(config.params, v, sizeof(config.params));
+                config.given |= GIVEN_PARAMS;
+            }
+
+            else if (!strcmp(name, "prop")) {
+
+                if (n != 3 || config.propCount == Dynamics::MAX_MOTORS) return -1;
+
+                config.props[config.propCount][0] = v[0];
+                config.props[config.propCount][1] = v[1];
+                config.propCount++;
+                config.given |= GIVEN_PROPS;
+            }
+
+            else if (!strcmp(name, "chase")) {
+
+                if (n != 3) return -1;
+
+                config.chaseDistance = v[0];
+                config.chaseElevation = v[1];
+                config.given |= GIVEN_CHASE;
+            }
+
+            else {
+                return 0;
+            }
+
+            return 1;
+        }
+
+        /**
+         * Reads a vehicle definition, from its cache when that's up to date.
+         *
+         * @param path definition file
+         * @param config output
+         * @param message why the file couldn't be read (output)
+         * @param size size of message
+         * @return true on success
+         */
+        static bool read(const char * path, config_t & config, char * message, size_t size)
+        {
+            struct stat st = {};
+
+            if (stat(path, &st) != 0) {
+                snprintf(message, size, "stat(%s) failed", path);
+                return false;
+            }
+
+            cache_header_t header = {};
+            header.magic = MAGIC;
+            header.version = VERSION;
+            header.configSize = (uint16_t)sizeof(config_t);
+            header.sourceSize = (uint64_t)st.st_size;
+            header.sourceTime = (int64_t)st.st_mtime;
+            header.sourceTimeNsec = mtimeNsec(st);
+
+            // Without a full path there's no cache, just a parse every time
+            char cachePath[1024] = {};
+            bool cached = getFullPath(path, header.sourcePath, sizeof(header.sourcePath)) &&
+                getCachePath(header.sourcePath, cachePath, sizeof(cachePath));
+
+            if (cached && readCache(cachePath, header, config)) {
+                return true;
+            }
+
+            FILE * fp = fopen(path, "r");
+
+            if (!fp) {
+                snprintf(message, size, "fopen(%s) failed", path);
+                return false;
+            }
+
+            config_t parsed;
+
+            bool ok = true;
+
+            char line[256] = {};
+
+            for (uint32_t lineno=1; ok && fgets(line, sizeof(line), fp); ++lineno) {
+
+                char * hash = strchr(line, '#');
+                if (hash) *hash = 0;
+
+                if (parseLine(line, parsed) != 1 && line[strspn(line, " \t\r\n")]) {
+                    snprintf(message, size, "%.150s line %u: bad setting", path, lineno);
+                    ok = false;
+                }
+            }
+
+            fclose(fp);
+
+            if (ok) {
+                config = parsed;
+                if (cached) writeCache(cachePath, header, config);
+            }
+
+            return ok;
+        }
+
+}; // class VehicleConfig
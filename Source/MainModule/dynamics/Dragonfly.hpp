@@ -20,7 +20,11 @@ class DragonflyDynamics : public Dynamics {
 
     public:	
 
-		DragonflyDynamics(Parameters * params) : Dynamics(params, 4)
+		static const uint8_t MOTOR_COUNT = 4;
+
+		static_assert(MOTOR_COUNT <= MAX_MOTORS, "Dynamics::MAX_MOTORS is too small for this frame");
+
+		DragonflyDynamics(Parameters * params) : Dynamics(params, MOTOR_COUNT)
         {
         }
 
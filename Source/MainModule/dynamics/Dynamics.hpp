@@ -33,12 +33,16 @@
 #include <string.h>
 #include <math.h>
 
-#include "../Utils.hpp"
-
 class Dynamics {
 
 public:
 
+	/**
+	 * Most motors any vehicle can have; motor arrays are this size, so that they
+	 * live inside the Dynamics object rather than on the heap
+	 */
+	static const uint8_t MAX_MOTORS = 16;
+
 	/**
 	 * Position map for state vector
 	 */
@@ -194,8 +198,50 @@ protected:
 	virtual double u4(double* o) = 0;
 
 	// radians per second for each motor, and their squared values
-	double* _omegas = NULL;
-	double* _omegas2 = NULL;
+	double _omegas[MAX_MOTORS] = {};
+	double _omegas2[MAX_MOTORS] = {};
+
+	// motor values last passed to setMotors()
+	double _motorvals[MAX_MOTORS] = {};
+
+	// Each motor's coefficients in u2, u3 and u4, found on first use by computeJacobians() or getMixer()
+	double _mixer[3 * MAX_MOTORS] = {};
+	bool _haveMixer = false;
+
+	// Probes u2, u3 and u4 with one motor at a time
+	void computeMixer(void)
+	{
+		double o[MAX_MOTORS] = {};
+
+		for (uint8_t i = 0; i < _motorCount; ++i) {
+			o[i] = 1;
+			_mixer[3 * i] = u2(o);
+			_mixer[3 * i + 1] = u3(o);
+			_mixer[3 * i + 2] = u4(o);
+			o[i] = 0;
+		}
+
+		_haveMixer = true;
+	}
+
+	// Fills the state structure from the state vector
+	void updateState(void)
+	{
+		// Get most values directly from state vector
+		for (uint8_t i = 0; i < 3; ++i) {
+			uint8_t ii = 2 * i;
+			_state.angularVel[i] = _x[STATE_PHI_DOT + ii];
+			_state.inertialVel[i] = _x[STATE_X_DOT + ii];
+			_state.pose.rotation[i] = _x[STATE_PHI + ii];
+			_state.pose.location[i] = _x[STATE_X + ii];
+		}
+
+		// Convert inertial acceleration and velocity to body frame
+		inertialToBody(_inertialAccel, _state.pose.rotation, _state.bodyAccel);
+
+		// Convert Euler angles to quaternion
+		eulerToQuaternion(_state.pose.rotation, _state.quaternion);
+	}
 
 	// quad, hexa, octo, etc.
 	uint8_t _motorCount = 0;
@@ -204,15 +250,14 @@ protected:
 
 	/**
 	 *  Constructor
+	 *
+	 *  @param motorCount at most MAX_MOTORS, which each frame checks with a static_assert
 	 */
 	Dynamics(Parameters* params, const uint8_t motorCount)
 	{
 		_p = params;
 		_motorCount = motorCount;
 
-		_omegas = new double[motorCount]();
-		_omegas2 = new double[motorCount]();
-
 		for (uint8_t i = 0; i < 12; ++i) {
 			_x[i] = 0;
 		}
@@ -259,6 +304,17 @@ protected:
 		return motorval * _p->maxrpm * 3.14159 / 30;
 	}
 
+	/**
+	 * Computes derivative of motor speed with respect to motor value; should match computeMotorSpeed()
+	 * @param motorval motor value in [0,1]
+	 * @return d(motor speed)/d(motor value) in rad/s
+	 */
+	virtual double computeMotorSpeedDerivative(double motorval)
+	{
+		(void)motorval;
+		return _p->maxrpm * 3.14159 / 30;
+	}
+
 public:
 
 	/**
@@ -266,8 +322,6 @@ public:
 	 */
 	virtual ~Dynamics(void)
 	{
-		delete _omegas;
-		delete _omegas2;
 	}
 
 	/**
@@ -301,6 +355,20 @@ public:
 
 		// We usuall start on ground, but can start in air for testing
 		_airborne = airborne;
+
+		// Start with motors off, so no thrust lingers from a previous flight
+		for (uint8_t i = 0; i < _motorCount; ++i) {
+			_omegas[i] = 0;
+			_omegas2[i] = 0;
+			_motorvals[i] = 0;
+		}
+		_U1 = 0;
+		_U2 = 0;
+		_U3 = 0;
+		_U4 = 0;
+		_Omega = 0;
+
+		updateState();
 	}
 
 	/**
@@ -371,20 +439,7 @@ public:
 
 		updateGimbalDynamics(dt);
 
-		// Get most values directly from state vector
-		for (uint8_t i = 0; i < 3; ++i) {
-			uint8_t ii = 2 * i;
-			_state.angularVel[i] = _x[STATE_PHI_DOT + ii];
-			_state.inertialVel[i] = _x[STATE_X_DOT + ii];
-			_state.pose.rotation[i] = _x[STATE_PHI + ii];
-			_state.pose.location[i] = _x[STATE_X + ii];
-		}
-
-		// Convert inertial acceleration and velocity to body frame
-		inertialToBody(_inertialAccel, _state.pose.rotation, _state.bodyAccel);
-
-		// Convert Euler angles to quaternion
-		eulerToQuaternion(_state.pose.rotation, _state.quaternion);
+		updateState();
 
 	} // update
 
@@ -433,6 +488,106 @@ public:
 		_U2 = _p->l * _p->b * u2(_omegas2);
 		_U3 = _p->l * _p->b * u3(_omegas2);
 		_U4 = _p->d * u4(_omegas2);
+
+		for (unsigned int i = 0; i < _motorCount; ++i) {
+			_motorvals[i] = motorvals[i];
+		}
+	}
+
+	/**
+	 * Computes Jacobians of the state derivative (Equation 12) at the current state and the motor values last
+	 * passed to setMotors(), for linearizing the dynamics.  These hold whether or not the vehicle is airborne.
+	 * Assumes u2, u3 and u4 are linear, as they are for every frame.
+	 *
+	 * @param A 12x12 output, d(dx/dt)/dx, indexed by STATE_ values
+	 * @param B 12 x motorCount output, row-major, d(dx/dt)/d(motor values)
+	 */
+	void computeJacobians(double A[12][12], double* B)
+	{
+		if (!_haveMixer) {
+			computeMixer();
+		}
+
+		double phi = _x[STATE_PHI];
+		double theta = _x[STATE_THETA];
+		double psi = _x[STATE_PSI];
+
+		double phidot = _x[STATE_PHI_DOT];
+		double thedot = _x[STATE_THETA_DOT];
+		double psidot = _x[STATE_PSI_DOT];
+
+		double cph = cos(phi);
+		double sph = sin(phi);
+		double cth = cos(theta);
+		double sth = sin(theta);
+		double cps = cos(psi);
+		double sps = sin(psi);
+
+		// Rightmost column of the body-to-inertial rotation matrix (see bodyZToInertial()), and its partial derivatives
+		double R[3] = { sph * sps + cph * cps * sth, cph * sps * sth - cps * sph, cph * cth };
+
+		double dR[3][3] = {
+			// d/dphi                      d/dtheta         d/dpsi
+			{ cph * sps - sph * cps * sth,  cph * cps * cth,  sph * cps - cph * sps * sth },
+			{ -sph * sps * sth - cps * cph, cph * sps * cth,  cph * cps * sth + sps * sph },
+			{ -sph * cth,                   -cph * sth,       0 } };
+
+		for (uint8_t j = 0; j < 12; ++j) {
+			for (uint8_t k = 0; k < 12; ++k) {
+				A[j][k] = 0;
+			}
+		}
+
+		// Positions and angles integrate their rates
+		for (uint8_t j = 0; j < 12; j += 2) {
+			A[j][j + 1] = 1;
+		}
+
+		// Translational accelerations depend on the angles through the thrust direction
+		for (uint8_t j = 0; j < 3; ++j) {
+			for (uint8_t k = 0; k < 3; ++k) {
+				A[STATE_X_DOT + 2 * j][STATE_PHI + 2 * k] = -_U1 / _p->m * dR[j][k];
+			}
+		}
+
+		// Angular accelerations depend on the angular rates through gyroscopic coupling
+		A[STATE_PHI_DOT][STATE_THETA_DOT] = psidot * (_p->Iy - _p->Iz) / _p->Ix - _p->Jr / _p->Ix * _Omega;
+		A[STATE_PHI_DOT][STATE_PSI_DOT] = thedot * (_p->Iy - _p->Iz) / _p->Ix;
+
+		A[STATE_THETA_DOT][STATE_PHI_DOT] = -(psidot * (_p->Iz - _p->Ix) / _p->Iy + _p->Jr / _p->Iy * _Omega);
+		A[STATE_THETA_DOT][STATE_PSI_DOT] = -phidot * (_p->Iz - _p->Ix) / _p->Iy;
+
+		A[STATE_PSI_DOT][STATE_PHI_DOT] = thedot * (_p->Ix - _p->Iy) / _p->Iz;
+		A[STATE_PSI_DOT][STATE_THETA_DOT] = phidot * (_p->Ix - _p->Iy) / _p->Iz;
+
+		for (uint8_t i = 0; i < _motorCount; ++i) {
+
+			// Chain rule through omega, and through omega squared for the U values
+			double domega = computeMotorSpeedDerivative(_motorvals[i]);
+			double domega2 = 2 * _omegas[i] * domega;
+
+			double c2 = _mixer[3 * i];
+			double c3 = _mixer[3 * i + 1];
+			double c4 = _mixer[3 * i + 2];
+
+			double dU1 = _p->b * domega2;
+			double dU2 = _p->l * _p->b * c2 * domega2;
+			double dU3 = _p->l * _p->b * c3 * domega2;
+			double dU4 = _p->d * c4 * domega2;
+			double dOmega = c4 * domega;
+
+			for (uint8_t j = 0; j < 12; ++j) {
+				B[j * _motorCount + i] = 0;
+			}
+
+			B[STATE_X_DOT * _motorCount + i] = -dU1 / _p->m * R[0];
+			B[STATE_Y_DOT * _motorCount + i] = -dU1 / _p->m * R[1];
+			B[STATE_Z_DOT * _motorCount + i] = -dU1 / _p->m * R[2];
+
+			B[STATE_PHI_DOT * _motorCount + i] = -_p->Jr / _p->Ix * thedot * dOmega + dU2 / _p->Ix;
+			B[STATE_THETA_DOT * _motorCount + i] = -(_p->Jr / _p->Iy * phidot * dOmega + dU3 / _p->Iy);
+			B[STATE_PSI_DOT * _motorCount + i] = dU4 / _p->Iz;
+		}
 	}
 
 	/**
@@ -465,6 +620,20 @@ public:
 	// Motor direction for animation
 	virtual int8_t motorDirection(uint8_t i) { (void)i; return 0; }
 
+	/**
+	 * Gets each motor's coefficients in u2, u3 and u4, for controllers that invert the mixing.
+	 *
+	 * @return motorCount x 3 values, row-major
+	 */
+	const double* getMixer(void)
+	{
+		if (!_haveMixer) {
+			computeMixer();
+		}
+
+		return _mixer;
+	}
+
 	/**
 	 *  Frame-of-reference conversion routines.
 	 *
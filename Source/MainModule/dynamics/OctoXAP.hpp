@@ -24,7 +24,11 @@ class OctoXAPDynamics : public Dynamics {
 
     public:	
 
-		OctoXAPDynamics(Parameters * params) : Dynamics(params, 8)
+		static const uint8_t MOTOR_COUNT = 8;
+
+		static_assert(MOTOR_COUNT <= MAX_MOTORS, "Dynamics::MAX_MOTORS is too small for this frame");
+
+		OctoXAPDynamics(Parameters * params) : Dynamics(params, MOTOR_COUNT)
         {
         }
 
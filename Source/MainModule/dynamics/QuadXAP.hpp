@@ -20,7 +20,11 @@ class QuadXAPDynamics : public Dynamics {
 
     public:	
 
-		QuadXAPDynamics(Parameters * params) : Dynamics(params, 4)
+		static const uint8_t MOTOR_COUNT = 4;
+
+		static_assert(MOTOR_COUNT <= MAX_MOTORS, "Dynamics::MAX_MOTORS is too small for this frame");
+
+		QuadXAPDynamics(Parameters * params) : Dynamics(params, MOTOR_COUNT)
         {
         }
 
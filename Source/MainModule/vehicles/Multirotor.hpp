@@ -28,6 +28,9 @@ class MultirotorVehicle : public Vehicle {
             propMeshComponent->SetupAttachment(_frameMeshComponent, USpringArmComponent::SocketName);
             propMeshComponent->AddRelativeLocation(FVector(x, y, 0) * 100); // m => cm
             propMeshComponent->SetRelativeRotation(FRotator(0, angle, 0));
+            // Props are only for show, so spinning them needn't test for collisions or overlaps
+            propMeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+            propMeshComponent->SetGenerateOverlapEvents(false);
             _propellerMeshComponents[_propCount] = propMeshComponent;
             _propCount++;
             return propMeshComponent;
@@ -38,18 +41,40 @@ class MultirotorVehicle : public Vehicle {
             addProp(propMesh, x, y, propStartAngle(x,y));
         }
 
-        virtual void setPropRotation(uint8_t index, float angle)
+        // Adds the props from the vehicle definition, returning false if it gave none
+        bool addConfigProps(UStaticMesh* propMesh)
         {
-            _propellerMeshComponents[index]->SetRelativeRotation(FRotator(0, angle, 0));
-        }
+            if (!(_config.given & VehicleConfig::GIVEN_PROPS)) return false;
+
+            for (uint8_t i = 0; i < _config.propCount; ++i) {
+                addProp(propMesh, _config.props[i][0], _config.props[i][1]);
+            }
 
+            return true;
+        }
 
     protected:
 
+        // Degrees the props turn each frame; for visual effect, regardless of actual motor values
+        static constexpr float PROP_DEGREES_PER_FRAME = 200;
+
+        // This vehicle's own prop angle, starting at random so that vehicles don't spin in step
+        float _propAngle = FMath::FRand() * 360;
+
+        // Advances the props by one frame and gives their new rotations
+        virtual void spinProps(FRotator * rotations)
+        {
+            _propAngle = FMath::Fmod(_propAngle + PROP_DEGREES_PER_FRAME, 360);
+
+            for (uint8_t i = 0; i < _propCount; ++i) {
+                rotations[i] = FRotator(0, _propAngle * _motorDirections[i], 0);
+            }
+        }
+
         virtual void animateActuators(void) override
         {
             // Get motor values from dynamics
-            _flightManager->getMotorValues(_motorvals);
+            getMotorValues();
 
             // Compute the sum of the motor values
             float motorsum = 0;
@@ -57,9 +82,8 @@ class MultirotorVehicle : public Vehicle {
                 motorsum += _motorvals[j];
             }
 
-            // Rotate props. For visual effect, we can ignore actual motor values, and just keep increasing the rotation.
             if (motorsum > 0) {
-                rotateProps(_motorDirections, _dynamics->motorCount());
+                rotateProps();
             }
 
             // Add mean to circular buffer for moving average
@@ -87,13 +111,21 @@ class MultirotorVehicle : public Vehicle {
             return FMath::RadiansToDegrees(3.14159 / 2 - theta) + 57.5;
         }
 
-        void rotateProps(int8_t* motorDirections, uint8_t motorCount)
+        // Sets all the props' rotations, then brings their world transforms up to date in one pass,
+        // without the move, sweep and overlap work that SetRelativeRotation() does for each
+        void rotateProps(void)
         {
-            static float rotation;
-            for (uint8_t i = 0; i < motorCount; ++i) {
-                setPropRotation(i, rotation * motorDirections[i] * 200);
+            FRotator rotations[FFlightManager::MAX_MOTORS];
+
+            spinProps(rotations);
+
+            for (uint8_t i = 0; i < _propCount; ++i) {
+                _propellerMeshComponents[i]->SetRelativeRotation_Direct(rotations[i]);
+            }
+
+            for (uint8_t i = 0; i < _propCount; ++i) {
+                _propellerMeshComponents[i]->UpdateComponentToWorld(EUpdateTransformFlags::SkipPhysicsUpdate);
             }
-            rotation++;
         }
 
 
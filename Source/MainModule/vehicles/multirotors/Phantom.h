@@ -56,13 +56,17 @@ class Phantom {
 
         void build(APawn * pawn)
         {
+            vehicle.loadConfig(VehicleConfig::FRAME_QUADXAP, params);
+
             vehicle.buildFull(pawn, FrameStatics.mesh.Get(), 1.5, 0.5);
 
-            // Add propellers
-            addProp(+1, +1);
-            addProp(-1, -1);
-            addProp(+1, -1);
-            addProp(-1, +1);
+            // Add propellers, from the vehicle definition if it has them
+            if (!vehicle.addConfigProps(PropStatics.mesh.Get())) {
+                addProp(+1, +1);
+                addProp(-1, -1);
+                addProp(+1, -1);
+                addProp(-1, +1);
+            }
 
             _flightManager = NULL;
         }
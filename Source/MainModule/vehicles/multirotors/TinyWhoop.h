@@ -75,15 +75,19 @@ class TinyWhoop {
 
         void build(APawn * pawn)
         {
+            vehicle.loadConfig(VehicleConfig::FRAME_QUADXAP, params);
+
             // Build the frame
             vehicle.buildFull(pawn, FrameStatics.mesh.Get(), 1.5, 0.50);
 
-            // Add propellers
-            float x13 = -.0470, x24 = +.0430, y14 = -.020, y23 = +.070;
-            vehicle.addProp(PropCCWStatics.mesh.Get(), x13, y14);
-            vehicle.addProp(PropCCWStatics.mesh.Get(), x24, y23);
-            vehicle.addProp(PropCCWStatics.mesh.Get(), x13, y23);
-            vehicle.addProp(PropCCWStatics.mesh.Get(), x24, y14);
+            // Add propellers, from the vehicle definition if it has them
+            if (!vehicle.addConfigProps(PropCCWStatics.mesh.Get())) {
+                float x13 = -.0470, x24 = +.0430, y14 = -.020, y23 = +.070;
+                vehicle.addProp(PropCCWStatics.mesh.Get(), x13, y14);
+                vehicle.addProp(PropCCWStatics.mesh.Get(), x24, y23);
+                vehicle.addProp(PropCCWStatics.mesh.Get(), x13, y23);
+                vehicle.addProp(PropCCWStatics.mesh.Get(), x24, y14);
+            }
 
             // Add motor barrels
             addMotor(Motor1Statics.mesh.Get(), 1);
@@ -1,6 +1,8 @@
 /*
  * Vehicle subclass for ornithopters
  *
+ * Wings are animated like propellers, hinged at their roots
+ *
  * Copyright (C) 2019 Simon D. Levy
  *
  * MIT License
@@ -8,9 +10,9 @@
 
 #pragma once
 
-#include "../MainModule/Vehicle.hpp"
+#include "../Multirotor.hpp"
 
-class Ornithopter : public Vehicle {
+class Ornithopter : public MultirotorVehicle {
 
     private:
 
@@ -26,10 +28,27 @@ class Ornithopter : public Vehicle {
 
         wing_t _wings[FFlightManager::MAX_MOTORS] = {};
 
+        // This vehicle's flap phase in radians, starting at random
+        float _flapPhase = FMath::FRand() * 2 * PI;
+
+    protected:
+
+        // One sine per vehicle per frame; wings turning the other way flap the other way
+        virtual void spinProps(FRotator * rotations) override
+        {
+            _flapPhase = FMath::Fmod(_flapPhase + PROP_DEGREES_PER_FRAME / FLAP_ANGLE_DIVISOR, 2 * PI);
+
+            float flap = MAX_FLAP_DEGREES * FMath::Sin(_flapPhase);
+
+            for (uint8_t i = 0; i < _propCount; ++i) {
+                rotations[i] = FRotator(0, _wings[i].yawRelative, _wings[i].rollRelative + _motorDirections[i] * flap);
+            }
+        }
+
     public:
 
         Ornithopter(Dynamics* dynamics)
-            : Vehicle(dynamics)
+            : MultirotorVehicle(dynamics)
         {
         }
 
@@ -44,7 +63,7 @@ class Ornithopter : public Vehicle {
             _wings[_propCount].rollRelative = (yawStart==yawRelative) ? 0 : 180;
 
             // Use a tiny hinge as the "propeller" for this wing
-            UStaticMeshComponent* hingeMeshComponent = Vehicle::addProp(hingeMesh, hingeX, hingeY, yawStart);
+            UStaticMeshComponent* hingeMeshComponent = addProp(hingeMesh, hingeX, hingeY, yawStart);
 
             // Add the actual wing to the hinge
             UStaticMeshComponent* wingMeshComponent =
@@ -52,14 +71,8 @@ class Ornithopter : public Vehicle {
             wingMeshComponent->SetStaticMesh(wingMesh);
             wingMeshComponent->SetupAttachment(hingeMeshComponent, USpringArmComponent::SocketName);
             wingMeshComponent->AddRelativeLocation(FVector(+.025, wingY, -.05) * 100); // m => cm
-        }
-
-        virtual void setPropRotation(uint8_t index, float angle) override
-        {
-            wing_t wing = _wings[index];
-
-            // Flap wing via sine of angle
-            _propellerMeshComponents[index]->SetRelativeRotation(FRotator(0, wing.yawRelative, wing.rollRelative + MAX_FLAP_DEGREES*sin(angle/FLAP_ANGLE_DIVISOR)));
+            wingMeshComponent->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+            wingMeshComponent->SetGenerateOverlapEvents(false);
         }
 
 };  // class Ornithopter
@@ -54,6 +54,8 @@ class Rocket {
 
         void build(APawn * pawn)
         {
+            vehicle.loadConfig(VehicleConfig::FRAME_THRUSTVECTOR, params);
+
             vehicle.buildFull(pawn, FrameStatics.mesh.Get(), 1.5, 0.5);
 
             _flightManager = NULL;